@@ -33,6 +33,10 @@ void Acquisition::openFile(StoragePath path, int flag) {
 	
 	emit(s_filenameChanged(m_path.filename));
 	m_storage = std::make_unique <StorageWrapper>(nullptr, m_path.fullPath(), flag);
+	m_storage->setCompression(m_compression);
+	m_storage->setLayout(m_layout);
+	m_storage->setSpool(m_spool);
+	m_storage->setPacking(m_packing);
 }
 
 void Acquisition::openFile() {
@@ -59,6 +63,38 @@ int Acquisition::closeFile() {
 	return 0;
 }
 
+void Acquisition::setCompression(COMPRESSION_SETTINGS settings) {
+	m_compression = settings;
+	if (m_storage != nullptr) {
+		m_storage->setCompression(m_compression);
+	}
+}
+
+void Acquisition::setLayout(STORAGE_LAYOUT layout) {
+	m_layout = layout;
+	if (m_storage != nullptr) {
+		m_storage->setLayout(m_layout);
+	}
+}
+
+void Acquisition::setSpool(bool enabled) {
+	m_spool = enabled;
+	if (m_storage != nullptr) {
+		m_storage->setSpool(m_spool);
+	}
+}
+
+void Acquisition::setPacking(bool enabled) {
+	m_packing = enabled;
+	if (m_storage != nullptr) {
+		m_storage->setPacking(m_packing);
+	}
+}
+
+bool Acquisition::getPacking() {
+	return m_packing;
+}
+
 bool Acquisition::isModeEnabled(ACQUISITION_MODE mode) {
 	return (bool)(m_enabledModes & mode);
 }
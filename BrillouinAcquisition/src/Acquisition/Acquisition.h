@@ -30,6 +30,13 @@ public slots:
 	void openFile();
 	void newRepetition(ACQUISITION_MODE mode);
 	int closeFile();
+	// compression of the payloads, applied to the currently opened and all following files
+	void setCompression(COMPRESSION_SETTINGS settings);
+	void setLayout(STORAGE_LAYOUT layout);
+	void setSpool(bool enabled);
+	// stores the Brillouin images as Mono12Packed if the camera delivers 12 bit
+	void setPacking(bool enabled);
+	bool getPacking();
 	
 	bool isModeEnabled(ACQUISITION_MODE mode);
 
@@ -38,6 +45,10 @@ public slots:
 
 private:
 	StoragePath m_path;
+	COMPRESSION_SETTINGS m_compression;
+	STORAGE_LAYOUT m_layout{ STORAGE_LAYOUT::H5BM };
+	bool m_spool{ false };
+	bool m_packing{ false };
 	ACQUISITION_MODE m_enabledModes = ACQUISITION_MODE::NONE;	// which mode is currently acquiring
 
 private slots:
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "AcquisitionMode.h"
+#include "../../logger.h"
 
 AcquisitionMode::AcquisitionMode(QObject *parent, Acquisition *acquisition)
 	: QObject(parent), m_acquisition(acquisition) {
@@ -11,3 +12,31 @@ AcquisitionMode::~AcquisitionMode() {
 ACQUISITION_STATUS AcquisitionMode::getStatus() {
 	return m_status;
 }
+
+void AcquisitionMode::announcePhaseTiming(bool force) {
+	if (!force && m_phaseAnnouncement.isValid() && m_phaseAnnouncement.elapsed() < 1000) {
+		return;
+	}
+	m_phaseAnnouncement.start();
+	emit(s_phaseTiming(m_phases.getTiming()));
+}
+
+void AcquisitionMode::storePhaseTiming(std::unique_ptr <StorageWrapper>& storage, ACQUISITION_MODE mode) {
+	PHASE_TIMING timing = m_phases.getTiming();
+	storage->setPhaseTiming(mode, timing);
+	emit(s_phaseTiming(timing));
+
+	auto names = PHASE_TIMING::names();
+	std::string info = "Phase timing:";
+	for (gsl::index i{ 0 }; i < (gsl::index)timing.phases.size(); i++) {
+		const PHASE_STATISTICS& phase = timing.phases[i];
+		if (phase.count == 0) {
+			continue;
+		}
+		info += " " + names[i] + " " + std::to_string(phase.count) + "x " + std::to_string(1e3 * phase.mean)
+			+ " ms (p99 " + std::to_string(1e3 * phase.p99) + " ms),";
+	}
+	info.pop_back();
+	info += ".";
+	qInfo(logInfo()) << info.c_str();
+}
@@ -5,6 +5,7 @@
 #include <gsl/gsl>
 
 #include "../Acquisition.h"
+#include "../../phaseTiming.h"
 
 enum class ACQUISITION_STATUS {
 	DISABLED,
@@ -35,6 +36,16 @@ protected:
 	virtual void abortMode() = 0;
 	ACQUISITION_STATUS m_status{ ACQUISITION_STATUS::DISABLED };
 
+	// durations of the phases of the current repetition
+	PhaseTimer m_phases;
+	// emits the phase timing at most once per second, unless forced
+	void announcePhaseTiming(bool force = false);
+	// stores the phase timing of the repetition in the file
+	void storePhaseTiming(std::unique_ptr <StorageWrapper>& storage, ACQUISITION_MODE mode);
+
+private:
+	QElapsedTimer m_phaseAnnouncement;
+
 private slots:
 	virtual void acquire(std::unique_ptr <StorageWrapper> & storage) = 0;
 
@@ -42,6 +53,7 @@ signals:
 	void s_acquisitionStatus(ACQUISITION_STATUS);	// current acquisition state
 	void s_repetitionProgress(double, int);		// progress in percent and the remaining time in seconds
 	void s_totalProgress(int, int);				// repetitions
+	void s_phaseTiming(PHASE_TIMING);			// durations of the phases of the current repetition
 };
 
 #endif //ACQUISITIONMODE_H
\ No newline at end of file
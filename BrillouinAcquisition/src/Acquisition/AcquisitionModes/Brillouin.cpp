@@ -7,13 +7,24 @@
 using namespace std::experimental::filesystem::v1;
 
 
-Brillouin::Brillouin(QObject* parent, Acquisition* acquisition, Andor* andor, ScanControl** scanControl)
-	: AcquisitionMode(parent, acquisition), m_andor(andor), m_scanControl(scanControl) {
+Brillouin::Brillouin(QObject* parent, Acquisition* acquisition, Camera** camera, ScanControl** scanControl)
+	: AcquisitionMode(parent, acquisition), m_camera(camera), m_scanControl(scanControl) {
 }
 
 Brillouin::~Brillouin() {
 }
 
+void Brillouin::init() {
+	// the timers have to be created on the acquisition thread
+	m_repetitionTimer = new QTimer(this);
+	m_repetitionTimer->setSingleShot(true);
+	m_repetitionTimer->setTimerType(Qt::PreciseTimer);
+	QMetaObject::Connection connection = QWidget::connect(m_repetitionTimer, SIGNAL(timeout()), this, SLOT(runRepetition()));
+
+	m_waitingTimer = new QTimer(this);
+	connection = QWidget::connect(m_waitingTimer, SIGNAL(timeout()), this, SLOT(announceWaiting()));
+}
+
 void Brillouin::setSettings(BRILLOUIN_SETTINGS settings) {
 	m_settings = settings;
 }
@@ -33,37 +44,134 @@ void Brillouin::startRepetitions() {
 	std::string info = "Acquisition started.";
 	qInfo(logInfo()) << info.c_str();
 
-	QElapsedTimer startOfLastRepetition;
-	startOfLastRepetition.start();
+	m_repetition = 0;
+	m_repetitionClock.start();
+	runRepetition();
+}
 
-	for (gsl::index repNumber = 0; repNumber < m_settings.repetitions.count; repNumber++) {
+void Brillouin::runRepetition() {
+	m_waitingTimer->stop();
+	if (m_abort) {
+		this->abortMode();
+		return;
+	}
 
-		if (m_abort) {
-			this->abortMode();
-			return;
-		}
+	qint64 delay = -timeToRepetition();
+	if (m_repetition > 0 && delay > 1000) {
+		std::string info = "Repetition " + std::to_string(m_repetition + 1) + " started " + std::to_string(delay / 1000)
+			+ " s late, the previous repetition took longer than the interval.";
+		qWarning(logWarning()) << info.c_str();
+	}
 
-		m_acquisition->newRepetition(ACQUISITION_MODE::BRILLOUIN);
-
-		if (repNumber == 0) {
-			emit(s_totalProgress(repNumber, -1));
-			acquire(m_acquisition->m_storage);
-		} else {
-			int timeSinceLast = startOfLastRepetition.elapsed()*1e-3;
-			while (timeSinceLast < m_settings.repetitions.interval * 60) {
-				timeSinceLast = startOfLastRepetition.elapsed()*1e-3;
-				emit(s_totalProgress(repNumber, m_settings.repetitions.interval * 60 - timeSinceLast));
-				Sleep(100);
-			}
-			startOfLastRepetition.restart();
-			emit(s_totalProgress(repNumber, -1));
-			acquire(m_acquisition->m_storage);
-		}
+	m_acquisition->newRepetition(ACQUISITION_MODE::BRILLOUIN);
+	emit(s_totalProgress(m_repetition, -1));
+	acquire(m_acquisition->m_storage);
+	if (m_status == ACQUISITION_STATUS::ABORTED) {
+		return;
+	}
+	m_repetition++;
+
+	if (m_repetition >= m_settings.repetitions.count) {
+		emit(s_totalProgress(m_settings.repetitions.count, -1));
+		m_acquisition->disableMode(ACQUISITION_MODE::BRILLOUIN);
+		return;
+	}
+	scheduleRepetition();
+}
+
+qint64 Brillouin::timeToRepetition() {
+	qint64 deadline = (qint64)(m_repetition * m_settings.repetitions.interval * 60e3);
+	return deadline - m_repetitionClock.elapsed();
+}
+
+void Brillouin::scheduleRepetition() {
+	// the acquisition is still running while waiting for the next repetition, so it can be cancelled
+	m_status = ACQUISITION_STATUS::RUNNING;
+	emit(s_acquisitionStatus(m_status));
+
+	// a repetition which is already due is started from the event loop as well, so queued calls are handled first
+	m_repetitionTimer->start(simplemath::max<qint64>({ timeToRepetition(), 0 }));
+	m_waitingTimer->start(1000);
+	announceWaiting();
+}
+
+void Brillouin::announceWaiting() {
+	if (m_abort) {
+		m_repetitionTimer->stop();
+		m_waitingTimer->stop();
+		this->abortMode();
+		return;
+	}
+	// round up, so the announced time only reaches zero when the repetition starts
+	emit(s_totalProgress(m_repetition, (int)((timeToRepetition() + 999) / 1000)));
+}
+
+bool Brillouin::acquireRepetition() {
+	bool allowed = m_acquisition->enableMode(ACQUISITION_MODE::BRILLOUIN);
+	if (!allowed) {
+		return false;
+	}
+
+	m_abort = false;
+
+	m_acquisition->newRepetition(ACQUISITION_MODE::BRILLOUIN);
+	acquire(m_acquisition->m_storage);
+	if (m_status == ACQUISITION_STATUS::ABORTED) {
+		return false;
+	}
+	m_acquisition->disableMode(ACQUISITION_MODE::BRILLOUIN);
+	return true;
+}
+
+void Brillouin::resumeRepetition() {
+	std::unique_ptr<StorageWrapper>& storage = m_acquisition->m_storage;
+	if (storage == nullptr) {
+		return;
+	}
+	// payloads recovered from a spool belong to the repetition and advance its checkpoint
+	storage->waitForQueues();
+	SCAN_CHECKPOINT checkpoint = storage->readCheckpoint();
+	if (!checkpoint.valid) {
+		std::string info = "The last Brillouin repetition of the file is finished or has no checkpoint, it cannot be resumed.";
+		qWarning(logWarning()) << info.c_str();
+		return;
+	}
+
+	bool allowed = m_acquisition->enableMode(ACQUISITION_MODE::BRILLOUIN);
+	if (!allowed) {
+		return;
 	}
-	emit(s_totalProgress(m_settings.repetitions.count, -1));
+
+	m_abort = false;
+
+	int nrPositions = checkpoint.steps[0] * checkpoint.steps[1] * checkpoint.steps[2];
+	std::string info = "Resuming the Brillouin repetition at position " + std::to_string(checkpoint.writtenPositions + 1)
+		+ " of " + std::to_string(nrPositions) + ".";
+	qInfo(logInfo()) << info.c_str();
+
+	m_resume = checkpoint;
+	emit(s_totalProgress(0, -1));
+	acquire(storage);
+	m_resume = SCAN_CHECKPOINT{};
+	if (m_status == ACQUISITION_STATUS::ABORTED) {
+		return;
+	}
+	emit(s_totalProgress(1, -1));
 	m_acquisition->disableMode(ACQUISITION_MODE::BRILLOUIN);
 }
 
+double Brillouin::estimateDuration() {
+	int nrPositions = m_settings.xSteps * m_settings.ySteps * m_settings.zSteps;
+	double duration = nrPositions * m_settings.camera.frameCount * m_settings.camera.exposureTime;
+	// every calibration waits twice for the optical elements
+	double calibration = m_settings.nrCalibrationImages * m_settings.calibrationExposureTime + 1.0;
+	if (m_settings.conCalibration) {
+		duration += floor(duration / (60 * m_settings.conCalibrationInterval)) * calibration;
+	}
+	duration += (m_settings.preCalibration + m_settings.postCalibration) * calibration;
+	return duration;
+}
+
 void Brillouin::setStepNumberX(int steps) {
 	m_settings.xSteps = steps;
 	determineScanOrder();
@@ -84,113 +192,84 @@ void Brillouin::acquire(std::unique_ptr <StorageWrapper>& storage) {
 	emit(s_acquisitionStatus(m_status));
 	
 	// prepare camera for image acquisition
-	m_andor->startAcquisition(m_settings.camera);
-	m_settings.camera = m_andor->getSettings();
+	(*m_camera)->startAcquisition(m_settings.camera);
+	m_settings.camera = (*m_camera)->getSettings();
 	(*m_scanControl)->stopAnnouncingPosition();
+	m_phases.reset();
 	// set optical elements for brightfield/Brillouin imaging
-	(*m_scanControl)->setPreset(SCAN_BRILLOUIN);
-	Sleep(500);
+	{
+		PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::PRESET);
+		(*m_scanControl)->setPreset(SCAN_BRILLOUIN);
+	}
+	{
+		PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::SETTLE);
+		Sleep(500);
+	}
 
 	// get current stage position
 	m_startPosition = (*m_scanControl)->getPosition();
 
-	std::string commentIn = "Brillouin data";
-	storage->setComment(commentIn);
-
-	storage->setResolution("x", m_settings.xSteps);
-	storage->setResolution("y", m_settings.ySteps);
-	storage->setResolution("z", m_settings.zSteps);
+	// a resumed repetition continues with the scan of its checkpoint, the settings are left untouched
+	bool resume = m_resume.valid;
+	std::array<SCAN_AXIS, 3> axes{
+		SCAN_AXIS{ m_settings.xMin, m_settings.xMax, m_settings.xSteps },
+		SCAN_AXIS{ m_settings.yMin, m_settings.yMax, m_settings.ySteps },
+		SCAN_AXIS{ m_settings.zMin, m_settings.zMax, m_settings.zSteps }
+	};
+	std::array<int, 3> order{ getScanOrderX(), getScanOrderY(), getScanOrderZ() };
+	SCAN_TRAJECTORY trajectory = m_settings.trajectory;
+	if (resume) {
+		std::array<int, 3> frameDims{ (int)m_settings.camera.frameCount, (int)m_settings.camera.roi.height, (int)m_settings.camera.roi.width };
+		if (frameDims != m_resume.frameDims) {
+			std::string info = "The camera settings do not match the images of the repetition, it cannot be resumed.";
+			qWarning(logWarning()) << info.c_str();
+			this->abortMode();
+			return;
+		}
+		m_startPosition = POINT3{ m_resume.origin[0], m_resume.origin[1], m_resume.origin[2] };
+		for (gsl::index axis{ 0 }; axis < 3; axis++) {
+			axes[axis] = SCAN_AXIS{ m_resume.min[axis], m_resume.max[axis], m_resume.steps[axis] };
+		}
+		order = m_resume.order;
+		trajectory = (SCAN_TRAJECTORY)m_resume.trajectory;
+	} else {
+		std::string commentIn = "Brillouin data";
+		storage->setComment(commentIn);
+
+		storage->setResolution("x", axes[0].steps);
+		storage->setResolution("y", axes[1].steps);
+		storage->setResolution("z", axes[2].steps);
+	}
 
 	int resolutionXout = storage->getResolution("x");
 
 	// total number of positions to measure
-	int nrPositions = m_settings.xSteps * m_settings.ySteps * m_settings.zSteps;
+	int nrPositions = axes[0].steps * axes[1].steps * axes[2].steps;
 
 	/*
-	 *	Construct positions vector with correct order of scan directions
+	 *	The positions are generated in the order of the scan directions while the scan runs
 	 */
+	ScanPlan plan(trajectory, axes, order, m_startPosition);
 
-	// Create positions vector
-	std::vector<POINT3> orderedPositions(nrPositions);
-	std::vector<int> indexX(nrPositions, 0);
-	std::vector<int> indexY(nrPositions, 0);
-	std::vector<int> indexZ(nrPositions, 0);
-	// vector indicating if a new line just started and a calibration is allowed
-	std::vector<bool> calibrationAllowed(nrPositions, false);
-
-	int indX = getScanOrderX();
-	int indY = getScanOrderY();
-	int indZ = getScanOrderZ();
-
-	// construct directions vector
-	std::vector<std::vector<double>> directions(3);
-	directions[indX] = simplemath::linspace(m_settings.xMin, m_settings.xMax, m_settings.xSteps);
-	directions[indY] = simplemath::linspace(m_settings.yMin, m_settings.yMax, m_settings.ySteps);
-	directions[indZ] = simplemath::linspace(m_settings.zMin, m_settings.zMax, m_settings.zSteps);
-
-	int ll{ 0 };
-	std::vector<double> position(3);
-	std::vector<int> indices(3);
-	for (gsl::index ii = 0; ii < directions[2].size(); ii++) {
-		for (gsl::index jj = 0; jj < directions[1].size(); jj++) {
-			for (gsl::index kk = 0; kk < directions[0].size(); kk++) {
-
-				// construct indices vector
-				indices[0] = kk;
-				indices[1] = jj;
-				indices[2] = ii;
-				
-				// construct position vector
-				position[0] = directions[0][kk];
-				position[1] = directions[1][jj];
-				position[2] = directions[2][ii];
-
-				// calculate stage positions
-				orderedPositions[ll] = POINT3{ position[indX], position[indY], position[indZ] } + m_startPosition;
-
-				// fill index vectors
-				indexX[ll] = indices[indX];
-				indexY[ll] = indices[indY];
-				indexZ[ll] = indices[indZ];
-
-				// set vector element to true if a new line started
-				if (kk == 0) {
-					calibrationAllowed[ll] = true;
-				}
-				ll++;
-			}
-		}
-	}
+	logTravel(plan);
 
 	/*
-	 *	Construct positions vector for H5 file with row-major order: z, x, y
+	 *	Write the positions to the H5 file with row-major order: z, x, y
 	 */
-
-	std::vector<double> positionsX(nrPositions);
-	std::vector<double> positionsY(nrPositions);
-	std::vector<double> positionsZ(nrPositions);
-	ll = 0;
-	for (gsl::index ii = 0; ii < m_settings.zSteps; ii++) {
-		for (gsl::index jj = 0; jj < m_settings.xSteps; jj++) {
-			for (gsl::index kk = 0; kk < m_settings.ySteps; kk++) {
-				positionsX[ll] = directions[indX][jj] + m_startPosition.x;
-				positionsY[ll] = directions[indY][kk] + m_startPosition.y;
-				positionsZ[ll] = directions[indZ][ii] + m_startPosition.z;
-				ll++;
-			}
-		}
-	}
-
 	int rank = 3;
-	hsize_t* dims = new hsize_t[rank];
-	dims[0] = m_settings.zSteps;
-	dims[1] = m_settings.xSteps;
-	dims[2] = m_settings.ySteps;
-
-	storage->setPositions("x", positionsX, rank, dims);
-	storage->setPositions("y", positionsY, rank, dims);
-	storage->setPositions("z", positionsZ, rank, dims);
-	delete[] dims;
+	hsize_t dims[3] = { (hsize_t)axes[2].steps, (hsize_t)axes[0].steps, (hsize_t)axes[1].steps };
+	hsize_t planeLength = dims[1] * dims[2];
+	if (!resume) {
+		storage->setPositions("x", rank, dims, [&plan, &dims, this](hsize_t ll) {
+			return plan.position(0, (int)((ll / dims[2]) % dims[1])) + m_startPosition.x;
+		});
+		storage->setPositions("y", rank, dims, [&plan, &dims, this](hsize_t ll) {
+			return plan.position(1, (int)(ll % dims[2])) + m_startPosition.y;
+		});
+		storage->setPositions("z", rank, dims, [&plan, planeLength, this](hsize_t ll) {
+			return plan.position(2, (int)(ll / planeLength)) + m_startPosition.z;
+		});
+	}
 
 	// do actual measurement
 	storage->startWritingQueues();
@@ -199,71 +278,246 @@ void Brillouin::acquire(std::unique_ptr <StorageWrapper>& storage) {
 	hsize_t dims_data[3] = { m_settings.camera.frameCount, m_settings.camera.roi.height, m_settings.camera.roi.width };
 	int bytesPerFrame = 2 * m_settings.camera.roi.width * m_settings.camera.roi.height;
 
-	// reset number of calibrations
-	nrCalibrations = 1;
-	// do pre calibration
-	if (m_settings.preCalibration) {
+	// only 12 bit images can be packed without losing data
+	bool twelveBit = m_settings.camera.readout.pixelEncoding == L"Mono12" || m_settings.camera.readout.pixelEncoding == L"Mono12Packed";
+	if (m_acquisition->getPacking() && !twelveBit) {
+		std::string info = "The camera does not acquire 12 bit images, the images are stored unpacked.";
+		qWarning(logWarning()) << info.c_str();
+	}
+	storage->setPacking(m_acquisition->getPacking() && twelveBit);
+
+	// preallocates the datasets of the repetition if the storage uses the hyperslab layout
+	storage->createScan(axes[2].steps, axes[0].steps, axes[1].steps, rank_data, dims_data);
+
+	// the writer keeps the checkpoint up to date, so the repetition can be resumed if it is interrupted
+	gsl::index firstPosition{ 0 };
+	if (resume) {
+		storage->resumeCheckpoint(m_resume);
+		firstPosition = m_resume.writtenPositions;
+		nrCalibrations = m_resume.calibrations + 1;
+	} else {
+		SCAN_CHECKPOINT checkpoint;
+		checkpoint.min = { axes[0].min, axes[1].min, axes[2].min };
+		checkpoint.max = { axes[0].max, axes[1].max, axes[2].max };
+		checkpoint.steps = { axes[0].steps, axes[1].steps, axes[2].steps };
+		checkpoint.order = order;
+		checkpoint.trajectory = (int)trajectory;
+		checkpoint.origin = { m_startPosition.x, m_startPosition.y, m_startPosition.z };
+		checkpoint.frameDims = { (int)dims_data[0], (int)dims_data[1], (int)dims_data[2] };
+		storage->startCheckpoint(checkpoint);
+		// reset number of calibrations
+		nrCalibrations = 1;
+	}
+	// without a pre calibration the first positions are the drift reference
+	m_drift.reset();
+	// do pre calibration, the spectrometer might have drifted while a resumed repetition was interrupted
+	if (m_settings.preCalibration || resume) {
 		calibrate(storage);
 	}
 
-	QElapsedTimer measurementTimer;
-	measurementTimer.start();
-
 	QElapsedTimer calibrationTimer;
 	calibrationTimer.start();
 
-	for (gsl::index ll = 0; ll < nrPositions; ll++) {
+	/*
+	 *	The acquisition is pipelined: as soon as the frames of a position are acquired,
+	 *	they are handed to the packaging stage and the stage moves to the next position.
+	 *	Timestamping, the preview copy and enqueueing the payload overlap with the move.
+	 */
+	// the packaging jobs reference the dimensions of this scope, they are finished before it is left
+	PipelineStage packaging;
+
+	// the NIDAQ can play the x/y scan as a waveform which triggers the camera
+	NIDAQ* nidaq = m_settings.hardwareTimed ? dynamic_cast<NIDAQ*>(*m_scanControl) : nullptr;
+	if (m_settings.hardwareTimed && nidaq == nullptr) {
+		std::string info = "Hardware-timed scans are only supported by the NIDAQ, the scan is software-timed.";
+		qWarning(logWarning()) << info.c_str();
+	}
+	// the waveform only moves the galvo mirrors, so every x/y plane has to be scanned completely before z changes
+	if (nidaq != nullptr && order[2] != 2) {
+		nidaq = nullptr;
+		std::string info = "Hardware-timed scans require z to be the slowest scan direction, the scan is software-timed.";
+		qWarning(logWarning()) << info.c_str();
+	}
 
+	// calibrates if required and possible at the moment and moves the stage to the position
+	auto moveTo = [&](const SCAN_POINT& point) {
 		// do live calibration if required and possible at the moment
-		if (m_settings.conCalibration && calibrationAllowed[ll]) {
-			if (calibrationTimer.elapsed() > (60e3 * m_settings.conCalibrationInterval)) {
+		if (m_settings.conCalibration && point.lineStart) {
+			if (isCalibrationDue(1e-3 * calibrationTimer.elapsed())) {
+				// the calibration frames are shown in the preview as well, which only takes one producer
+				packaging.waitForDone();
+				// the calibration frames are triggered by software
+				if (nidaq != nullptr) {
+					setTriggerMode(m_settings.camera.readout.triggerMode);
+				}
 				calibrate(storage);
+				if (nidaq != nullptr) {
+					setTriggerMode(L"External");
+				}
 				calibrationTimer.start();
 			}
 		}
 
-		int nextCalibration = 100 * (1e-3 * calibrationTimer.elapsed()) / (60 * m_settings.conCalibrationInterval);
-		emit(s_timeToCalibration(nextCalibration));
-		// move stage to correct position, wait 50 ms for it to finish
-		(*m_scanControl)->setPosition(orderedPositions[ll]);
+		emit(s_timeToCalibration(calibrationProgress(1e-3 * calibrationTimer.elapsed())));
 
-		std::vector<unsigned char> images(bytesPerFrame * m_settings.camera.frameCount);
+		PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::MOVE);
+		(*m_scanControl)->setPosition(point.position);
+	};
 
-		for (gsl::index mm = 0; mm < m_settings.camera.frameCount; mm++) {
+	// acquires the frames at the position and hands them to the packaging stage,
+	// returns false if the acquisition was aborted or the frames could not be acquired
+	auto acquirePosition = [&](const SCAN_POINT& point) {
+		// the camera writes directly into a recycled payload buffer
+		std::vector<unsigned short> images = storage->m_imagePool.getBuffer((size_t)bytesPerFrame / 2 * m_settings.camera.frameCount);
+		auto imageBuffer = reinterpret_cast<unsigned char*>(images.data());
+
+		{
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::EXPOSURE);
 			if (m_abort) {
-				this->abortMode();
-				return;
+				return false;
+			}
+			emit(s_positionChanged(POINT3{ point.position } - m_startPosition, (int)m_settings.camera.frameCount));
+			// a series with missing frames is acquired again, unless the frames are triggered by the scan waveform
+			int attempts = (nidaq == nullptr) ? 2 : 1;
+			int acquired{ 0 };
+			for (gsl::index attempt{ 0 }; attempt < attempts && acquired < (int)m_settings.camera.frameCount; attempt++) {
+				// drop the metadata of frames which do not belong to the position, e.g. of the preview
+				(*m_camera)->takeMetadata();
+				// acquire all frames of the position as one series, the preview is updated by the packaging stage
+				acquired = (*m_camera)->acquireSeries(imageBuffer, (int)m_settings.camera.frameCount);
+			}
+			// the missing frames would still hold the data of an earlier position
+			if (acquired < (int)m_settings.camera.frameCount) {
+				std::string info = "Only " + std::to_string(acquired) + " of " + std::to_string(m_settings.camera.frameCount)
+					+ " frames were acquired at position " + std::to_string(point.indices[0]) + ", " + std::to_string(point.indices[1])
+					+ ", " + std::to_string(point.indices[2]) + ", the acquisition is aborted.";
+				qWarning(logWarning()) << info.c_str();
+				storage->m_imagePool.returnBuffer(std::move(images));
+				return false;
 			}
-			emit(s_positionChanged(orderedPositions[ll] - m_startPosition, mm + 1));
-			// acquire images
-			int64_t pointerPos = (int64_t)bytesPerFrame * mm;
-			m_andor->getImageForAcquisition(&images[pointerPos]);
 		}
+		std::vector<FRAME_METADATA> metadata = (*m_camera)->takeMetadata();
+		// the datetime has to be taken here, otherwise it would be determined by the time the payload is packaged
+		QDateTime acquired = QDateTime::currentDateTime();
+		// the camera thread may change its settings while the frames are packaged
+		CAMERA_SETTINGS cameraSettings = (*m_camera)->getSettings();
+		uint64_t frameID = metadata.empty() ? 0 : metadata.back().frameID;
+
+		packaging.submit([this, &storage, &dims_data, rank_data, bytesPerFrame, acquired, cameraSettings, frameID, metadata = std::move(metadata),
+			indX = point.indices[0], indY = point.indices[1], indZ = point.indices[2], images = std::move(images)]() mutable {
+
+			IMAGE* img{ nullptr };
+			{
+				PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::PACKAGING);
+				// show the last frame of the position
+				(*m_camera)->publishPreview(reinterpret_cast<unsigned char*>(images.data()) + (int64_t)bytesPerFrame * (dims_data[0] - 1),
+					cameraSettings, frameID);
+				std::string date = acquired.toOffsetFromUtc(acquired.offsetFromUtc()).toString(Qt::ISODateWithMs).toStdString();
+				// the elastic peak of the last frame indicates the drift of the spectrometer
+				m_drift.addFrame(images.data() + (int64_t)bytesPerFrame / 2 * (dims_data[0] - 1), (int)dims_data[2], (int)dims_data[1]);
+				img = new IMAGE(indX, indY, indZ, rank_data, dims_data, date, std::move(images));
+			}
 
-		// cast the vector to unsigned short
-		std::vector<unsigned short>* images_ = (std::vector<unsigned short> *) &images;
-
-		// asynchronously write image to disk
-		// the datetime has to be set here, otherwise it would be determined by the time the queue is processed
-		std::string date = QDateTime::currentDateTime().toOffsetFromUtc(QDateTime::currentDateTime().offsetFromUtc())
-			.toString(Qt::ISODateWithMs).toStdString();
-		IMAGE* img = new IMAGE(indexX[ll], indexY[ll], indexZ[ll], rank_data, dims_data, date, *images_);
-
-		QMetaObject::invokeMethod(storage.get(), "s_enqueuePayload", Qt::AutoConnection, Q_ARG(IMAGE*, img));
+			// blocks if the storage queues exceed their memory limit
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::ENQUEUE);
+			storage->s_enqueuePayload(img, std::move(metadata));
+		});
+		return true;
+	};
 
+	auto announceProgress = [&](gsl::index ll) {
 		double percentage = 100 * (double)(ll+1) / nrPositions;
-		int remaining = 1e-3 * measurementTimer.elapsed() / (ll+1) * ((int64_t)nrPositions - ll + 1);
+		int remaining = remainingDuration((int64_t)nrPositions - ll - 1);
 		emit(s_repetitionProgress(percentage, remaining));
+		announcePhaseTiming();
+	};
+
+	// the next position is known before the current one is acquired, so the stage can move during the packaging
+	SCAN_POINT point;
+	SCAN_POINT next;
+	// the positions written before the repetition was interrupted are skipped
+	for (gsl::index ll{ 0 }; ll < firstPosition; ll++) {
+		plan.next(next);
 	}
+	bool hasNext = plan.next(next);
+	if (nidaq == nullptr) {
+		if (hasNext) {
+			moveTo(next);
+		}
+		for (gsl::index ll{ firstPosition }; hasNext; ll++) {
+			point = next;
+			if (!acquirePosition(point)) {
+				packaging.waitForDone();
+				this->abortMode();
+				return;
+			}
+			// start moving to the next position while the frames are packaged
+			hasNext = plan.next(next);
+			if (hasNext) {
+				moveTo(next);
+			}
+			announceProgress(ll);
+		}
+	} else {
+		/*
+		 *	Hardware-timed scan: the positions of every z-plane are played as one waveform by the DAQ,
+		 *	which triggers the camera at every position. Only the z-moves and calibrations in between
+		 *	the planes are timed by software, so there is no software latency between the positions.
+		 *	Only the positions of the current plane are held in memory.
+		 */
+		RASTER_TIMING timing = m_settings.rasterTiming;
+		timing.exposureTime = m_settings.camera.exposureTime;
+		timing.frameCount = m_settings.camera.frameCount;
+		// the buffer is refilled every chunk, so a chunk holds at least one position
+		if (timing.chunkPoints < 1) {
+			timing.chunkPoints = 1;
+		}
+		setTriggerMode(L"External");
+
+		gsl::index ll{ firstPosition };
+		std::vector<SCAN_POINT> plane;
+		std::vector<POINT3> planePositions;
+		while (hasNext) {
+			// the waveform only moves the galvo mirrors, the piezo has to be moved to the plane
+			plane.clear();
+			planePositions.clear();
+			do {
+				plane.push_back(next);
+				planePositions.push_back(next.position);
+				hasNext = plan.next(next);
+			} while (hasNext && next.indices[2] == plane.front().indices[2]);
+			moveTo(plane.front());
+
+			bool playing = nidaq->startRasterScan(planePositions, timing);
+			for (gsl::index pp{ 0 }; pp < (gsl::index)plane.size(); pp++, ll++) {
+				if (!playing || !acquirePosition(plane[pp])) {
+					nidaq->stopRasterScan();
+					packaging.waitForDone();
+					setTriggerMode(m_settings.camera.readout.triggerMode);
+					this->abortMode();
+					return;
+				}
+				// the DAQ buffer holds two chunks, refill the one which was just played
+				if ((pp + 1) % timing.chunkPoints == 0) {
+					playing = nidaq->writeRasterChunk();
+				}
+				announceProgress(ll);
+			}
+			nidaq->stopRasterScan();
+		}
+		setTriggerMode(m_settings.camera.readout.triggerMode);
+	}
+	packaging.waitForDone();
+	logTiming(packaging.getStallDuration());
 	// do post calibration
 	if (m_settings.postCalibration) {
 		calibrate(storage);
 	}
 
 	// close camera libraries, clear buffers
-	m_andor->stopAcquisition();
+	(*m_camera)->stopAcquisition();
 
-	QMetaObject::invokeMethod(storage.get(), "s_finishedQueueing", Qt::AutoConnection);
+	storage->s_finishedQueueing();
 
 	(*m_scanControl)->setPreset(SCAN_LASEROFF);
 
@@ -271,6 +525,12 @@ void Brillouin::acquire(std::unique_ptr <StorageWrapper>& storage) {
 	emit(s_positionChanged({ 0, 0, 0 }, 0));
 	(*m_scanControl)->startAnnouncingPosition();
 
+	// wait until the writer thread stored all payloads
+	storage->waitForQueues();
+	storage->finishCheckpoint();
+	storePhaseTiming(storage, ACQUISITION_MODE::BRILLOUIN);
+	storage->logStatistics();
+
 	std::string info = "Acquisition finished.";
 	qInfo(logInfo()) << info.c_str();
 	emit(s_calibrationRunning(false));
@@ -279,8 +539,64 @@ void Brillouin::acquire(std::unique_ptr <StorageWrapper>& storage) {
 	emit(s_timeToCalibration(0));
 }
 
+void Brillouin::logTiming(double stallDuration) {
+	std::string info = "Pipeline: " + std::to_string(m_phases.count(ACQUISITION_PHASE::EXPOSURE)) + " positions, moving "
+		+ std::to_string(m_phases.total(ACQUISITION_PHASE::MOVE)) + " s, acquiring " + std::to_string(m_phases.total(ACQUISITION_PHASE::EXPOSURE))
+		+ " s, packaging " + std::to_string(m_phases.total(ACQUISITION_PHASE::PACKAGING)) + " s and enqueueing "
+		+ std::to_string(m_phases.total(ACQUISITION_PHASE::ENQUEUE)) + " s overlapped with the moves, stalled " + std::to_string(stallDuration) + " s.";
+	qInfo(logInfo()) << info.c_str();
+}
+
+double Brillouin::remainingDuration(int64_t remainingPositions) {
+	int positions = m_phases.count(ACQUISITION_PHASE::EXPOSURE);
+	if (positions == 0) {
+		return 0;
+	}
+	// the hardware-timed scan only moves once per plane, so the moves are distributed over the positions
+	double perPosition = (m_phases.total(ACQUISITION_PHASE::MOVE) + m_phases.total(ACQUISITION_PHASE::EXPOSURE)) / positions;
+	double remaining = perPosition * remainingPositions;
+	// before the first calibration finished, its duration is estimated from the exposure
+	double calibration = m_phases.mean(ACQUISITION_PHASE::CALIBRATION, m_settings.nrCalibrationImages * m_settings.calibrationExposureTime + 1.0);
+	// the adaptive calibration might skip some of the calibrations, the estimate assumes none is skipped
+	if (m_settings.conCalibration && m_settings.conCalibrationInterval > 0) {
+		remaining += floor(remaining / (60 * m_settings.conCalibrationInterval)) * calibration;
+	}
+	if (m_settings.postCalibration) {
+		remaining += calibration;
+	}
+	return remaining;
+}
+
+void Brillouin::logTravel(const ScanPlan& plan) {
+	// the prediction walks through every trajectory, which would delay the start of large scans
+	constexpr int maxPositions{ 1000000 };
+	if (plan.count() > maxPositions) {
+		return;
+	}
+	std::vector<std::vector<double>> directions = plan.directions();
+	std::array<int, 3> steps{ (int)directions[0].size(), (int)directions[1].size(), (int)directions[2].size() };
+	auto names = ScanTrajectory::names();
+	std::string info = "Predicted travel:";
+	for (gsl::index i{ 0 }; i < (gsl::index)SCAN_TRAJECTORY::COUNT; i++) {
+		ScanTrajectory trajectory((SCAN_TRAJECTORY)i, steps);
+		info += " " + names[i] + " " + std::to_string((int)round(trajectory.travel(directions))) + " um"
+			+ (((SCAN_TRAJECTORY)i == m_settings.trajectory) ? " (selected)" : "") + ",";
+	}
+	info.pop_back();
+	info += ".";
+	qInfo(logInfo()) << info.c_str();
+}
+
+void Brillouin::setTriggerMode(std::wstring triggerMode) {
+	// the trigger mode is only applied when the camera acquisition starts
+	(*m_camera)->stopAcquisition();
+	CAMERA_SETTINGS settings = m_settings.camera;
+	settings.readout.triggerMode = triggerMode;
+	(*m_camera)->startAcquisition(settings);
+}
+
 void Brillouin::abortMode() {
-	m_andor->stopAcquisition();
+	(*m_camera)->stopAcquisition();
 	(*m_scanControl)->setPosition(m_startPosition);
 	m_acquisition->disableMode(ACQUISITION_MODE::BRILLOUIN);
 	m_status = ACQUISITION_STATUS::ABORTED;
@@ -290,11 +606,13 @@ void Brillouin::abortMode() {
 }
 
 void Brillouin::calibrate(std::unique_ptr <StorageWrapper>& storage) {
+	// the presets and the settling are part of the calibration
+	PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::CALIBRATION);
 	// announce calibration start
 	emit(s_calibrationRunning(true));
 
 	// set exposure time for calibration
-	m_andor->setCalibrationExposureTime(m_settings.calibrationExposureTime);
+	(*m_camera)->setCalibrationExposureTime(m_settings.calibrationExposureTime);
 
 	// move optical elements to position for calibration
 	(*m_scanControl)->setPreset(SCAN_CALIBRATION);
@@ -307,42 +625,91 @@ void Brillouin::calibrate(std::unique_ptr <StorageWrapper>& storage) {
 	hsize_t dims_cal[3] = { m_settings.nrCalibrationImages, m_settings.camera.roi.height, m_settings.camera.roi.width };
 
 	int bytesPerFrame = 2 * m_settings.camera.roi.width * m_settings.camera.roi.height;
-	std::vector<unsigned char> images((int64_t)bytesPerFrame * m_settings.nrCalibrationImages);
-	for (gsl::index mm = 0; mm < m_settings.nrCalibrationImages; mm++) {
-		if (m_abort) {
-			this->abortMode();
-			return;
-		}
-		// acquire images
-		int64_t pointerPos = (int64_t)bytesPerFrame * mm;
-		m_andor->getImageForAcquisition(&images[pointerPos]);
-	}
-	// cast the vector to unsigned short
-	std::vector<unsigned short>* images_ = (std::vector<unsigned short>*) &images;
-
-	// the datetime has to be set here, otherwise it would be determined by the time the queue is processed
-	std::string date = QDateTime::currentDateTime().toOffsetFromUtc(QDateTime::currentDateTime().offsetFromUtc())
-		.toString(Qt::ISODateWithMs).toStdString();
-	CALIBRATION* cal = new CALIBRATION(
-		nrCalibrations,			// index
-		*images_,				// data
-		rank_cal,				// the rank of the calibration data
-		dims_cal,				// the dimension of the calibration data
-		m_settings.sample,		// the samplename
-		shift,					// the Brillouin shift of the sample
-		date					// the datetime
-	);
-
-	QMetaObject::invokeMethod(storage.get(), "s_enqueueCalibration", Qt::AutoConnection, Q_ARG(CALIBRATION*, cal));
-
-	nrCalibrations++;
+	std::vector<unsigned short> images = storage->m_imagePool.getBuffer((size_t)bytesPerFrame / 2 * m_settings.nrCalibrationImages);
+	auto imageBuffer = reinterpret_cast<unsigned char*>(images.data());
+	if (m_abort) {
+		this->abortMode();
+		return;
+	}
+	// the calibration frames are acquired as one series, so the readout of a frame overlaps the exposure of the next one
+	int acquired = (*m_camera)->acquireSeries(imageBuffer, (int)m_settings.nrCalibrationImages);
+	std::vector<FRAME_METADATA> metadata = (*m_camera)->takeMetadata();
+	if (acquired > 0) {
+		(*m_camera)->publishPreview(imageBuffer + (int64_t)bytesPerFrame * (acquired - 1), (*m_camera)->getSettings(),
+			metadata.empty() ? 0 : metadata.back().frameID);
+	}
+
+	// the missing frames would still hold the data of an earlier acquisition
+	if (acquired < (int)m_settings.nrCalibrationImages) {
+		std::string info = "Only " + std::to_string(acquired) + " of " + std::to_string(m_settings.nrCalibrationImages)
+			+ " calibration frames were acquired, the calibration is skipped.";
+		qWarning(logWarning()) << info.c_str();
+		storage->m_imagePool.returnBuffer(std::move(images));
+	} else {
+		// the datetime has to be set here, otherwise it would be determined by the time the queue is processed
+		std::string date = QDateTime::currentDateTime().toOffsetFromUtc(QDateTime::currentDateTime().offsetFromUtc())
+			.toString(Qt::ISODateWithMs).toStdString();
+		CALIBRATION* cal = new CALIBRATION(
+			nrCalibrations,			// index
+			std::move(images),		// data
+			rank_cal,				// the rank of the calibration data
+			dims_cal,				// the dimension of the calibration data
+			m_settings.sample,		// the samplename
+			shift,					// the Brillouin shift of the sample
+			date					// the datetime
+		);
+
+		storage->s_enqueueCalibration(cal);
+
+		nrCalibrations++;
+	}
 
 	// revert optical elements to position for brightfield/Brillouin imaging
 	(*m_scanControl)->setPreset(SCAN_BRILLOUIN);
 
 	// reset exposure time
-	m_andor->setCalibrationExposureTime(m_settings.camera.exposureTime);
+	(*m_camera)->setCalibrationExposureTime(m_settings.camera.exposureTime);
 	Sleep(500);
+
+	// the following frames are the reference for the drift until the next calibration
+	m_drift.reset();
+}
+
+bool Brillouin::isCalibrationDue(double elapsed) {
+	double interval = 60 * m_settings.conCalibrationInterval;
+	if (!m_settings.adaptiveCalibration) {
+		return elapsed > interval;
+	}
+	// the interval is the longest time without a calibration
+	DRIFT drift = m_drift.getDrift();
+	std::string driftInfo = drift.valid ? (std::to_string(drift.drift) + " px") : "not yet measured";
+	if (elapsed > interval) {
+		std::string info = "Calibrating after the maximum interval of " + std::to_string((int)interval)
+			+ " s, drift " + driftInfo + ".";
+		qInfo(logInfo()) << info.c_str();
+		return true;
+	}
+	if (drift.valid && drift.drift > m_settings.driftThreshold) {
+		std::string info = "Calibrating after " + std::to_string((int)elapsed) + " s, drift " + driftInfo
+			+ " exceeds " + std::to_string(m_settings.driftThreshold) + " px.";
+		qInfo(logInfo()) << info.c_str();
+		return true;
+	}
+	std::string info = "Skipping calibration after " + std::to_string((int)elapsed) + " s, drift " + driftInfo
+		+ " over " + std::to_string(drift.frames) + " frames.";
+	qDebug(logDebug()) << info.c_str();
+	return false;
+}
+
+int Brillouin::calibrationProgress(double elapsed) {
+	double progress = elapsed / (60 * m_settings.conCalibrationInterval);
+	if (m_settings.adaptiveCalibration && m_settings.driftThreshold > 0) {
+		DRIFT drift = m_drift.getDrift();
+		if (drift.valid) {
+			progress = simplemath::max<double>({ progress, drift.drift / m_settings.driftThreshold });
+		}
+	}
+	return (int)(100 * simplemath::min<double>({ progress, 1.0 }));
 }
 
 /*
@@ -2,10 +2,14 @@
 #define BRILLOUIN_H
 
 #include "AcquisitionMode.h"
-#include "../../Devices/andor.h"
+#include "../scanPlan.h"
+#include "../driftMonitor.h"
+#include "../../Devices/Camera.h"
 #include "../../Devices/scancontrol.h"
+#include "../../Devices/NIDAQ.h"
 #include "../../thread.h"
 #include "../../circularBuffer.h"
+#include "../../pipelineStage.h"
 
 struct SCAN_ORDER {
 	bool automatical{ true };
@@ -21,6 +25,8 @@ struct BRILLOUIN_SETTINGS {
 	bool postCalibration = true;			// do post calibration
 	bool conCalibration = true;				// do continuous calibration
 	double conCalibrationInterval = 10;		// interval of continuous calibrations
+	bool adaptiveCalibration = false;		// only calibrate continuously if the spectrometer drifted, at the latest after the interval
+	double driftThreshold = 0.5;			// [pix]	drift of the elastic peak which triggers a calibration
 	int nrCalibrationImages = 10;				// number of calibration images
 	double calibrationExposureTime = 1;		// exposure time for calibration images
 
@@ -37,6 +43,11 @@ struct BRILLOUIN_SETTINGS {
 	double zMin = 0;	// [m]	z minimum value
 	double zMax = 0;	// [m]	z maximum value
 	int zSteps = 1;		// [1]	z steps
+	SCAN_TRAJECTORY trajectory = SCAN_TRAJECTORY::RASTER;	// order in which the positions are visited
+
+	// hardware-timed scan parameters, only supported by the NIDAQ
+	bool hardwareTimed = false;		// play the x/y scan as a DAQ waveform triggering the camera
+	RASTER_TIMING rasterTiming;		// exposure time and frame count are taken from the camera settings
 
 	CAMERA_SETTINGS camera;
 };
@@ -45,12 +56,18 @@ class Brillouin : public AcquisitionMode {
 	Q_OBJECT
 
 public:
-	Brillouin(QObject* parent, Acquisition* acquisition, Andor* andor, ScanControl** scanControl);
+	Brillouin(QObject* parent, Acquisition* acquisition, Camera** camera, ScanControl** scanControl);
 	~Brillouin();
 
 public slots:
-	void init() {};
+	void init();
 	void startRepetitions();
+	// acquires a single repetition at the current position, returns false if it was aborted
+	bool acquireRepetition();
+	// continues the last repetition of the opened file at the first position which was not written
+	void resumeRepetition();
+	// [s] estimated duration of one repetition
+	double estimateDuration();
 
 	void setStepNumberX(int);
 	void setStepNumberY(int);
@@ -80,18 +97,43 @@ private:
 	BRILLOUIN_SETTINGS m_settings;
 	SCAN_ORDER m_scanOrder;
 	//Thread m_storageThread;
-	Andor* m_andor;
+	Camera** m_camera;
 	ScanControl** m_scanControl;
 	bool m_running = false;				// is acquisition currently running
 	POINT3 m_startPosition{ 0, 0, 0 };
+	DriftMonitor m_drift;
+	SCAN_CHECKPOINT m_resume;			// checkpoint of the repetition to resume, if valid
+
+	/*
+	 *	Repetition scheduling: the repetitions start at fixed deadlines relative to the start of the first one,
+	 *	so delays of single repetitions do not accumulate. In between, the thread returns to its event loop.
+	 */
+	QTimer* m_repetitionTimer = nullptr;	// fires at the deadline of the next repetition
+	QTimer* m_waitingTimer = nullptr;		// announces the remaining time until the next repetition
+	QElapsedTimer m_repetitionClock;		// started with the first repetition
+	gsl::index m_repetition{ 0 };			// number of the next repetition
+	// [ms] time until the deadline of the next repetition
+	qint64 timeToRepetition();
+	void scheduleRepetition();
 
 	int nrCalibrations = 1;
 	void calibrate(std::unique_ptr <StorageWrapper>& storage);
+	// elapsed: [s] time since the last calibration
+	bool isCalibrationDue(double elapsed);
+	// [%] progress towards the next calibration
+	int calibrationProgress(double elapsed);
+	void setTriggerMode(std::wstring triggerMode);
+	void logTiming(double stallDuration);
+	// [s] expected duration of the remaining positions, including the live calibrations
+	double remainingDuration(int64_t remainingPositions);
+	void logTravel(const ScanPlan& plan);
 
 	void abortMode() override;
 
 private slots:
 	void acquire(std::unique_ptr <StorageWrapper>& storage) override;
+	void runRepetition();
+	void announceWaiting();
 
 signals:
 	// current position in x, y and z, as well as the current image number
@@ -45,6 +45,14 @@ std::vector<ChannelSettings*> Fluorescence::getEnabledChannels() {
 	return enabledChannels;
 }
 
+std::vector<ChannelSettings> Fluorescence::getEnabledChannelSettings() {
+	std::vector<ChannelSettings> channels;
+	for (auto const& channel : getEnabledChannels()) {
+		channels.push_back(*channel);
+	}
+	return channels;
+}
+
 void Fluorescence::configureCamera() {
 
 	std::string cameraType = typeid(**m_camera).name();
@@ -189,8 +197,25 @@ void Fluorescence::acquire(std::unique_ptr <StorageWrapper>& storage, std::vecto
 		}
 	}
 
-	QElapsedTimer measurementTimer;
-	measurementTimer.start();
+	m_phases.reset();
+
+	// [s] expected duration of the channels from the first one on, the current camera settings are applied
+	auto remainingDuration = [&](gsl::index first) {
+		double remaining{ 0 };
+		double exposure = m_settings.camera.exposureTime;
+		double gain = m_settings.camera.gain;
+		for (gsl::index i{ first }; i < (gsl::index)channels.size(); i++) {
+			remaining += m_phases.mean(ACQUISITION_PHASE::PRESET) + m_phases.mean(ACQUISITION_PHASE::EXPOSURE, 1e-3 * channels[i]->exposure)
+				+ m_phases.mean(ACQUISITION_PHASE::PACKAGING) + m_phases.mean(ACQUISITION_PHASE::ENQUEUE);
+			// two frames are discarded if the exposure time or the gain changes
+			if (((int)1e3*exposure != channels[i]->exposure) || (gain != channels[i]->gain)) {
+				remaining += m_phases.mean(ACQUISITION_PHASE::SETTLE, 2e-3 * channels[i]->exposure);
+			}
+			exposure = 1e-3 * channels[i]->exposure;
+			gain = channels[i]->gain;
+		}
+		return remaining;
+	};
 
 	int rank_data{ 3 };
 	hsize_t dims_data[3] = { 1, m_settings.camera.roi.height, m_settings.camera.roi.width };
@@ -205,7 +230,10 @@ void Fluorescence::acquire(std::unique_ptr <StorageWrapper>& storage, std::vecto
 		}
 
 		// move to Fluorescence configuration
-		(*m_scanControl)->setPreset(channel->preset);
+		{
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::PRESET);
+			(*m_scanControl)->setPreset(channel->preset);
+		}
 
 		/*
 		 * We have to check if the exposure time or gain settings will change.
@@ -223,44 +251,61 @@ void Fluorescence::acquire(std::unique_ptr <StorageWrapper>& storage, std::vecto
 		m_settings.camera.gain = channel->gain;
 
 		if (changed) {
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::SETTLE);
 			m_settings.camera.frameCount = 2;
 			(*m_camera)->startAcquisition(m_settings.camera);
 			(*m_camera)->getImageForAcquisition(nullptr, false);
 			(*m_camera)->getImageForAcquisition(nullptr, false);
 			(*m_camera)->stopAcquisition();
 		}
+		// drop the metadata of the trashed frames
+		(*m_camera)->takeMetadata();
 
-		// start image acquisition
-		m_settings.camera.frameCount = 1;
-		(*m_camera)->startAcquisition(m_settings.camera);
+		// read images from camera directly into a recycled payload buffer
+		std::vector<unsigned char> images = storage->m_brightfieldPool.getBuffer(bytesPerFrame);
 
-		// read images from camera
-		std::vector<unsigned char> images(bytesPerFrame);
+		{
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::EXPOSURE);
+			// start image acquisition
+			m_settings.camera.frameCount = 1;
+			(*m_camera)->startAcquisition(m_settings.camera);
 
 			// acquire images
-		int64_t pointerPos = 0 * (int64_t)bytesPerFrame;
-		(*m_camera)->getImageForAcquisition(&images[pointerPos], true);
-
-		// cast the vector to unsigned short
-		std::vector<unsigned char>* images_ = (std::vector<unsigned char> *) &images;
+			int64_t pointerPos = 0 * (int64_t)bytesPerFrame;
+			(*m_camera)->getImageForAcquisition(&images[pointerPos], true);
+		}
 
 		// store images
 		// asynchronously write image to disk
-		// the datetime has to be set here, otherwise it would be determined by the time the queue is processed
-		std::string date = QDateTime::currentDateTime().toOffsetFromUtc(QDateTime::currentDateTime().offsetFromUtc())
-			.toString(Qt::ISODateWithMs).toStdString();
-		FLUOIMAGE* img = new FLUOIMAGE(imageNumber, rank_data, dims_data, date, channel->name, *images_);
+		FLUOIMAGE* img{ nullptr };
+		{
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::PACKAGING);
+			// the datetime has to be set here, otherwise it would be determined by the time the queue is processed
+			std::string date = QDateTime::currentDateTime().toOffsetFromUtc(QDateTime::currentDateTime().offsetFromUtc())
+				.toString(Qt::ISODateWithMs).toStdString();
+			img = new FLUOIMAGE(imageNumber, rank_data, dims_data, date, channel->name, std::move(images));
+		}
 
-		QMetaObject::invokeMethod(storage.get(), "s_enqueuePayload", Qt::AutoConnection, Q_ARG(FLUOIMAGE*, img));
+		// blocks if the storage queues exceed their memory limit
+		{
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::ENQUEUE);
+			storage->s_enqueuePayload(img, (*m_camera)->takeMetadata());
+		}
 
 		// configure camera for preview
 		(*m_camera)->stopAcquisition();
 		imageNumber++;
 		double percentage = 100 * (double)imageNumber / channels.size();
-		int remaining = 1e-3 * measurementTimer.elapsed() / imageNumber * ((int64_t)channels.size() - imageNumber);
+		int remaining = remainingDuration(imageNumber);
 		emit(s_repetitionProgress(percentage, remaining));
+		announcePhaseTiming();
 	}
 
+	// wait until the writer thread stored all payloads
+	storage->waitForQueues();
+	storePhaseTiming(storage, ACQUISITION_MODE::FLUORESCENCE);
+	storage->logStatistics();
+
 	m_status = ACQUISITION_STATUS::FINISHED;
 	emit(s_acquisitionStatus(m_status));
 }
@@ -47,6 +47,8 @@ public slots:
 	void setExposure(FLUORESCENCE_MODE, int);
 	void setGain(FLUORESCENCE_MODE mode, int gain);
 	void startStopPreview(FLUORESCENCE_MODE);
+	// copies of the settings of the enabled channels
+	std::vector<ChannelSettings> getEnabledChannelSettings();
 
 private:
 	Camera** m_camera;
@@ -111,13 +111,23 @@ void ODT::startRepetitions() {
 void ODT::acquire(std::unique_ptr <StorageWrapper> & storage) {
 	m_status = ACQUISITION_STATUS::STARTED;
 	emit(s_acquisitionStatus(m_status));
+	m_phases.reset();
 
 	// move to ODT configuration
-	(*m_NIDAQ)->setPreset(SCAN_ODT);
+	{
+		PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::PRESET);
+		(*m_NIDAQ)->setPreset(SCAN_ODT);
+	}
 
 	// Set first mirror voltage already
-	(*m_NIDAQ)->setVoltage(m_acqSettings.voltages[0]);
-	Sleep(100);
+	{
+		PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::MOVE);
+		(*m_NIDAQ)->setVoltage(m_acqSettings.voltages[0]);
+	}
+	{
+		PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::SETTLE);
+		Sleep(100);
+	}
 
 	ACQ_VOLTAGES voltages;
 
@@ -136,16 +146,21 @@ void ODT::acquire(std::unique_ptr <StorageWrapper> & storage) {
 		std::fill_n(voltages.mirror.begin() + i * samplesPerAngle, samplesPerAngle, m_acqSettings.voltages[i].Ux);
 		std::fill_n(voltages.mirror.begin() + i * samplesPerAngle + m_acqSettings.numberPoints * samplesPerAngle, samplesPerAngle, m_acqSettings.voltages[i].Uy);
 	}
-	// Apply voltages to NIDAQ board
-	(*m_NIDAQ)->setAcquisitionVoltages(voltages);
+	// Apply voltages to NIDAQ board, the mirrors are moved by the camera triggers from now on
+	{
+		PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::MOVE);
+		(*m_NIDAQ)->setAcquisitionVoltages(voltages);
+	}
 
 	int rank_data{ 3 };
 	hsize_t dims_data[3] = { 1, m_acqSettings.camera.roi.height, m_acqSettings.camera.roi.width };
 	int bytesPerFrame = m_acqSettings.camera.roi.width * m_acqSettings.camera.roi.height;
 	for (gsl::index i{ 0 }; i < m_acqSettings.numberPoints; i++) {
 
-		// read images from camera
-		std::vector<unsigned char> images(bytesPerFrame);
+		// read images from camera directly into a recycled payload buffer
+		std::vector<unsigned char> images = storage->m_brightfieldPool.getBuffer(bytesPerFrame);
+		// drop the metadata of frames which do not belong to this point
+		(*m_camera)->takeMetadata();
 
 		for (gsl::index mm{ 0 }; mm < 1; mm++) {
 			if (m_abort) {
@@ -154,23 +169,41 @@ void ODT::acquire(std::unique_ptr <StorageWrapper> & storage) {
 			}
 
 			// acquire images
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::EXPOSURE);
 			int64_t pointerPos = (int64_t)bytesPerFrame * mm;
 			(*m_camera)->getImageForAcquisition(&images[pointerPos], false);
 		}
 
-		// cast the vector to unsigned short
-		std::vector<unsigned char>* images_ = (std::vector<unsigned char> *) &images;
-
 		// store images
 		// asynchronously write image to disk
-		// the datetime has to be set here, otherwise it would be determined by the time the queue is processed
-		std::string date = QDateTime::currentDateTime().toOffsetFromUtc(QDateTime::currentDateTime().offsetFromUtc())
-			.toString(Qt::ISODateWithMs).toStdString();
-		ODTIMAGE* img = new ODTIMAGE((int)i, rank_data, dims_data, date, *images_);
+		ODTIMAGE* img{ nullptr };
+		{
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::PACKAGING);
+			// the datetime has to be set here, otherwise it would be determined by the time the queue is processed
+			std::string date = QDateTime::currentDateTime().toOffsetFromUtc(QDateTime::currentDateTime().offsetFromUtc())
+				.toString(Qt::ISODateWithMs).toStdString();
+			img = new ODTIMAGE((int)i, rank_data, dims_data, date, std::move(images));
+		}
 
-		QMetaObject::invokeMethod(storage.get(), "s_enqueuePayload", Qt::AutoConnection, Q_ARG(ODTIMAGE*, img));
+		// blocks if the storage queues exceed their memory limit
+		{
+			PhaseTimer::Scope phase(m_phases, ACQUISITION_PHASE::ENQUEUE);
+			storage->s_enqueuePayload(img, (*m_camera)->takeMetadata());
+		}
+
+		double percentage = 100 * (double)(i + 1) / m_acqSettings.numberPoints;
+		double perImage = m_phases.mean(ACQUISITION_PHASE::EXPOSURE) + m_phases.mean(ACQUISITION_PHASE::PACKAGING)
+			+ m_phases.mean(ACQUISITION_PHASE::ENQUEUE);
+		int remaining = perImage * ((int64_t)m_acqSettings.numberPoints - i - 1);
+		emit(s_repetitionProgress(percentage, remaining));
+		announcePhaseTiming();
 	}
 
+	// wait until the writer thread stored all payloads
+	storage->waitForQueues();
+	storePhaseTiming(storage, ACQUISITION_MODE::ODT);
+	storage->logStatistics();
+
 	m_status = ACQUISITION_STATUS::FINISHED;
 	emit(s_acquisitionStatus(m_status));
 }
@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "MultiSite.h"
+#include "../logger.h"
+#include "../simplemath.h"
+
+MultiSite::MultiSite(QObject* parent, Brillouin* brillouin, Fluorescence** fluorescence, ScanControl** scanControl)
+	: QObject(parent), m_brillouin(brillouin), m_fluorescence(fluorescence), m_scanControl(scanControl) {
+}
+
+MultiSite::~MultiSite() {
+}
+
+double MultiSite::travelTime(POINT3 from, POINT3 to, POINT3 speed) {
+	return simplemath::max<double>({
+		abs(to.x - from.x) / speed.x,
+		abs(to.y - from.y) / speed.y,
+		abs(to.z - from.z) / speed.z
+	});
+}
+
+SITE_ROUTE MultiSite::planRoute(POINT3 start, const std::vector<POINT3>& sites, POINT3 speed) {
+	SITE_ROUTE route;
+	int count = (int)sites.size();
+
+	// nearest neighbour, starting at the current position
+	std::vector<bool> visited(count, false);
+	POINT3 current = start;
+	for (gsl::index i{ 0 }; i < count; i++) {
+		int nearest{ -1 };
+		double nearestTime{ 0 };
+		for (gsl::index j{ 0 }; j < count; j++) {
+			if (visited[j]) {
+				continue;
+			}
+			double time = travelTime(current, sites[j], speed);
+			if (nearest < 0 || time < nearestTime) {
+				nearest = (int)j;
+				nearestTime = time;
+			}
+		}
+		visited[nearest] = true;
+		route.order.push_back(nearest);
+		current = sites[nearest];
+	}
+
+	// 2-opt, the start is fixed and the route does not return to it
+	auto point = [&](gsl::index i) {
+		return (i < 0) ? start : sites[route.order[i]];
+	};
+	bool improved{ true };
+	while (improved) {
+		improved = false;
+		for (gsl::index i{ 0 }; i < count - 1; i++) {
+			for (gsl::index j{ i + 1 }; j < count; j++) {
+				// reversing the sites i to j replaces the edges (i - 1, i) and (j, j + 1)
+				double before = travelTime(point(i - 1), point(i), speed);
+				double after = travelTime(point(i - 1), point(j), speed);
+				if (j + 1 < count) {
+					before += travelTime(point(j), point(j + 1), speed);
+					after += travelTime(point(i), point(j + 1), speed);
+				}
+				if (after < before - 1e-9) {
+					std::reverse(route.order.begin() + i, route.order.begin() + j + 1);
+					improved = true;
+				}
+			}
+		}
+	}
+
+	for (gsl::index i{ 0 }; i < count; i++) {
+		POINT3 distance = point(i) - point(i - 1);
+		route.length += sqrt(pow(distance.x, 2) + pow(distance.y, 2) + pow(distance.z, 2));
+		route.travelTime += travelTime(point(i - 1), point(i), speed);
+	}
+	return route;
+}
+
+void MultiSite::setSettings(MULTISITE_SETTINGS settings) {
+	m_settings = settings;
+}
+
+SITE_ROUTE MultiSite::announceRoute() {
+	std::vector<POINT3> sites = (*m_scanControl)->getSavedPositions();
+	SITE_ROUTE route = planRoute((*m_scanControl)->getPosition(), sites, m_settings.speed);
+	route.duration = route.travelTime + sites.size() * m_brillouin->estimateDuration();
+	emit(s_routePlanned(route));
+	return route;
+}
+
+void MultiSite::startSites() {
+	std::vector<POINT3> sites = (*m_scanControl)->getSavedPositions();
+	if (sites.empty()) {
+		std::string info = "Multi-site acquisition: there are no saved positions.";
+		qWarning(logWarning()) << info.c_str();
+		return;
+	}
+
+	m_abort = false;
+	m_status = ACQUISITION_STATUS::STARTED;
+	emit(s_acquisitionStatus(m_status));
+
+	SITE_ROUTE route = announceRoute();
+	std::string info = "Multi-site acquisition started: " + std::to_string(sites.size()) + " sites, route length "
+		+ std::to_string((int)round(route.length)) + " um, travelling " + std::to_string((int)round(route.travelTime))
+		+ " s, estimated duration " + std::to_string((int)round(route.duration / 60)) + " min.";
+	qInfo(logInfo()) << info.c_str();
+
+	bool fluorescence = m_settings.fluorescence && (*m_fluorescence) != nullptr;
+	QElapsedTimer acquisitionTimer;
+	acquisitionTimer.start();
+	for (gsl::index i{ 0 }; i < (gsl::index)route.order.size(); i++) {
+		if (m_abort) {
+			break;
+		}
+		int site = route.order[i];
+		POINT3 position = sites[site];
+		info = "Multi-site acquisition: site " + std::to_string(i + 1) + " of " + std::to_string(sites.size())
+			+ " (saved position " + std::to_string(site + 1) + ") at " + std::to_string(position.x) + ", "
+			+ std::to_string(position.y) + ", " + std::to_string(position.z) + " um.";
+		qInfo(logInfo()) << info.c_str();
+
+		(*m_scanControl)->setPosition(position);
+
+		// every site is its own repetition
+		if (!m_brillouin->acquireRepetition()) {
+			// the Brillouin acquisition was aborted
+			m_abort = true;
+			break;
+		}
+		if (fluorescence && !m_abort) {
+			(*m_fluorescence)->startRepetitions();
+		}
+
+		// the remaining time is extrapolated from the sites acquired so far
+		int remaining = 1e-3 * acquisitionTimer.elapsed() / (i + 1) * (route.order.size() - i - 1);
+		emit(s_siteProgress((int)i + 1, (int)sites.size(), remaining));
+	}
+
+	m_status = m_abort ? ACQUISITION_STATUS::ABORTED : ACQUISITION_STATUS::FINISHED;
+	emit(s_acquisitionStatus(m_status));
+	info = std::string("Multi-site acquisition ") + (m_abort ? "aborted" : "finished")
+		+ " after " + std::to_string((int)round(1e-3 * acquisitionTimer.elapsed() / 60)) + " min.";
+	qInfo(logInfo()) << info.c_str();
+}
+
+ACQUISITION_STATUS MultiSite::getStatus() {
+	return m_status;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef MULTISITE_H
+#define MULTISITE_H
+
+#include "AcquisitionModes/Brillouin.h"
+#include "AcquisitionModes/Fluorescence.h"
+
+struct MULTISITE_SETTINGS {
+	bool fluorescence{ false };			//		acquire the enabled fluorescence channels at every site as well
+	POINT3 speed{ 1000, 1000, 100 };	// [m/s]	travel speed of the axes, weights the route
+};
+
+struct SITE_ROUTE {
+	std::vector<int> order;		// [1]	indices of the saved positions in the order they are visited
+	double length{ 0 };			// [m]	length of the route starting at the current position
+	double travelTime{ 0 };		// [s]	time spent moving between the sites
+	double duration{ 0 };		// [s]	estimated duration including the acquisitions
+};
+
+/*
+ * Runs the configured acquisitions at every saved position of the scan control.
+ *
+ * The sites are visited along a short route, which is found by the nearest neighbour heuristic
+ * and improved by 2-opt. The axes move simultaneously, so the distance between two sites is the
+ * longest travel time of the axes. Every site is written as its own repetition.
+ */
+class MultiSite : public QObject {
+	Q_OBJECT
+
+public:
+	MultiSite(QObject* parent, Brillouin* brillouin, Fluorescence** fluorescence, ScanControl** scanControl);
+	~MultiSite();
+	bool m_abort = false;
+
+	// [s] time to travel between the positions
+	static double travelTime(POINT3 from, POINT3 to, POINT3 speed);
+	static SITE_ROUTE planRoute(POINT3 start, const std::vector<POINT3>& sites, POINT3 speed);
+
+public slots:
+	void init() {};
+	void setSettings(MULTISITE_SETTINGS settings);
+	// plans the route through the currently saved positions and announces it
+	SITE_ROUTE announceRoute();
+	void startSites();
+	ACQUISITION_STATUS getStatus();
+
+private:
+	Brillouin* m_brillouin;
+	Fluorescence** m_fluorescence;
+	ScanControl** m_scanControl;
+	MULTISITE_SETTINGS m_settings;
+	ACQUISITION_STATUS m_status{ ACQUISITION_STATUS::DISABLED };
+
+signals:
+	void s_routePlanned(SITE_ROUTE);
+	void s_acquisitionStatus(ACQUISITION_STATUS);
+	// number of finished sites, number of sites and the remaining time in seconds
+	void s_siteProgress(int, int, int);
+};
+
+#endif //MULTISITE_H
\ No newline at end of file
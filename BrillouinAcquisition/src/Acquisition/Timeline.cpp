@@ -0,0 +1,303 @@
+#include "stdafx.h"
+#include "Timeline.h"
+#include "../logger.h"
+#include "../simplemath.h"
+
+Timeline::Timeline(QObject* parent, Brillouin* brillouin, Fluorescence** fluorescence, ODT** odt, ScanControl** scanControl)
+	: QObject(parent), m_brillouin(brillouin), m_fluorescence(fluorescence), m_odt(odt), m_scanControl(scanControl) {
+}
+
+Timeline::~Timeline() {
+}
+
+void Timeline::init() {
+	// the timers have to be created on the acquisition thread
+	m_eventTimer = new QTimer(this);
+	m_eventTimer->setSingleShot(true);
+	m_eventTimer->setTimerType(Qt::PreciseTimer);
+	QMetaObject::Connection connection = QWidget::connect(m_eventTimer, SIGNAL(timeout()), this, SLOT(runDueEvents()));
+
+	m_waitingTimer = new QTimer(this);
+	connection = QWidget::connect(m_waitingTimer, SIGNAL(timeout()), this, SLOT(announceWaiting()));
+}
+
+std::vector<TIMELINE_EVENT> Timeline::planEvents(const TIMELINE_SETTINGS& settings) {
+	std::vector<TIMELINE_EVENT> events;
+	// [ms] the time-lapse ends with the last Brillouin repetition
+	double duration = (settings.repetitions.count - 1) * settings.repetitions.interval * 60e3;
+
+	auto addStream = [&](TIMELINE_STREAM stream, double interval, int count) {
+		for (gsl::index i{ 0 }; i < count; i++) {
+			TIMELINE_EVENT event;
+			event.stream = stream;
+			event.index = (int)i;
+			event.deadline = (qint64)(i * interval * 60e3);
+			events.push_back(event);
+		}
+	};
+	// the other streams are acquired as often as their interval fits into the time-lapse
+	auto countEvents = [&](double interval) {
+		return (interval > 0) ? (int)floor(duration / (interval * 60e3) + 1e-9) + 1 : 1;
+	};
+
+	addStream(TIMELINE_STREAM::BRILLOUIN, settings.repetitions.interval, settings.repetitions.count);
+	if (settings.fluorescence) {
+		addStream(TIMELINE_STREAM::FLUORESCENCE, settings.fluorescenceInterval, countEvents(settings.fluorescenceInterval));
+	}
+	if (settings.odt) {
+		addStream(TIMELINE_STREAM::ODT, settings.odtInterval, countEvents(settings.odtInterval));
+	}
+
+	// at the same deadline the Brillouin repetitions go first
+	std::stable_sort(events.begin(), events.end(), [](const TIMELINE_EVENT& a, const TIMELINE_EVENT& b) {
+		return (a.deadline < b.deadline) || (a.deadline == b.deadline && a.stream < b.stream);
+	});
+	return events;
+}
+
+void Timeline::setSettings(TIMELINE_SETTINGS settings) {
+	m_settings = settings;
+}
+
+void Timeline::startTimeline() {
+	// the streams of modes which are not available are left out
+	TIMELINE_SETTINGS settings = m_settings;
+	settings.fluorescence &= (*m_fluorescence) != nullptr;
+	settings.odt &= (*m_odt) != nullptr;
+
+	m_abort = false;
+	m_pending = planEvents(settings);
+	m_eventCount = (int)m_pending.size();
+	m_finished = 0;
+	m_skipped = 0;
+	m_durations = {};
+	m_durations[(int)TIMELINE_STREAM::BRILLOUIN] = m_brillouin->estimateDuration();
+
+	m_status = ACQUISITION_STATUS::STARTED;
+	emit(s_acquisitionStatus(m_status));
+
+	std::array<int, (int)TIMELINE_STREAM::COUNT> counts{};
+	for (auto const& event : m_pending) {
+		counts[(int)event.stream]++;
+	}
+	std::string info = "Time-lapse started: " + std::to_string(counts[(int)TIMELINE_STREAM::BRILLOUIN]) + " Brillouin repetitions, "
+		+ std::to_string(counts[(int)TIMELINE_STREAM::FLUORESCENCE]) + " fluorescence snapshots and "
+		+ std::to_string(counts[(int)TIMELINE_STREAM::ODT]) + " ODT acquisitions within "
+		+ std::to_string((int)round((settings.repetitions.count - 1) * settings.repetitions.interval)) + " min.";
+	qInfo(logInfo()) << info.c_str();
+
+	m_clock.start();
+	runDueEvents();
+}
+
+void Timeline::runDueEvents() {
+	m_waitingTimer->stop();
+	if (m_abort) {
+		finish(ACQUISITION_STATUS::ABORTED);
+		return;
+	}
+
+	qint64 now = m_clock.elapsed();
+	gsl::index dueCount{ 0 };
+	while (dueCount < (gsl::index)m_pending.size() && m_pending[dueCount].deadline <= now) {
+		dueCount++;
+	}
+	std::vector<TIMELINE_EVENT> due(m_pending.begin(), m_pending.begin() + dueCount);
+	m_pending.erase(m_pending.begin(), m_pending.begin() + dueCount);
+
+	// only the last due event of the other streams is acquired, the earlier ones were due during other acquisitions
+	for (auto stream : { TIMELINE_STREAM::FLUORESCENCE, TIMELINE_STREAM::ODT }) {
+		auto isStream = [stream](const TIMELINE_EVENT& event) { return event.stream == stream; };
+		int count = (int)std::count_if(due.begin(), due.end(), isStream);
+		if (count < 2) {
+			continue;
+		}
+		auto last = std::find_if(due.rbegin(), due.rend(), isStream);
+		TIMELINE_EVENT event = *last;
+		due.erase(std::remove_if(due.begin(), due.end(), isStream), due.end());
+		due.push_back(event);
+		m_skipped += count - 1;
+		m_finished += count - 1;
+		std::string info = "Time-lapse: skipping " + std::to_string(count - 1)
+			+ ((stream == TIMELINE_STREAM::FLUORESCENCE) ? " fluorescence snapshots" : " ODT acquisitions")
+			+ ", they were due during other acquisitions.";
+		qWarning(logWarning()) << info.c_str();
+	}
+
+	// the events which would delay the next Brillouin repetition are deferred behind it once
+	auto nextBrillouin = std::find_if(m_pending.begin(), m_pending.end(), [](const TIMELINE_EVENT& event) {
+		return event.stream == TIMELINE_STREAM::BRILLOUIN;
+	});
+	if (nextBrillouin != m_pending.end()) {
+		qint64 deadline = nextBrillouin->deadline;
+		// [ms] expected time the due events end
+		double end = (double)now;
+		for (auto const& event : due) {
+			if (event.stream == TIMELINE_STREAM::BRILLOUIN) {
+				end += 1e3 * m_durations[(int)event.stream];
+			}
+		}
+		// every kept event delays the events after it, they are visited in the order they became due
+		for (gsl::index i{ 0 }; i < (gsl::index)due.size();) {
+			TIMELINE_EVENT& event = due[i];
+			double duration = 1e3 * m_durations[(int)event.stream];
+			if (event.stream == TIMELINE_STREAM::BRILLOUIN) {
+				i++;
+				continue;
+			}
+			if (!event.deferred && duration > 0 && end + duration > deadline) {
+				event.deferred = true;
+				event.deadline = deadline;
+				// behind the Brillouin repetition of the same deadline
+				m_pending.insert(std::upper_bound(m_pending.begin(), m_pending.end(), event, [](const TIMELINE_EVENT& a, const TIMELINE_EVENT& b) {
+					return (a.deadline < b.deadline) || (a.deadline == b.deadline && a.stream < b.stream);
+				}), event);
+				due.erase(due.begin() + i);
+				continue;
+			}
+			end += duration;
+			i++;
+		}
+	}
+
+	// the Brillouin repetitions define the time-lapse, so they run first
+	for (auto const& event : due) {
+		if (event.stream == TIMELINE_STREAM::BRILLOUIN && !runEvent(event)) {
+			return;
+		}
+	}
+	due.erase(std::remove_if(due.begin(), due.end(), [](const TIMELINE_EVENT& event) {
+		return event.stream == TIMELINE_STREAM::BRILLOUIN;
+	}), due.end());
+
+	// the other events are ordered, so the fewest elements move between the presets
+	std::vector<ChannelSettings> channels;
+	if ((*m_fluorescence) != nullptr) {
+		channels = (*m_fluorescence)->getEnabledChannelSettings();
+	}
+	while (!due.empty()) {
+		std::vector<int> positions = (*m_scanControl)->m_elementPositions;
+		auto next = std::min_element(due.begin(), due.end(), [&](const TIMELINE_EVENT& a, const TIMELINE_EVENT& b) {
+			return countStartMoves(a.stream, channels, positions) < countStartMoves(b.stream, channels, positions);
+		});
+		TIMELINE_EVENT event = *next;
+		due.erase(next);
+		if (!runEvent(event)) {
+			return;
+		}
+	}
+
+	schedule();
+}
+
+int Timeline::countStartMoves(TIMELINE_STREAM stream, const std::vector<ChannelSettings>& channels, const std::vector<int>& positions) {
+	switch (stream) {
+		case TIMELINE_STREAM::BRILLOUIN:
+			return (*m_scanControl)->countPresetMoves(SCAN_BRILLOUIN, positions);
+		case TIMELINE_STREAM::ODT:
+			return (*m_scanControl)->countPresetMoves(SCAN_ODT, positions);
+		case TIMELINE_STREAM::FLUORESCENCE: {
+			// the channels are ordered, so the acquisition starts with the closest one
+			int moves{ 0 };
+			for (gsl::index i{ 0 }; i < (gsl::index)channels.size(); i++) {
+				int channelMoves = (*m_scanControl)->countPresetMoves(channels[i].preset, positions);
+				moves = (i == 0) ? channelMoves : simplemath::min<int>({ moves, channelMoves });
+			}
+			return moves;
+		}
+		default:
+			return 0;
+	}
+}
+
+std::vector<FLUORESCENCE_MODE> Timeline::orderChannels(std::vector<ChannelSettings> channels, std::vector<int> positions) {
+	std::vector<FLUORESCENCE_MODE> modes;
+	// greedy, the next channel is the one whose preset moves the fewest elements
+	while (!channels.empty()) {
+		auto next = std::min_element(channels.begin(), channels.end(), [&](const ChannelSettings& a, const ChannelSettings& b) {
+			return (*m_scanControl)->countPresetMoves(a.preset, positions) < (*m_scanControl)->countPresetMoves(b.preset, positions);
+		});
+		positions = (*m_scanControl)->applyPreset(next->preset, positions);
+		modes.push_back(next->mode);
+		channels.erase(next);
+	}
+	return modes;
+}
+
+bool Timeline::runEvent(const TIMELINE_EVENT& event) {
+	QElapsedTimer eventTimer;
+	eventTimer.start();
+
+	bool aborted{ false };
+	switch (event.stream) {
+		case TIMELINE_STREAM::BRILLOUIN:
+			aborted = !m_brillouin->acquireRepetition();
+			break;
+		case TIMELINE_STREAM::FLUORESCENCE: {
+			auto modes = orderChannels((*m_fluorescence)->getEnabledChannelSettings(), (*m_scanControl)->m_elementPositions);
+			if (!modes.empty()) {
+				(*m_fluorescence)->startRepetitions(modes);
+				aborted = (*m_fluorescence)->getStatus() == ACQUISITION_STATUS::ABORTED;
+			}
+			break;
+		}
+		case TIMELINE_STREAM::ODT:
+			(*m_odt)->startRepetitions();
+			aborted = (*m_odt)->getStatus() == ACQUISITION_STATUS::ABORTED;
+			break;
+		default:
+			break;
+	}
+	m_durations[(int)event.stream] = 1e-3 * eventTimer.elapsed();
+	m_finished++;
+
+	if (aborted || m_abort) {
+		finish(ACQUISITION_STATUS::ABORTED);
+		return false;
+	}
+	emit(s_timelineProgress(m_finished, m_eventCount, 0));
+	return true;
+}
+
+void Timeline::schedule() {
+	if (m_pending.empty()) {
+		finish(ACQUISITION_STATUS::FINISHED);
+		return;
+	}
+	// an event which is already due is started from the event loop as well, so queued calls are handled first
+	m_eventTimer->start(simplemath::max<qint64>({ m_pending.front().deadline - m_clock.elapsed(), 0 }));
+	m_waitingTimer->start(1000);
+	announceWaiting();
+}
+
+void Timeline::announceWaiting() {
+	if (m_abort) {
+		m_eventTimer->stop();
+		finish(ACQUISITION_STATUS::ABORTED);
+		return;
+	}
+	if (m_pending.empty()) {
+		return;
+	}
+	// round up, so the announced time only reaches zero when the event starts
+	qint64 remaining = m_pending.front().deadline - m_clock.elapsed();
+	emit(s_timelineProgress(m_finished, m_eventCount, (int)simplemath::max<qint64>({ (remaining + 999) / 1000, 0 })));
+}
+
+void Timeline::finish(ACQUISITION_STATUS status) {
+	m_eventTimer->stop();
+	m_waitingTimer->stop();
+	m_pending.clear();
+
+	m_status = status;
+	emit(s_acquisitionStatus(m_status));
+	std::string info = std::string("Time-lapse ") + ((status == ACQUISITION_STATUS::ABORTED) ? "aborted" : "finished")
+		+ " after " + std::to_string((int)round(1e-3 * m_clock.elapsed() / 60)) + " min, "
+		+ std::to_string(m_finished - m_skipped) + " of " + std::to_string(m_eventCount) + " events acquired, "
+		+ std::to_string(m_skipped) + " skipped.";
+	qInfo(logInfo()) << info.c_str();
+}
+
+ACQUISITION_STATUS Timeline::getStatus() {
+	return m_status;
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "AcquisitionModes/Brillouin.h"
+#include "AcquisitionModes/Fluorescence.h"
+#include "AcquisitionModes/ODT.h"
+
+enum class TIMELINE_STREAM {
+	BRILLOUIN,
+	FLUORESCENCE,
+	ODT,
+	COUNT
+};
+
+struct TIMELINE_SETTINGS {
+	REPETITIONS repetitions;				//			the Brillouin repetitions span the time-lapse
+	bool fluorescence{ true };				//			acquire the enabled fluorescence channels
+	double fluorescenceInterval{ 2 };		// [min]	interval of the fluorescence snapshots
+	bool odt{ false };						//			acquire ODT
+	double odtInterval{ 5 };				// [min]	interval of the ODT acquisitions
+};
+
+struct TIMELINE_EVENT {
+	TIMELINE_STREAM stream{ TIMELINE_STREAM::BRILLOUIN };
+	int index{ 0 };				// [1]	number of the event in its stream
+	qint64 deadline{ 0 };		// [ms]	time after the start of the time-lapse
+	bool deferred{ false };		//		moved behind a Brillouin repetition it would have delayed
+};
+
+/*
+ * Runs the Brillouin repetitions together with fluorescence snapshots and ODT acquisitions as one time-lapse.
+ *
+ * Every stream has its own interval, the events start at fixed deadlines relative to the start of the
+ * time-lapse, so the other streams are acquired in the waits between the Brillouin repetitions.
+ * In between, the thread returns to its event loop. The Brillouin repetitions define the time-lapse,
+ * so they run first if several events are due. A snapshot which would delay the next Brillouin repetition
+ * is deferred behind it once. The remaining due events and the fluorescence channels are ordered,
+ * so the fewest optical elements have to move between the presets. If several events of a stream
+ * are due, only the last one is acquired.
+ */
+class Timeline : public QObject {
+	Q_OBJECT
+
+public:
+	Timeline(QObject* parent, Brillouin* brillouin, Fluorescence** fluorescence, ODT** odt, ScanControl** scanControl);
+	~Timeline();
+	bool m_abort = false;
+
+	// events of the enabled streams sorted by their deadlines
+	static std::vector<TIMELINE_EVENT> planEvents(const TIMELINE_SETTINGS& settings);
+
+public slots:
+	void init();
+	void setSettings(TIMELINE_SETTINGS settings);
+	void startTimeline();
+	ACQUISITION_STATUS getStatus();
+
+private:
+	Brillouin* m_brillouin;
+	Fluorescence** m_fluorescence;
+	ODT** m_odt;
+	ScanControl** m_scanControl;
+	TIMELINE_SETTINGS m_settings;
+	ACQUISITION_STATUS m_status{ ACQUISITION_STATUS::DISABLED };
+
+	QTimer* m_eventTimer = nullptr;		// fires at the deadline of the next event
+	QTimer* m_waitingTimer = nullptr;	// announces the remaining time until the next event
+	QElapsedTimer m_clock;				// started with the time-lapse
+	std::vector<TIMELINE_EVENT> m_pending;
+	int m_eventCount{ 0 };
+	int m_finished{ 0 };
+	int m_skipped{ 0 };
+	// [s] duration of the last event of every stream, zero if unknown
+	std::array<double, (int)TIMELINE_STREAM::COUNT> m_durations{};
+
+	// number of elements which have to move to start the stream, starting at the element positions
+	int countStartMoves(TIMELINE_STREAM stream, const std::vector<ChannelSettings>& channels, const std::vector<int>& positions);
+	// orders the channels, so the fewest elements move starting at the element positions
+	std::vector<FLUORESCENCE_MODE> orderChannels(std::vector<ChannelSettings> channels, std::vector<int> positions);
+	// returns false if the event was aborted
+	bool runEvent(const TIMELINE_EVENT& event);
+	void schedule();
+	void finish(ACQUISITION_STATUS status);
+
+private slots:
+	void runDueEvents();
+	void announceWaiting();
+
+signals:
+	void s_acquisitionStatus(ACQUISITION_STATUS);
+	// number of finished events, number of events and the time until the next event in seconds
+	void s_timelineProgress(int, int, int);
+};
+
+#endif //TIMELINE_H
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "driftMonitor.h"
+
+DriftMonitor::DriftMonitor(int referenceFrames, double smoothing) noexcept :
+	m_referenceFrames(referenceFrames), m_smoothing(smoothing) {
+}
+
+void DriftMonitor::addFrame(const unsigned short* frame, int width, int height) {
+	if (frame == nullptr || width < 1 || height < 1) {
+		return;
+	}
+	// the elastic peak is the brightest spot of the frame
+	gsl::index maximum{ 0 };
+	gsl::index minimum{ 0 };
+	gsl::index size = (gsl::index)width * height;
+	for (gsl::index i{ 1 }; i < size; i++) {
+		if (frame[i] > frame[maximum]) {
+			maximum = i;
+		}
+		if (frame[i] < frame[minimum]) {
+			minimum = i;
+		}
+	}
+	int peakX = (int)(maximum % width);
+	int peakY = (int)(maximum / width);
+
+	// refine the position to subpixel accuracy by the centroid around the maximum
+	constexpr int radius{ 2 };
+	double background = frame[minimum];
+	double sum{ 0 };
+	double x{ 0 };
+	double y{ 0 };
+	for (int yy{ peakY - radius }; yy <= peakY + radius; yy++) {
+		for (int xx{ peakX - radius }; xx <= peakX + radius; xx++) {
+			if (xx < 0 || yy < 0 || xx >= width || yy >= height) {
+				continue;
+			}
+			double value = frame[(gsl::index)yy * width + xx] - background;
+			sum += value;
+			x += value * xx;
+			y += value * yy;
+		}
+	}
+	if (sum > 0) {
+		x /= sum;
+		y /= sum;
+	} else {
+		x = peakX;
+		y = peakY;
+	}
+
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	m_drift.frames++;
+	if (m_drift.frames <= m_referenceFrames) {
+		// average the reference frames
+		m_referenceX += (x - m_referenceX) / m_drift.frames;
+		m_referenceY += (y - m_referenceY) / m_drift.frames;
+		m_drift.x = m_referenceX;
+		m_drift.y = m_referenceY;
+		m_drift.valid = (m_drift.frames == m_referenceFrames);
+	} else {
+		m_drift.x += m_smoothing * (x - m_drift.x);
+		m_drift.y += m_smoothing * (y - m_drift.y);
+	}
+	m_drift.drift = sqrt(pow(m_drift.x - m_referenceX, 2) + pow(m_drift.y - m_referenceY, 2));
+}
+
+void DriftMonitor::reset() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	m_drift = DRIFT{};
+	m_referenceX = 0;
+	m_referenceY = 0;
+}
+
+DRIFT DriftMonitor::getDrift() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	return m_drift;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef DRIFTMONITOR_H
+#define DRIFTMONITOR_H
+
+#include <mutex>
+#include <gsl/gsl>
+
+struct DRIFT {
+	bool valid{ false };	//		a reference and a current peak position are available
+	double x{ 0 };			// [pix]	current position of the elastic peak
+	double y{ 0 };			// [pix]
+	double drift{ 0 };		// [pix]	distance of the current to the reference position
+	int frames{ 0 };		// [1]	frames measured since the last reset
+};
+
+/*
+ * Cheap drift indicator of the spectrometer.
+ *
+ * The position of the elastic peak, the brightest spot of the Brillouin spectrum, is measured
+ * in the regular measurement frames. The first frames after a calibration define the reference,
+ * the drift is the distance of the smoothed peak position to it.
+ */
+class DriftMonitor {
+
+public:
+	DriftMonitor(int referenceFrames = 5, double smoothing = 0.2) noexcept;
+
+	// measures the peak position in the frame, can be called from any thread
+	void addFrame(const unsigned short* frame, int width, int height);
+	// the following frames define a new reference
+	void reset();
+	DRIFT getDrift();
+
+private:
+	std::mutex m_mutex;
+	int m_referenceFrames;		// [1]	number of frames averaged for the reference
+	double m_smoothing;			// [1]	weight of a new frame in the smoothed peak position
+	double m_referenceX{ 0 };	// [pix]	reference position of the elastic peak
+	double m_referenceY{ 0 };	// [pix]
+	DRIFT m_drift;
+};
+
+#endif //DRIFTMONITOR_H
\ No newline at end of file
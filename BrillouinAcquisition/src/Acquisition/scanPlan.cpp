@@ -0,0 +1,60 @@
+#include "stdafx.h"
+#include "scanPlan.h"
+
+namespace {
+	std::array<int, 3> directionSteps(const std::array<SCAN_AXIS, 3>& axes, const std::array<int, 3>& order) {
+		std::array<int, 3> steps{ 1, 1, 1 };
+		for (gsl::index axis{ 0 }; axis < 3; axis++) {
+			steps[order[axis]] = axes[axis].steps;
+		}
+		return steps;
+	}
+}
+
+ScanPlan::ScanPlan(SCAN_TRAJECTORY type, std::array<SCAN_AXIS, 3> axes, std::array<int, 3> order, POINT3 origin) :
+	m_trajectory(type, directionSteps(axes, order)), m_axes(axes), m_order(order), m_origin(origin) {
+}
+
+int ScanPlan::count() const {
+	return m_trajectory.count();
+}
+
+bool ScanPlan::next(SCAN_POINT& point) {
+	SCAN_STEP step;
+	if (!m_trajectory.next(step)) {
+		return false;
+	}
+	for (gsl::index axis{ 0 }; axis < 3; axis++) {
+		point.indices[axis] = step.indices[m_order[axis]];
+	}
+	point.position = POINT3{
+		position(0, point.indices[0]),
+		position(1, point.indices[1]),
+		position(2, point.indices[2])
+	} + m_origin;
+	point.lineStart = step.lineStart;
+	return true;
+}
+
+void ScanPlan::reset() {
+	m_trajectory.reset();
+}
+
+double ScanPlan::position(int axis, int index) const {
+	const SCAN_AXIS& scanAxis = m_axes[axis];
+	if (scanAxis.steps < 2) {
+		return scanAxis.min;
+	}
+	return scanAxis.min + index * (scanAxis.max - scanAxis.min) / (scanAxis.steps - 1);
+}
+
+std::vector<std::vector<double>> ScanPlan::directions() const {
+	std::vector<std::vector<double>> directions(3);
+	for (gsl::index axis{ 0 }; axis < 3; axis++) {
+		std::vector<double>& direction = directions[m_order[axis]];
+		for (int index{ 0 }; index < m_axes[axis].steps; index++) {
+			direction.push_back(position((int)axis, index));
+		}
+	}
+	return directions;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef SCANPLAN_H
+#define SCANPLAN_H
+
+#include "scanTrajectory.h"
+#include "../Devices/scancontrol.h"
+
+// positions along one axis of the scan
+struct SCAN_AXIS {
+	double min{ 0 };	// [m]	first position
+	double max{ 0 };	// [m]	last position
+	int steps{ 1 };		// [1]	number of positions
+};
+
+// one position of the scan
+struct SCAN_POINT {
+	POINT3 position;				// [m]	stage position
+	std::array<int, 3> indices{};	// [1]	indices along x, y and z
+	bool lineStart{ false };		//		a new line starts at this position, so calibrations are allowed
+};
+
+/*
+ * Positions of a scan in the order they are visited.
+ *
+ * The positions are calculated from the axes when they are requested,
+ * so neither memory nor startup time scale with the number of positions.
+ */
+class ScanPlan {
+
+public:
+	// axes: x, y and z, order: scan direction of x, y and z, the fastest is 0
+	ScanPlan(SCAN_TRAJECTORY type, std::array<SCAN_AXIS, 3> axes, std::array<int, 3> order, POINT3 origin);
+
+	int count() const;
+	// returns false if all positions were visited
+	bool next(SCAN_POINT& point);
+	void reset();
+
+	// [m] position along the axis (0: x, 1: y, 2: z) relative to the origin
+	double position(int axis, int index) const;
+	// [m] positions along the scan directions, the fastest first
+	std::vector<std::vector<double>> directions() const;
+
+private:
+	ScanTrajectory m_trajectory;
+	std::array<SCAN_AXIS, 3> m_axes;
+	std::array<int, 3> m_order;
+	POINT3 m_origin;
+};
+
+#endif //SCANPLAN_H
\ No newline at end of file
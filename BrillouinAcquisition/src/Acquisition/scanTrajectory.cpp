@@ -0,0 +1,125 @@
+#include "stdafx.h"
+#include "scanTrajectory.h"
+
+namespace {
+	// point on a Hilbert curve through a square of the given side length, see https://en.wikipedia.org/wiki/Hilbert_curve
+	std::array<int, 2> hilbertPoint(int side, gsl::index distance) {
+		int x{ 0 };
+		int y{ 0 };
+		for (int s{ 1 }; s < side; s *= 2) {
+			int rx = 1 & (int)(distance / 2);
+			int ry = 1 & (int)(distance ^ rx);
+			// rotate the quadrant
+			if (ry == 0) {
+				if (rx == 1) {
+					x = s - 1 - x;
+					y = s - 1 - y;
+				}
+				std::swap(x, y);
+			}
+			x += s * rx;
+			y += s * ry;
+			distance /= 4;
+		}
+		return { x, y };
+	}
+}
+
+ScanTrajectory::ScanTrajectory(SCAN_TRAJECTORY type, std::array<int, 3> steps) : m_type(type), m_steps(steps) {
+	// the Hilbert curve covers the smallest square with a power of two side length containing a plane
+	while (m_curveSide < m_steps[0] || m_curveSide < m_steps[1]) {
+		m_curveSide *= 2;
+	}
+}
+
+std::vector<std::string> ScanTrajectory::names() {
+	return { "Raster", "Serpentine lines", "Serpentine planes", "Hilbert curve" };
+}
+
+int ScanTrajectory::count() const {
+	return m_steps[0] * m_steps[1] * m_steps[2];
+}
+
+bool ScanTrajectory::next(SCAN_STEP& step) {
+	if (m_point >= count()) {
+		return false;
+	}
+	int lineLength = m_steps[0];
+	gsl::index planeLength = (gsl::index)m_steps[0] * m_steps[1];
+	int plane = (int)(m_point / planeLength);
+	int line = (int)((m_point % planeLength) / lineLength);
+	int position = (int)(m_point % lineLength);
+
+	switch (m_type) {
+		case SCAN_TRAJECTORY::SERPENTINE_LINE:
+			step.indices = { (line % 2) ? lineLength - 1 - position : position, line, plane };
+			break;
+		case SCAN_TRAJECTORY::SERPENTINE_PLANE: {
+			// the direction of the lines alternates with every line visited, also across planes
+			gsl::index lineNumber = (gsl::index)plane * m_steps[1] + line;
+			step.indices = {
+				(lineNumber % 2) ? lineLength - 1 - position : position,
+				(plane % 2) ? m_steps[1] - 1 - line : line,
+				plane
+			};
+			break;
+		}
+		case SCAN_TRAJECTORY::HILBERT: {
+			std::array<int, 2> point;
+			nextHilbert(point);
+			step.indices = { point[0], point[1], plane };
+			break;
+		}
+		default:
+			step.indices = { position, line, plane };
+			break;
+	}
+	// the Hilbert curve has no lines, it allows calibrations as often as the other trajectories
+	step.lineStart = (position == 0);
+	m_point++;
+	return true;
+}
+
+void ScanTrajectory::reset() {
+	m_point = 0;
+	m_curve = 0;
+	m_plane = 0;
+}
+
+double ScanTrajectory::travel(const std::vector<std::vector<double>>& directions) {
+	reset();
+	double distance{ 0 };
+	std::array<double, 3> last{};
+	SCAN_STEP step;
+	for (gsl::index ll{ 0 }; next(step); ll++) {
+		std::array<double, 3> position{
+			directions[0][step.indices[0]],
+			directions[1][step.indices[1]],
+			directions[2][step.indices[2]]
+		};
+		if (ll > 0) {
+			distance += sqrt(pow(position[0] - last[0], 2) + pow(position[1] - last[1], 2) + pow(position[2] - last[2], 2));
+		}
+		last = position;
+	}
+	reset();
+	return distance;
+}
+
+bool ScanTrajectory::nextHilbert(std::array<int, 2>& point) {
+	gsl::index curveLength = (gsl::index)m_curveSide * m_curveSide;
+	// skip the points of the curve outside of the plane
+	while (true) {
+		if (m_curve >= curveLength) {
+			m_curve = 0;
+			m_plane++;
+		}
+		// every other plane is traversed backwards, so the planes are connected
+		gsl::index distance = (m_plane % 2) ? curveLength - 1 - m_curve : m_curve;
+		m_curve++;
+		point = hilbertPoint(m_curveSide, distance);
+		if (point[0] < m_steps[0] && point[1] < m_steps[1]) {
+			return true;
+		}
+	}
+}
\ No newline at end of file
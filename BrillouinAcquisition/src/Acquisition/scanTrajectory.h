@@ -0,0 +1,56 @@
+#ifndef SCANTRAJECTORY_H
+#define SCANTRAJECTORY_H
+
+#include <array>
+#include <vector>
+#include <string>
+#include <gsl/gsl>
+
+enum class SCAN_TRAJECTORY {
+	RASTER,				// every line starts at the beginning of the fastest direction
+	SERPENTINE_LINE,	// the fastest direction is reversed on every other line
+	SERPENTINE_PLANE,	// additionally the lines are reversed on every other plane
+	HILBERT,			// space-filling curve through every plane, best suited for square planes
+	COUNT
+};
+
+// one point of the trajectory
+struct SCAN_STEP {
+	std::array<int, 3> indices{};	// [1]	indices along the scan directions, the fastest first
+	bool lineStart{ false };		//		a new line starts at this point, so calibrations are allowed
+};
+
+/*
+ * Order in which the points of a scan are visited.
+ *
+ * The points are generated one after another, so the trajectory does not need
+ * any memory which scales with the number of points.
+ */
+class ScanTrajectory {
+
+public:
+	// steps: number of points along the scan directions, the fastest first
+	ScanTrajectory(SCAN_TRAJECTORY type, std::array<int, 3> steps);
+
+	static std::vector<std::string> names();
+
+	int count() const;
+	// returns false if all points were visited
+	bool next(SCAN_STEP& step);
+	void reset();
+
+	// [m] length of the path through the positions along the scan directions, the fastest first
+	double travel(const std::vector<std::vector<double>>& directions);
+
+private:
+	bool nextHilbert(std::array<int, 2>& point);
+
+	SCAN_TRAJECTORY m_type;
+	std::array<int, 3> m_steps;
+	gsl::index m_point{ 0 };		// number of points visited
+	gsl::index m_curve{ 0 };		// position on the Hilbert curve in the current plane
+	int m_plane{ 0 };				// current plane of the Hilbert curve
+	int m_curveSide{ 1 };			// [1]	side length of the square covered by the Hilbert curve
+};
+
+#endif //SCANTRAJECTORY_H
\ No newline at end of file
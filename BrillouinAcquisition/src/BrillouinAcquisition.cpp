@@ -17,7 +17,7 @@ BrillouinAcquisition::BrillouinAcquisition(QWidget *parent) noexcept :
 		m_andor,
 		&Andor::s_previewBufferSettingsChanged,
 		this,
-		[this] { updatePlotLimits(m_BrillouinPlot, m_cameraOptions, m_andor->m_previewBuffer->m_bufferSettings.roi); }
+		[this] { updatePlotLimits(m_BrillouinPlot, m_cameraOptions, m_BrillouinCamera->m_previewBuffer->m_bufferSettings.roi); }
 	);
 
 	connection = QWidget::connect(
@@ -144,6 +144,14 @@ BrillouinAcquisition::BrillouinAcquisition(QWidget *parent) noexcept :
 		[this](double progress, int seconds) { showBrillouinProgress(progress, seconds); }
 	);
 
+	// slot to show the durations of the acquisition phases
+	connection = QWidget::connect(
+		m_Brillouin,
+		&Brillouin::s_phaseTiming,
+		this,
+		[this](PHASE_TIMING timing) { showPhaseTiming(ui->progressBar, timing); }
+	);
+
 	// slot to show calibration running
 	connection = QWidget::connect(
 		m_Brillouin,
@@ -178,6 +186,40 @@ BrillouinAcquisition::BrillouinAcquisition(QWidget *parent) noexcept :
 
 	m_Brillouin->getScanOrder();
 
+	// slots to show the route and the progress of multi-site acquisitions
+	connection = QWidget::connect(
+		m_multiSite,
+		&MultiSite::s_routePlanned,
+		this,
+		[this](SITE_ROUTE route) { showSiteRoute(route); }
+	);
+	connection = QWidget::connect(
+		m_multiSite,
+		&MultiSite::s_acquisitionStatus,
+		this,
+		[this](ACQUISITION_STATUS status) { showSitesStatus(status); }
+	);
+	connection = QWidget::connect(
+		m_multiSite,
+		&MultiSite::s_siteProgress,
+		this,
+		[this](int finished, int count, int seconds) { showSitesProgress(finished, count, seconds); }
+	);
+
+	// slots to show the progress of time-lapse acquisitions
+	connection = QWidget::connect(
+		m_timeline,
+		&Timeline::s_acquisitionStatus,
+		this,
+		[this](ACQUISITION_STATUS status) { showTimelineStatus(status); }
+	);
+	connection = QWidget::connect(
+		m_timeline,
+		&Timeline::s_timelineProgress,
+		this,
+		[this](int finished, int count, int seconds) { showTimelineProgress(finished, count, seconds); }
+	);
+
 	qRegisterMetaType<std::string>("std::string");
 	qRegisterMetaType<AT_64>("AT_64");
 	qRegisterMetaType<StoragePath>("StoragePath");
@@ -205,12 +247,16 @@ BrillouinAcquisition::BrillouinAcquisition(QWidget *parent) noexcept :
 	qRegisterMetaType<ODTIMAGE*>("ODTIMAGE*");
 	qRegisterMetaType<FLUOIMAGE*>("FLUOIMAGE*");
 	qRegisterMetaType<FLUORESCENCE_SETTINGS>("FLUORESCENCE_SETTINGS");
+	qRegisterMetaType<SITE_ROUTE>("SITE_ROUTE");
 	qRegisterMetaType<FLUORESCENCE_MODE>("FLUORESCENCE_MODE");
 	qRegisterMetaType<PLOT_SETTINGS*>("PLOT_SETTINGS*");
 	qRegisterMetaType<PreviewBuffer<unsigned short>*>("PreviewBuffer<unsigned short>*");
 	qRegisterMetaType<PreviewBuffer<unsigned char>*>("PreviewBuffer<unsigned char>*");
 	qRegisterMetaType<bool*>("bool*");
 	qRegisterMetaType<std::vector<FLUORESCENCE_MODE>>("std::vector<FLUORESCENCE_MODE>");
+	qRegisterMetaType<COMPRESSION_SETTINGS>("COMPRESSION_SETTINGS");
+	qRegisterMetaType<STORAGE_LAYOUT>("STORAGE_LAYOUT");
+	qRegisterMetaType<PHASE_TIMING>("PHASE_TIMING");
 	
 	// Set up icons
 	m_icons.disconnected.addFile(":/BrillouinAcquisition/assets/00disconnected10px.png", QSize(10, 10));
@@ -287,6 +333,8 @@ BrillouinAcquisition::BrillouinAcquisition(QWidget *parent) noexcept :
 	m_acquisitionThread.startWorker(m_acquisition);
 	// start Brillouin thread
 	m_acquisitionThread.startWorker(m_Brillouin);
+	m_acquisitionThread.startWorker(m_multiSite);
+	m_acquisitionThread.startWorker(m_timeline);
 
 	// set up the QCPColorMap:
 	m_BrillouinPlot = {
@@ -364,6 +412,8 @@ BrillouinAcquisition::BrillouinAcquisition(QWidget *parent) noexcept :
 }
 
 BrillouinAcquisition::~BrillouinAcquisition() {
+	delete m_multiSite;
+	delete m_timeline;
 	delete m_acquisition;
 	delete m_Brillouin;
 	if (m_ODT) {
@@ -376,6 +426,9 @@ BrillouinAcquisition::~BrillouinAcquisition() {
 	}
 	m_scanControl->deleteLater();
 	m_brightfieldCamera->deleteLater();
+	if (m_BrillouinCamera != m_andor) {
+		m_BrillouinCamera->deleteLater();
+	}
 	m_andor->deleteLater();
 	//m_cameraThread.exit();
 	//m_cameraThread.wait();
@@ -412,7 +465,7 @@ void BrillouinAcquisition::showEvent(QShowEvent* event) {
 	QWidget::showEvent(event);
 
 	// connect camera and microscope automatically
-	QMetaObject::invokeMethod(m_andor, "connectDevice", Qt::QueuedConnection);
+	QMetaObject::invokeMethod(m_BrillouinCamera, "connectDevice", Qt::QueuedConnection);
 	QMetaObject::invokeMethod(m_scanControl, "connectDevice", Qt::QueuedConnection);
 }
 
@@ -908,6 +961,7 @@ void BrillouinAcquisition::showBrillouinStatus(ACQUISITION_STATUS status) {
 	ui->actionOpen_Acquisition->setDisabled(running);
 	ui->actionNew_Acquisition->setDisabled(running);
 	ui->actionClose_Acquisition->setDisabled(running);
+	ui->actionResume_Brillouin_Repetition->setDisabled(running);
 
 	ui->startX->setDisabled(running);
 	ui->startY->setDisabled(running);
@@ -929,6 +983,8 @@ void BrillouinAcquisition::showBrillouinStatus(ACQUISITION_STATUS status) {
 	ui->preCalibration->setDisabled(running);
 	ui->conCalibration->setDisabled(running);
 	ui->conCalibrationInterval->setDisabled(running);
+	ui->adaptiveCalibration->setDisabled(running);
+	ui->driftThreshold->setDisabled(running);
 	ui->sampleSelection->setDisabled(running);
 	ui->nrCalibrationImages->setDisabled(running);
 	ui->calibrationExposureTime->setDisabled(running);
@@ -1068,6 +1124,94 @@ void BrillouinAcquisition::showFluorescenceProgress(double progress, int seconds
 	ui->fluoProgress->setFormat(string);
 }
 
+void BrillouinAcquisition::showPhaseTiming(QProgressBar* progressBar, PHASE_TIMING timing) {
+	auto names = PHASE_TIMING::names();
+	QString string;
+	for (gsl::index i{ 0 }; i < (gsl::index)timing.phases.size(); i++) {
+		const PHASE_STATISTICS& phase = timing.phases[i];
+		if (phase.count == 0) {
+			continue;
+		}
+		QString line;
+		line.sprintf("%s: %d x %.1f ms (p99 %.1f ms)\n", names[i].c_str(), phase.count, 1e3 * phase.mean, 1e3 * phase.p99);
+		string += line;
+	}
+	progressBar->setToolTip(string.trimmed());
+}
+
+void BrillouinAcquisition::updateSiteRoute() {
+	// the estimated duration depends on the Brillouin settings
+	m_Brillouin->setSettings(m_BrillouinSettings);
+	QMetaObject::invokeMethod(m_multiSite, "announceRoute", Qt::AutoConnection);
+}
+
+void BrillouinAcquisition::showSiteRoute(SITE_ROUTE route) {
+	QString string;
+	if (route.order.empty()) {
+		string = "No saved positions.";
+	} else {
+		string.sprintf("%d sites, route %1.1f mm, ", (int)route.order.size(), 1e-3 * route.length);
+		string += formatSeconds(route.duration);
+		string += " estimated.";
+	}
+	ui->siteRoute->setText(string);
+}
+
+void BrillouinAcquisition::showSitesStatus(ACQUISITION_STATUS status) {
+	if (status == ACQUISITION_STATUS::RUNNING || status == ACQUISITION_STATUS::STARTED) {
+		ui->acquireSites->setText("Cancel");
+	} else {
+		ui->acquireSites->setText("Acquire at all");
+	}
+	if (status == ACQUISITION_STATUS::ABORTED) {
+		ui->siteRoute->setText("Multi-site acquisition aborted.");
+	} else if (status == ACQUISITION_STATUS::FINISHED) {
+		ui->siteRoute->setText("Multi-site acquisition finished.");
+	}
+}
+
+void BrillouinAcquisition::showSitesProgress(int finished, int count, int seconds) {
+	QString string;
+	string.sprintf("Site %d of %d finished, ", finished, count);
+	string += formatSeconds(seconds);
+	string += " remaining.";
+	ui->siteRoute->setText(string);
+}
+
+void BrillouinAcquisition::showTimelineStatus(ACQUISITION_STATUS status) {
+	bool running{ false };
+	if (status == ACQUISITION_STATUS::RUNNING || status == ACQUISITION_STATUS::STARTED) {
+		ui->acquireTimeline->setText("Cancel");
+		running = true;
+	} else {
+		ui->acquireTimeline->setText("Start time-lapse");
+	}
+	ui->timelineFluorescence->setDisabled(running);
+	ui->timelineFluorescenceInterval->setDisabled(running);
+	ui->timelineODT->setDisabled(running);
+	ui->timelineODTInterval->setDisabled(running);
+
+	if (status == ACQUISITION_STATUS::ABORTED) {
+		ui->timelineStatus->setText("Time-lapse aborted.");
+	} else if (status == ACQUISITION_STATUS::FINISHED) {
+		ui->timelineStatus->setText("Time-lapse finished.");
+	} else if (status == ACQUISITION_STATUS::STARTED) {
+		ui->timelineStatus->setText("Time-lapse started.");
+	}
+}
+
+void BrillouinAcquisition::showTimelineProgress(int finished, int count, int seconds) {
+	QString string;
+	string.sprintf("Event %d of %d finished", finished, count);
+	if (seconds > 0) {
+		string += ", ";
+		string += formatSeconds(seconds);
+		string += " to the next one";
+	}
+	string += ".";
+	ui->timelineStatus->setText(string);
+}
+
 QString BrillouinAcquisition::formatSeconds(int seconds) {
 	QString string;
 	if (seconds > 3600) {
@@ -1431,6 +1575,7 @@ void BrillouinAcquisition::showPreviewRunning(bool isRunning) {
 		ui->camera_playPause->setText("Stop");
 	} else {
 		ui->camera_playPause->setText("Play");
+		logPreviewStatistics("Brillouin", m_BrillouinCamera->m_previewBuffer);
 	}
 	startPreview(isRunning);
 }
@@ -1440,10 +1585,19 @@ void BrillouinAcquisition::showBrightfieldPreviewRunning(bool isRunning) {
 		ui->camera_playPause_brightfield->setText("Stop");
 	} else {
 		ui->camera_playPause_brightfield->setText("Play");
+		logPreviewStatistics("Brightfield", m_brightfieldCamera->m_previewBuffer);
 	}
 	startBrightfieldPreview(isRunning);
 }
 
+void BrillouinAcquisition::logPreviewStatistics(std::string name, PreviewBuffer<unsigned char>* previewBuffer) {
+	std::lock_guard<std::mutex> lockGuard(previewBuffer->m_mutex);
+	qInfo(logInfo()) << (name + " preview stopped,").c_str() << previewBuffer->getDroppedFrames() << "frames were not displayed.";
+	auto arena = previewBuffer->getArenaStatistics();
+	qInfo(logInfo()) << (name + " frame memory:").c_str() << arena.capacity / 1048576.0 << "MB," << arena.allocations << "allocations,"
+		<< arena.reuses << "reuses" << (arena.largePages ? "(large pages)." : ".");
+}
+
 void BrillouinAcquisition::showFluorescencePreviewRunning(FLUORESCENCE_MODE mode) {
 	// reset all preview buttons
 	ui->fluoBluePreview->setText("Preview");
@@ -1488,7 +1642,7 @@ void BrillouinAcquisition::startBrightfieldPreview(bool isRunning) {
 
 void BrillouinAcquisition::updateImageBrillouin() {
 	if (m_previewRunning) {
-		updateImage(m_andor->m_previewBuffer, &m_BrillouinPlot);
+		updateImage(m_BrillouinCamera->m_previewBuffer, &m_BrillouinPlot);
 
 		QMetaObject::invokeMethod(this, "updateImageBrillouin", Qt::QueuedConnection);
 	}
@@ -1507,20 +1661,24 @@ void BrillouinAcquisition::updateImage(PreviewBuffer<T>* previewBuffer, PLOT_SET
 	{
 		std::lock_guard<std::mutex> lockGuard(previewBuffer->m_mutex);
 		// if no image is ready return immediately
-		if (!previewBuffer->m_buffer->m_usedBuffers->tryAcquire()) {
+		auto buffer = previewBuffer->claimRead();
+		if (buffer == nullptr) {
 			return;
 		}
 
-		if (previewBuffer->m_bufferSettings.bufferType == "unsigned short") {
-			auto unpackedBuffer = reinterpret_cast<unsigned short*>(previewBuffer->m_buffer->getReadBuffer());
-			plotting(previewBuffer, plotSettings, unpackedBuffer);
-		}
-		else if (previewBuffer->m_bufferSettings.bufferType == "unsigned char") {
-			auto unpackedBuffer = previewBuffer->m_buffer->getReadBuffer();
-			plotting(previewBuffer, plotSettings, unpackedBuffer);
+		// the header describes the frame, even if the buffer settings changed in the meantime
+		auto header = previewBuffer->getReadHeader();
+		auto frame = reinterpret_cast<unsigned char*>(buffer);
+		switch (header->pixelFormat) {
+			case PIXEL_FORMAT::MONO16:
+				plotting<PIXEL_FORMAT::MONO16>(header, plotSettings, frame);
+				break;
+			case PIXEL_FORMAT::MONO8:
+				plotting<PIXEL_FORMAT::MONO8>(header, plotSettings, frame);
+				break;
 		}
+		previewBuffer->releaseRead();
 	}
-	previewBuffer->m_buffer->m_freeBuffers->release();
 	if (plotSettings->autoscale) {
 		plotSettings->colorMap->rescaleDataRange();
 		plotSettings->cLim = plotSettings->colorMap->dataRange();
@@ -1529,23 +1687,27 @@ void BrillouinAcquisition::updateImage(PreviewBuffer<T>* previewBuffer, PLOT_SET
 	plotSettings->plotHandle->replot();
 }
 
-template <typename T>
-void BrillouinAcquisition::plotting(PreviewBuffer<unsigned char>* previewBuffer, PLOT_SETTINGS* plotSettings, T* unpackedBuffer) {
+template <PIXEL_FORMAT F>
+void BrillouinAcquisition::plotting(const FRAME_HEADER* header, PLOT_SETTINGS* plotSettings, unsigned char* frame) {
+	auto data = plotSettings->colorMap->data();
+	// the frame might have been acquired before the plot was adjusted to a new ROI
+	if (data->keySize() != header->width || data->valueSize() != header->height) {
+		data->setSize(header->width, header->height);
+	}
 	// images are given row by row, starting at the top left
-	int tIndex{ 0 };
-	for (gsl::index yIndex{ 0 }; yIndex < previewBuffer->m_bufferSettings.roi.height; ++yIndex) {
-		for (gsl::index xIndex{ 0 }; xIndex < previewBuffer->m_bufferSettings.roi.width; ++xIndex) {
-			tIndex = yIndex * previewBuffer->m_bufferSettings.roi.width + xIndex;
-			plotSettings->colorMap->data()->setCell(xIndex, previewBuffer->m_bufferSettings.roi.height - yIndex - 1, unpackedBuffer[tIndex]);
+	for (gsl::index yIndex{ 0 }; yIndex < header->height; ++yIndex) {
+		auto row = reinterpret_cast<const typename PixelTraits<F>::type*>(frame + yIndex * header->stride);
+		for (gsl::index xIndex{ 0 }; xIndex < header->width; ++xIndex) {
+			data->setCell(xIndex, header->height - yIndex - 1, row[xIndex]);
 		}
 	}
 }
 
 void BrillouinAcquisition::on_actionConnect_Camera_triggered() {
-	if (m_andor->getConnectionStatus()) {
-		QMetaObject::invokeMethod(m_andor, "disconnectDevice", Qt::QueuedConnection);
+	if (m_BrillouinCamera->getConnectionStatus()) {
+		QMetaObject::invokeMethod(m_BrillouinCamera, "disconnectDevice", Qt::QueuedConnection);
 	} else {
-		QMetaObject::invokeMethod(m_andor, "connectDevice", Qt::QueuedConnection);
+		QMetaObject::invokeMethod(m_BrillouinCamera, "connectDevice", Qt::QueuedConnection);
 	}
 }
 
@@ -1553,11 +1715,13 @@ void BrillouinAcquisition::cameraConnectionChanged(bool isConnected) {
 	if (isConnected) {
 		ui->actionConnect_Camera->setText("Disconnect Camera");
 		ui->settingsWidget->setTabIcon(0, m_icons.standby);
-		ui->actionEnable_Cooling->setEnabled(true);
 		ui->camera_playPause->setEnabled(true);
 		ui->camera_singleShot->setEnabled(true);
-		// switch on cooling automatically
-		QMetaObject::invokeMethod(m_andor, "setSensorCooling", Qt::QueuedConnection, Q_ARG(bool, true));
+		// switch on cooling automatically, the simulated camera has no sensor to cool
+		if (m_BrillouinCamera == m_andor) {
+			ui->actionEnable_Cooling->setEnabled(true);
+			QMetaObject::invokeMethod(m_andor, "setSensorCooling", Qt::QueuedConnection, Q_ARG(bool, true));
+		}
 	} else {
 		ui->actionConnect_Camera->setText("Connect Camera");
 		ui->actionEnable_Cooling->setText("Enable Cooling");
@@ -1645,6 +1809,13 @@ void BrillouinAcquisition::on_camera_playPause_brightfield_clicked() {
 
 void BrillouinAcquisition::on_actionSettings_Stage_triggered() {
 	m_scanControlDropdown->setCurrentIndex((int)m_scanControllerType);
+	m_BrillouinCameraDropdown->setCurrentIndex((int)m_BrillouinCameraType);
+	m_compressionCodecDropdown->setCurrentIndex((int)m_storageOptions.compression.codec);
+	m_compressionLevelSpinBox->setValue(m_storageOptions.compression.level);
+	m_compressionShuffleCheckBox->setChecked(m_storageOptions.compression.shuffle);
+	m_storageLayoutDropdown->setCurrentIndex((int)m_storageOptions.layout);
+	m_storageSpoolCheckBox->setChecked(m_storageOptions.spool);
+	m_storagePackingCheckBox->setChecked(m_storageOptions.packing);
 	m_settingsDialog->show();
 }
 
@@ -1658,15 +1829,48 @@ void BrillouinAcquisition::saveSettings() {
 		m_cameraType = m_cameraTypeTemporary;
 		initCamera();
 	}
+	if (m_BrillouinCameraType != m_BrillouinCameraTypeTemporary) {
+		BRILLOUIN_CAMERA_DEVICE previousType = m_BrillouinCameraType;
+		m_BrillouinCameraType = m_BrillouinCameraTypeTemporary;
+		if (!initBrillouinCamera()) {
+			m_BrillouinCameraType = previousType;
+			m_BrillouinCameraTypeTemporary = previousType;
+		}
+	}
+	applyStorageOptions();
 	m_settingsDialog->hide();
 }
 
 void BrillouinAcquisition::cancelSettings() {
 	m_scanControllerTypeTemporary = m_scanControllerType;
 	m_cameraTypeTemporary = m_cameraType;
+	m_BrillouinCameraTypeTemporary = m_BrillouinCameraType;
+	m_storageOptionsTemporary = m_storageOptions;
 	m_settingsDialog->hide();
 }
 
+void BrillouinAcquisition::applyStorageOptions() {
+	const COMPRESSION_SETTINGS& compression = m_storageOptionsTemporary.compression;
+	if (m_storageOptions.compression.codec != compression.codec || m_storageOptions.compression.level != compression.level
+		|| m_storageOptions.compression.shuffle != compression.shuffle) {
+		QMetaObject::invokeMethod(m_acquisition, "setCompression", Qt::AutoConnection,
+			Q_ARG(COMPRESSION_SETTINGS, compression));
+	}
+	if (m_storageOptions.layout != m_storageOptionsTemporary.layout) {
+		QMetaObject::invokeMethod(m_acquisition, "setLayout", Qt::AutoConnection,
+			Q_ARG(STORAGE_LAYOUT, m_storageOptionsTemporary.layout));
+	}
+	if (m_storageOptions.spool != m_storageOptionsTemporary.spool) {
+		QMetaObject::invokeMethod(m_acquisition, "setSpool", Qt::AutoConnection,
+			Q_ARG(bool, m_storageOptionsTemporary.spool));
+	}
+	if (m_storageOptions.packing != m_storageOptionsTemporary.packing) {
+		QMetaObject::invokeMethod(m_acquisition, "setPacking", Qt::AutoConnection,
+			Q_ARG(bool, m_storageOptionsTemporary.packing));
+	}
+	m_storageOptions = m_storageOptionsTemporary;
+}
+
 void BrillouinAcquisition::initSettingsDialog() {
 	m_scanControllerTypeTemporary = m_scanControllerType;
 	m_settingsDialog = new QDialog(this, Qt::WindowTitleHint | Qt::WindowCloseButtonHint);
@@ -1740,6 +1944,146 @@ void BrillouinAcquisition::initSettingsDialog() {
 		[this](int index) { selectCameraDevice(index); }
 	);
 
+	/*
+	 * Widget for Brillouin camera selection
+	 */
+	QWidget *BrillouinCameraWidget = new QWidget();
+	BrillouinCameraWidget->setMinimumHeight(60);
+	BrillouinCameraWidget->setMinimumWidth(250);
+	QGroupBox *BrillouinCamBox = new QGroupBox(BrillouinCameraWidget);
+	BrillouinCamBox->setTitle("Brillouin camera");
+	BrillouinCamBox->setMinimumHeight(50);
+	BrillouinCamBox->setMinimumWidth(250);
+
+	vLayout->addWidget(BrillouinCameraWidget);
+
+	QHBoxLayout *BrillouinCamLayout = new QHBoxLayout(BrillouinCamBox);
+
+	QLabel *BrillouinCamLabel = new QLabel("Currently selected camera");
+	BrillouinCamLayout->addWidget(BrillouinCamLabel);
+
+	m_BrillouinCameraDropdown = new QComboBox();
+	BrillouinCamLayout->addWidget(m_BrillouinCameraDropdown);
+	i = 0;
+	for (auto type : BRILLOUIN_CAMERA_DEVICE_NAMES) {
+		m_BrillouinCameraDropdown->insertItem(i, QString::fromStdString(type));
+		i++;
+	}
+	m_BrillouinCameraDropdown->setCurrentIndex((int)m_BrillouinCameraType);
+
+	connection = QWidget::connect<void(QComboBox::*)(int)>(
+		m_BrillouinCameraDropdown,
+		&QComboBox::currentIndexChanged,
+		this,
+		[this](int index) { selectBrillouinCameraDevice(index); }
+	);
+
+	/*
+	 * Widget for the storage options
+	 */
+	QWidget *storageWidget = new QWidget();
+	storageWidget->setMinimumWidth(250);
+	QVBoxLayout *storageWidgetLayout = new QVBoxLayout(storageWidget);
+	storageWidgetLayout->setMargin(0);
+	QGroupBox *storageBox = new QGroupBox();
+	storageBox->setTitle("Storage");
+	storageWidgetLayout->addWidget(storageBox);
+
+	vLayout->addWidget(storageWidget);
+
+	QGridLayout *storageLayout = new QGridLayout(storageBox);
+
+	// the storage falls back to uncompressed payloads if the filter is not available
+	storageLayout->addWidget(new QLabel("Compression"), 0, 0);
+	m_compressionCodecDropdown = new QComboBox();
+	storageLayout->addWidget(m_compressionCodecDropdown, 0, 1);
+	i = 0;
+	for (auto name : COMPRESSION_CODEC_NAMES) {
+		m_compressionCodecDropdown->insertItem(i, QString::fromStdString(name));
+		i++;
+	}
+	m_compressionCodecDropdown->setCurrentIndex((int)m_storageOptions.compression.codec);
+
+	// only deflate has a compression level
+	storageLayout->addWidget(new QLabel("Compression level"), 1, 0);
+	m_compressionLevelSpinBox = new QSpinBox();
+	m_compressionLevelSpinBox->setRange(1, 9);
+	m_compressionLevelSpinBox->setValue(m_storageOptions.compression.level);
+	m_compressionLevelSpinBox->setEnabled(m_storageOptions.compression.codec == COMPRESSION_CODEC::DEFLATE);
+	storageLayout->addWidget(m_compressionLevelSpinBox, 1, 1);
+
+	m_compressionShuffleCheckBox = new QCheckBox("Shuffle the bytes of the pixels before compressing");
+	m_compressionShuffleCheckBox->setChecked(m_storageOptions.compression.shuffle);
+	m_compressionShuffleCheckBox->setEnabled(m_storageOptions.compression.codec != COMPRESSION_CODEC::NONE);
+	storageLayout->addWidget(m_compressionShuffleCheckBox, 2, 0, 1, 2);
+
+	connection = QWidget::connect<void(QComboBox::*)(int)>(
+		m_compressionCodecDropdown,
+		&QComboBox::currentIndexChanged,
+		this,
+		[this](int index) {
+			m_storageOptionsTemporary.compression.codec = (COMPRESSION_CODEC)index;
+			m_compressionLevelSpinBox->setEnabled(m_storageOptionsTemporary.compression.codec == COMPRESSION_CODEC::DEFLATE);
+			m_compressionShuffleCheckBox->setEnabled(m_storageOptionsTemporary.compression.codec != COMPRESSION_CODEC::NONE);
+		}
+	);
+
+	connection = QWidget::connect<void(QSpinBox::*)(int)>(
+		m_compressionLevelSpinBox,
+		&QSpinBox::valueChanged,
+		this,
+		[this](int level) { m_storageOptionsTemporary.compression.level = level; }
+	);
+
+	connection = QWidget::connect(
+		m_compressionShuffleCheckBox,
+		&QCheckBox::toggled,
+		this,
+		[this](bool checked) { m_storageOptionsTemporary.compression.shuffle = checked; }
+	);
+
+	// the layout of the Brillouin images takes effect with the next repetition
+	storageLayout->addWidget(new QLabel("Brillouin image layout"), 3, 0);
+	m_storageLayoutDropdown = new QComboBox();
+	storageLayout->addWidget(m_storageLayoutDropdown, 3, 1);
+	i = 0;
+	for (auto name : STORAGE_LAYOUT_NAMES) {
+		m_storageLayoutDropdown->insertItem(i, QString::fromStdString(name));
+		i++;
+	}
+	m_storageLayoutDropdown->setCurrentIndex((int)m_storageOptions.layout);
+
+	connection = QWidget::connect<void(QComboBox::*)(int)>(
+		m_storageLayoutDropdown,
+		&QComboBox::currentIndexChanged,
+		this,
+		[this](int index) { m_storageOptionsTemporary.layout = (STORAGE_LAYOUT)index; }
+	);
+
+	// the acquisition is not blocked by a slow HDF5 writer, the spool is converted in the background
+	m_storageSpoolCheckBox = new QCheckBox("Spool payloads to disk before writing them to the file");
+	storageLayout->addWidget(m_storageSpoolCheckBox, 4, 0, 1, 2);
+	m_storageSpoolCheckBox->setChecked(m_storageOptions.spool);
+
+	connection = QWidget::connect(
+		m_storageSpoolCheckBox,
+		&QCheckBox::toggled,
+		this,
+		[this](bool checked) { m_storageOptionsTemporary.spool = checked; }
+	);
+
+	// only applies if the Brillouin camera acquires 12 bit images, takes effect with the next repetition
+	m_storagePackingCheckBox = new QCheckBox("Store 12 bit Brillouin images packed");
+	storageLayout->addWidget(m_storagePackingCheckBox, 5, 0, 1, 2);
+	m_storagePackingCheckBox->setChecked(m_storageOptions.packing);
+
+	connection = QWidget::connect(
+		m_storagePackingCheckBox,
+		&QCheckBox::toggled,
+		this,
+		[this](bool checked) { m_storageOptionsTemporary.packing = checked; }
+	);
+
 	/*
 	 * Ok and Cancel buttons
 	 */
@@ -1787,6 +2131,10 @@ void BrillouinAcquisition::selectCameraDevice(int index) {
 	m_cameraTypeTemporary = (CAMERA_DEVICE)index;
 }
 
+void BrillouinAcquisition::selectBrillouinCameraDevice(int index) {
+	m_BrillouinCameraTypeTemporary = (BRILLOUIN_CAMERA_DEVICE)index;
+}
+
 void BrillouinAcquisition::on_actionLoad_Voltage_Position_calibration_triggered() {
 	m_calibrationFilePath = QFileDialog::getOpenFileName(this, tr("Select Voltage-Position map"),
 		QString::fromStdString(m_calibrationFilePath), tr("Calibration map (*.h5)")).toStdString();
@@ -1882,16 +2230,19 @@ void BrillouinAcquisition::initScanControl() {
 		case ScanControl::SCAN_DEVICE::ZEISSECU:
 			m_scanControl = new ZeissECU();
 			ui->actionLoad_Voltage_Position_calibration->setVisible(false);
+			ui->hardwareTimedScan->setVisible(false);
 			m_hasODT = false;
 			break;
 		case ScanControl::SCAN_DEVICE::NIDAQ:
 			m_scanControl = new NIDAQ();
 			m_hasODT = true;
 			ui->actionLoad_Voltage_Position_calibration->setVisible(true);
+			ui->hardwareTimedScan->setVisible(true);
 			break;
 		default:
 			m_scanControl = new ZeissECU();
 			ui->actionLoad_Voltage_Position_calibration->setVisible(false);
+			ui->hardwareTimedScan->setVisible(false);
 			// disable ODT
 			m_hasODT = false;
 			break;
@@ -1945,6 +2296,12 @@ void BrillouinAcquisition::initScanControl() {
 		this->tableModel,
 		[this](std::vector<POINT3> storage) { this->tableModel->setStorage(storage); }
 	);
+	connection = QWidget::connect(
+		m_scanControl,
+		&ScanControl::savedPositionsChanged,
+		this,
+		[this](std::vector<POINT3> storage) { updateSiteRoute(); }
+	);
 	connection = QWidget::connect(
 		m_scanControl,
 		&ScanControl::homePositionBoundsChanged,
@@ -2015,6 +2372,14 @@ void BrillouinAcquisition::initODT() {
 			[this](double progress, int seconds) { showODTProgress(progress, seconds); }
 		);
 
+		// slot to show the durations of the acquisition phases
+		connection = QWidget::connect(
+			m_ODT,
+			&ODT::s_phaseTiming,
+			this,
+			[this](PHASE_TIMING timing) { showPhaseTiming(ui->acquisitionProgress_ODT, timing); }
+		);
+
 		// start ODT thread
 		m_acquisitionThread.startWorker(m_ODT);
 		m_ODT->initialize();
@@ -2066,6 +2431,14 @@ void BrillouinAcquisition::initFluorescence() {
 			[this](double progress, int seconds) { showFluorescenceProgress(progress, seconds); }
 		);
 
+		// slot to show the durations of the acquisition phases
+		connection = QWidget::connect(
+			m_Fluorescence,
+			&Fluorescence::s_phaseTiming,
+			this,
+			[this](PHASE_TIMING timing) { showPhaseTiming(ui->fluoProgress, timing); }
+		);
+
 		// slot to show current repetition progress
 		connection = QWidget::connect(
 			m_Fluorescence,
@@ -2110,6 +2483,13 @@ void BrillouinAcquisition::initCamera() {
 			ui->settingsWidget->setTabIcon(3, m_icons.disconnected);
 			m_hasFluorescence = true;
 			break;
+		case CAMERA_DEVICE::SIMULATED:
+			m_brightfieldCamera = new SimulatedCamera(SIMULATED_CAMERA{ SIMULATED_CAMERA_ROLE::BRIGHTFIELD, { 1800, 2000 } });
+			ui->actionConnect_Brightfield_camera->setVisible(true);
+			ui->settingsWidget->addTab(ui->ODTcameraTab, "ODT Camera");
+			ui->settingsWidget->setTabIcon(3, m_icons.disconnected);
+			m_hasFluorescence = true;
+			break;
 		default:
 			m_brightfieldCamera = nullptr;
 			ui->actionConnect_Brightfield_camera->setVisible(false);
@@ -2167,6 +2547,86 @@ void BrillouinAcquisition::initCamera() {
 	QMetaObject::invokeMethod(m_brightfieldCamera, "connectDevice", Qt::AutoConnection);
 }
 
+/*
+ * Replaces the Andor camera by a simulated spectrometer or switches back to it.
+ * The Andor specific signals, e.g. of the sensor cooling, stay connected to the Andor camera.
+ * Returns false if the camera cannot be switched at the moment.
+ */
+bool BrillouinAcquisition::initBrillouinCamera() {
+	bool simulated = (m_BrillouinCameraType == BRILLOUIN_CAMERA_DEVICE::SIMULATED);
+	bool isSimulated = (m_BrillouinCamera != m_andor);
+	if (simulated == isSimulated) {
+		return true;
+	}
+
+	// the acquisition modes and the preview use the camera from their own thread
+	if (m_enabledModes != ACQUISITION_MODE::NONE || m_BrillouinCamera->m_isPreviewRunning) {
+		std::string info = "The Brillouin camera cannot be switched while an acquisition or the preview is running.";
+		qWarning(logWarning()) << info.c_str();
+		return false;
+	}
+
+	if (isSimulated) {
+		m_BrillouinCamera->deleteLater();
+		m_BrillouinCamera = m_andor;
+		cameraConnectionChanged(m_andor->getConnectionStatus());
+		return true;
+	}
+
+	// the calls are queued on the same thread, so the Andor camera reports its disconnection first
+	if (m_andor->getConnectionStatus()) {
+		QMetaObject::invokeMethod(m_andor, "disconnectDevice", Qt::QueuedConnection);
+	}
+	m_BrillouinCamera = new SimulatedCamera(SIMULATED_CAMERA{ SIMULATED_CAMERA_ROLE::SPECTROMETER });
+
+	QMetaObject::Connection connection = QWidget::connect(
+		m_BrillouinCamera,
+		&Camera::s_previewBufferSettingsChanged,
+		this,
+		[this] { updatePlotLimits(m_BrillouinPlot, m_cameraOptions, m_BrillouinCamera->m_previewBuffer->m_bufferSettings.roi); }
+	);
+
+	connection = QWidget::connect(
+		m_BrillouinCamera,
+		&Camera::connectedDevice,
+		this,
+		[this](bool isConnected) { cameraConnectionChanged(isConnected); }
+	);
+
+	connection = QWidget::connect(
+		m_BrillouinCamera,
+		&Camera::s_previewRunning,
+		this,
+		[this](bool isRunning) { showPreviewRunning(isRunning); }
+	);
+
+	connection = QWidget::connect(
+		m_BrillouinCamera,
+		&Camera::s_acquisitionRunning,
+		this,
+		[this](bool isRunning) { startPreview(isRunning); }
+	);
+
+	connection = QWidget::connect(
+		m_BrillouinCamera,
+		&Camera::optionsChanged,
+		this,
+		[this](CAMERA_OPTIONS options) { cameraOptionsChanged(options); }
+	);
+
+	connection = QWidget::connect(
+		m_BrillouinCamera,
+		&Camera::settingsChanged,
+		this,
+		[this](CAMERA_SETTINGS settings) { cameraSettingsChanged(settings); }
+	);
+
+	m_andorThread.startWorker(m_BrillouinCamera);
+
+	QMetaObject::invokeMethod(m_BrillouinCamera, "connectDevice", Qt::AutoConnection);
+	return true;
+}
+
 void BrillouinAcquisition::microscopeElementPositionsChanged(std::vector<int> positions) {
 	m_deviceElementPositions = positions;
 	checkElementButtons();
@@ -2235,11 +2695,11 @@ void BrillouinAcquisition::on_actionAbout_triggered() {
 }
 
 void BrillouinAcquisition::on_camera_playPause_clicked() {
-	if (!m_andor->m_isPreviewRunning) {
-		m_andor->setSettings(m_BrillouinSettings.camera);
-		QMetaObject::invokeMethod(m_andor, "startPreview", Qt::AutoConnection);
+	if (!m_BrillouinCamera->m_isPreviewRunning) {
+		m_BrillouinCamera->setSettings(m_BrillouinSettings.camera);
+		QMetaObject::invokeMethod(m_BrillouinCamera, "startPreview", Qt::AutoConnection);
 	} else {
-		m_andor->m_stopPreview = true;
+		m_BrillouinCamera->m_stopPreview = true;
 	}
 }
 
@@ -2275,12 +2735,16 @@ void BrillouinAcquisition::updateBrillouinSettings() {
 	ui->stepsX->setValue(m_BrillouinSettings.xSteps);
 	ui->stepsY->setValue(m_BrillouinSettings.ySteps);
 	ui->stepsZ->setValue(m_BrillouinSettings.zSteps);
+	ui->hardwareTimedScan->setChecked(m_BrillouinSettings.hardwareTimed);
+	ui->scanTrajectory->setCurrentIndex((int)m_BrillouinSettings.trajectory);
 
 	// calibration settings
 	ui->preCalibration->setChecked(m_BrillouinSettings.preCalibration);
 	ui->postCalibration->setChecked(m_BrillouinSettings.postCalibration);
 	ui->conCalibration->setChecked(m_BrillouinSettings.conCalibration);
 	ui->conCalibrationInterval->setValue(m_BrillouinSettings.conCalibrationInterval);
+	ui->adaptiveCalibration->setChecked(m_BrillouinSettings.adaptiveCalibration);
+	ui->driftThreshold->setValue(m_BrillouinSettings.driftThreshold);
 	ui->nrCalibrationImages->setValue(m_BrillouinSettings.nrCalibrationImages);
 	ui->calibrationExposureTime->setValue(m_BrillouinSettings.calibrationExposureTime);
 	ui->sampleSelection->setCurrentText(QString::fromStdString(m_BrillouinSettings.sample));
@@ -2338,6 +2802,14 @@ void BrillouinAcquisition::on_conCalibration_stateChanged(int state) {
 	m_BrillouinSettings.conCalibration = (bool)state;
 }
 
+void BrillouinAcquisition::on_hardwareTimedScan_stateChanged(int state) {
+	m_BrillouinSettings.hardwareTimed = (bool)state;
+}
+
+void BrillouinAcquisition::on_scanTrajectory_currentIndexChanged(int index) {
+	m_BrillouinSettings.trajectory = (SCAN_TRAJECTORY)index;
+}
+
 
 void BrillouinAcquisition::on_sampleSelection_currentIndexChanged(const QString &text) {
 	m_BrillouinSettings.sample = text.toStdString();
@@ -2347,6 +2819,14 @@ void BrillouinAcquisition::on_conCalibrationInterval_valueChanged(double value)
 	m_BrillouinSettings.conCalibrationInterval = value;
 }
 
+void BrillouinAcquisition::on_adaptiveCalibration_stateChanged(int state) {
+	m_BrillouinSettings.adaptiveCalibration = (bool)state;
+}
+
+void BrillouinAcquisition::on_driftThreshold_valueChanged(double value) {
+	m_BrillouinSettings.driftThreshold = value;
+}
+
 void BrillouinAcquisition::on_nrCalibrationImages_valueChanged(int value) {
 	m_BrillouinSettings.nrCalibrationImages = value;
 };
@@ -2383,6 +2863,60 @@ void BrillouinAcquisition::showRepProgress(int repNumber, int timeToNext) {
 	ui->repetitionProgress->setFormat(string);
 };
 
+void BrillouinAcquisition::on_acquireSites_clicked() {
+	if (m_multiSite->getStatus() < ACQUISITION_STATUS::STARTED) {
+		m_Brillouin->setSettings(m_BrillouinSettings);
+		QMetaObject::invokeMethod(m_multiSite, "startSites", Qt::AutoConnection);
+	} else {
+		m_multiSite->m_abort = true;
+		m_Brillouin->m_abort = true;
+		if (m_Fluorescence) {
+			m_Fluorescence->m_abort = true;
+		}
+	}
+}
+
+void BrillouinAcquisition::on_acquireSitesFluorescence_stateChanged(int state) {
+	m_multiSiteSettings.fluorescence = (bool)state;
+	m_multiSite->setSettings(m_multiSiteSettings);
+}
+
+void BrillouinAcquisition::on_acquireTimeline_clicked() {
+	if (m_timeline->getStatus() < ACQUISITION_STATUS::STARTED) {
+		// the Brillouin repetitions span the time-lapse
+		m_BrillouinSettings.camera.roi = m_deviceSettings.camera.roi;
+		m_Brillouin->setSettings(m_BrillouinSettings);
+		m_timelineSettings.repetitions = m_BrillouinSettings.repetitions;
+		m_timeline->setSettings(m_timelineSettings);
+		QMetaObject::invokeMethod(m_timeline, "startTimeline", Qt::AutoConnection);
+	} else {
+		m_timeline->m_abort = true;
+		m_Brillouin->m_abort = true;
+		if (m_Fluorescence) {
+			m_Fluorescence->m_abort = true;
+		}
+		if (m_ODT) {
+			m_ODT->m_abort = true;
+		}
+	}
+}
+
+void BrillouinAcquisition::on_timelineFluorescence_stateChanged(int state) {
+	m_timelineSettings.fluorescence = (bool)state;
+}
+
+void BrillouinAcquisition::on_timelineFluorescenceInterval_valueChanged(double interval) {
+	m_timelineSettings.fluorescenceInterval = interval;
+}
+
+void BrillouinAcquisition::on_timelineODT_stateChanged(int state) {
+	m_timelineSettings.odt = (bool)state;
+}
+
+void BrillouinAcquisition::on_timelineODTInterval_valueChanged(double interval) {
+	m_timelineSettings.odtInterval = interval;
+}
+
 void BrillouinAcquisition::on_savePosition_clicked() {
 	QMetaObject::invokeMethod(m_scanControl, "savePosition", Qt::AutoConnection);
 }
@@ -2553,6 +3087,23 @@ void BrillouinAcquisition::on_actionOpen_Acquisition_triggered() {
 	QMetaObject::invokeMethod(m_acquisition, "openFile", Qt::AutoConnection, Q_ARG(StoragePath, m_storagePath));
 }
 
+void BrillouinAcquisition::on_actionResume_Brillouin_Repetition_triggered() {
+	QString fullPath = QFileDialog::getOpenFileName(this, tr("Resume Brillouin repetition of"),
+		QString::fromStdString(m_storagePath.folder), tr("Brillouin data (*.h5)"));
+
+	if (fullPath.isEmpty()) {
+		return;
+	}
+
+	m_storagePath = splitFilePath(fullPath);
+
+	// the camera settings have to match the images of the repetition
+	m_BrillouinSettings.camera.roi = m_deviceSettings.camera.roi;
+	m_Brillouin->setSettings(m_BrillouinSettings);
+	QMetaObject::invokeMethod(m_acquisition, "openFile", Qt::AutoConnection, Q_ARG(StoragePath, m_storagePath), Q_ARG(int, H5F_ACC_RDWR));
+	QMetaObject::invokeMethod(m_Brillouin, "resumeRepetition", Qt::AutoConnection);
+}
+
 void BrillouinAcquisition::on_actionClose_Acquisition_triggered() {
 	int ret = m_acquisition->closeFile();
 	if (ret == 0) {
@@ -11,6 +11,7 @@
 #include "Devices/NIDAQ.h"
 #include "Devices/PointGrey.h"
 #include "Devices/uEyeCam.h"
+#include "Devices/simulatedCamera.h"
 
 #include "Acquisition/Acquisition.h"
 #include "external/qcustomplot/qcustomplot.h"
@@ -20,6 +21,8 @@
 #include"Acquisition/AcquisitionModes/Brillouin.h"
 #include"Acquisition/AcquisitionModes/ODT.h"
 #include"Acquisition/AcquisitionModes/Fluorescence.h"
+#include"Acquisition/MultiSite.h"
+#include"Acquisition/Timeline.h"
 
 #include <QtWidgets/QMainWindow>
 #include "ui_BrillouinAcquisition.h"
@@ -76,10 +79,14 @@ Q_DECLARE_METATYPE(ODT_SETTINGS);
 Q_DECLARE_METATYPE(ODTIMAGE*);
 Q_DECLARE_METATYPE(FLUOIMAGE*);
 Q_DECLARE_METATYPE(FLUORESCENCE_SETTINGS);
+Q_DECLARE_METATYPE(SITE_ROUTE);
 Q_DECLARE_METATYPE(FLUORESCENCE_MODE);
 Q_DECLARE_METATYPE(PreviewBuffer<unsigned char>*);
 Q_DECLARE_METATYPE(bool*);
 Q_DECLARE_METATYPE(std::vector<FLUORESCENCE_MODE>);
+Q_DECLARE_METATYPE(COMPRESSION_SETTINGS);
+Q_DECLARE_METATYPE(STORAGE_LAYOUT);
+Q_DECLARE_METATYPE(PHASE_TIMING);
 
 class BrillouinAcquisition : public QMainWindow {
 	Q_OBJECT
@@ -129,6 +136,8 @@ private slots:
 	void initSettingsDialog();
 	void selectScanningDevice(int index);
 	void selectCameraDevice(int index);
+	void selectBrillouinCameraDevice(int index);
+	void applyStorageOptions();
 	void on_actionLoad_Voltage_Position_calibration_triggered();
 
 	void initBeampathButtons();
@@ -193,6 +202,14 @@ private slots:
 	void showODTProgress(double progress, int seconds);
 	void showFluorescenceStatus(ACQUISITION_STATUS state);
 	void showFluorescenceProgress(double progress, int seconds);
+	// shows the durations of the acquisition phases as tooltip of the progress bar
+	void showPhaseTiming(QProgressBar* progressBar, PHASE_TIMING timing);
+	void showSiteRoute(SITE_ROUTE route);
+	void showSitesStatus(ACQUISITION_STATUS status);
+	void showSitesProgress(int finished, int count, int seconds);
+	void showTimelineStatus(ACQUISITION_STATUS status);
+	void showTimelineProgress(int finished, int count, int seconds);
+	void updateSiteRoute();
 
 	// ODT signals
 	void on_alignmentUR_ODT_valueChanged(double);
@@ -257,6 +274,7 @@ private slots:
 
 	void on_actionNew_Acquisition_triggered();
 	void on_actionOpen_Acquisition_triggered();
+	void on_actionResume_Brillouin_Repetition_triggered();
 	void on_actionClose_Acquisition_triggered();
 
 	// acquisition AOI
@@ -274,8 +292,12 @@ private slots:
 	void on_preCalibration_stateChanged(int);
 	void on_postCalibration_stateChanged(int);
 	void on_conCalibration_stateChanged(int);
+	void on_hardwareTimedScan_stateChanged(int);
+	void on_scanTrajectory_currentIndexChanged(int);
 	void on_sampleSelection_currentIndexChanged(const QString &text);
 	void on_conCalibrationInterval_valueChanged(double);
+	void on_adaptiveCalibration_stateChanged(int);
+	void on_driftThreshold_valueChanged(double);
 	void on_nrCalibrationImages_valueChanged(int);
 	void on_calibrationExposureTime_valueChanged(double);
 
@@ -286,6 +308,13 @@ private slots:
 
 	// manual stage control
 	void on_savePosition_clicked();
+	void on_acquireSites_clicked();
+	void on_acquireSitesFluorescence_stateChanged(int);
+	void on_acquireTimeline_clicked();
+	void on_timelineFluorescence_stateChanged(int);
+	void on_timelineFluorescenceInterval_valueChanged(double);
+	void on_timelineODT_stateChanged(int);
+	void on_timelineODTInterval_valueChanged(double);
 	void on_setHome_clicked();
 	void on_moveHome_clicked();
 
@@ -317,9 +346,16 @@ private:
 	typedef enum class enCameraDevice {
 		NONE = 0,
 		POINTGREY = 1,
-		UEYE = 2
+		UEYE = 2,
+		SIMULATED = 3
 	} CAMERA_DEVICE;
-	std::vector<std::string> CAMERA_DEVICE_NAMES = { "None", "PointGrey", "uEye" };
+	std::vector<std::string> CAMERA_DEVICE_NAMES = { "None", "PointGrey", "uEye", "Simulated" };
+
+	typedef enum class enBrillouinCameraDevice {
+		ANDOR = 0,
+		SIMULATED = 1
+	} BRILLOUIN_CAMERA_DEVICE;
+	std::vector<std::string> BRILLOUIN_CAMERA_DEVICE_NAMES = { "Andor", "Simulated" };
 
 	QCPGraph *m_focusMarker{ nullptr };
 	POINT2 m_focusMarkerPos{ -1, -1 };
@@ -327,19 +363,43 @@ private:
 
 	CAMERA_DEVICE m_cameraType = CAMERA_DEVICE::UEYE;
 	CAMERA_DEVICE m_cameraTypeTemporary = m_cameraType;
+	BRILLOUIN_CAMERA_DEVICE m_BrillouinCameraType = BRILLOUIN_CAMERA_DEVICE::ANDOR;
+	BRILLOUIN_CAMERA_DEVICE m_BrillouinCameraTypeTemporary = m_BrillouinCameraType;
 
 	void initScanControl();
 	void initODT();
 	void initFluorescence();
 	void initCamera();
+	bool initBrillouinCamera();
 	QComboBox* m_scanControlDropdown;
 	QComboBox* m_cameraDropdown;
+	QComboBox* m_BrillouinCameraDropdown;
+
+	// storage options of the acquisition, applied to the opened and all following files
+	struct STORAGE_OPTIONS {
+		COMPRESSION_SETTINGS compression;
+		STORAGE_LAYOUT layout{ STORAGE_LAYOUT::H5BM };
+		bool spool{ false };			// payloads are spooled to disk and converted to HDF5 in the background
+		bool packing{ false };			// 12 bit Brillouin images are stored as Mono12Packed
+	};
+	STORAGE_OPTIONS m_storageOptions;
+	STORAGE_OPTIONS m_storageOptionsTemporary = m_storageOptions;
+	std::vector<std::string> COMPRESSION_CODEC_NAMES = { "None", "Deflate", "LZ4" };
+	QComboBox* m_compressionCodecDropdown;
+	QSpinBox* m_compressionLevelSpinBox;
+	QCheckBox* m_compressionShuffleCheckBox;
+	std::vector<std::string> STORAGE_LAYOUT_NAMES = { "One dataset per point (h5bm)", "Preallocated dataset per repetition" };
+	QComboBox* m_storageLayoutDropdown;
+	QCheckBox* m_storageSpoolCheckBox;
+	QCheckBox* m_storagePackingCheckBox;
 	std::string m_calibrationFilePath;
 
 	QDialog *m_settingsDialog = nullptr;
 	void checkElementButtons();
 	void addListToComboBox(QComboBox*, std::vector<std::wstring>, bool clear = true);
 	Andor* m_andor = new Andor();
+	// camera of the Brillouin mode, either the Andor camera or a simulated one
+	Camera* m_BrillouinCamera = m_andor;
 	ScanControl* m_scanControl = nullptr;
 	Camera* m_brightfieldCamera = nullptr;
 	Acquisition *m_acquisition = new Acquisition(nullptr);
@@ -349,19 +409,24 @@ private:
 	Thread m_brightfieldCameraThread;
 	Thread m_acquisitionThread;
 
-	Brillouin* m_Brillouin = new Brillouin(nullptr, m_acquisition, m_andor, &m_scanControl);
+	Brillouin* m_Brillouin = new Brillouin(nullptr, m_acquisition, &m_BrillouinCamera, &m_scanControl);
 	BRILLOUIN_SETTINGS m_BrillouinSettings;
 	ODT* m_ODT = nullptr;
 	Fluorescence* m_Fluorescence = nullptr;
+	MultiSite* m_multiSite = new MultiSite(nullptr, m_Brillouin, &m_Fluorescence, &m_scanControl);
+	MULTISITE_SETTINGS m_multiSiteSettings;
+	Timeline* m_timeline = new Timeline(nullptr, m_Brillouin, &m_Fluorescence, &m_ODT, &m_scanControl);
+	TIMELINE_SETTINGS m_timelineSettings;
 
 	PLOT_SETTINGS m_BrillouinPlot;
 	PLOT_SETTINGS m_ODTPlot;
 
 	template <typename T>
 	void updateImage(PreviewBuffer<T>* previewBuffer, PLOT_SETTINGS* plotSettings);
+	void logPreviewStatistics(std::string name, PreviewBuffer<unsigned char>* previewBuffer);
 
-	template<typename T>
-	void plotting(PreviewBuffer<unsigned char>* previewBuffer, PLOT_SETTINGS* plotSettings, T* unpackedBuffer);
+	template<PIXEL_FORMAT F>
+	void plotting(const FRAME_HEADER* header, PLOT_SETTINGS* plotSettings, unsigned char* frame);
 
 	SETTINGS_DEVICES m_deviceSettings;
 	CAMERA_OPTIONS m_cameraOptions;
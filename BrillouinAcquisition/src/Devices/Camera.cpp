@@ -1,11 +1,19 @@
 #include "stdafx.h"
 #include "Camera.h"
 
+#include <chrono>
+
+namespace {
+	// [1] number of frames the metadata is kept for, e.g. while the preview is running
+	constexpr size_t METADATA_LIMIT{ 4096 };
+}
+
 CAMERA_OPTIONS Camera::getOptions() {
 	return m_options;
 }
 
 CAMERA_SETTINGS Camera::getSettings() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
 	return m_settings;
 }
 
@@ -23,6 +31,75 @@ void Camera::setSetting(CAMERA_SETTING setting, double value) {
 	setSettings(m_settings);
 }
 
+void Camera::writeFrameHeader() {
+	writeFrameHeader(m_settings, m_frameID);
+}
+
+void Camera::writeFrameHeader(const CAMERA_SETTINGS& settings, uint64_t frameID) {
+	auto header = m_previewBuffer->getWriteHeader();
+	if (header == nullptr) {
+		return;
+	}
+	header->pixelFormat = m_previewBuffer->m_bufferSettings.pixelFormat;
+	header->left = settings.roi.left;
+	header->top = settings.roi.top;
+	header->width = settings.roi.width;
+	header->height = settings.roi.height;
+	header->stride = settings.roi.width * bytesPerPixel(header->pixelFormat);
+	header->frameID = frameID;
+	header->timestamp = QDateTime::currentMSecsSinceEpoch() / 1e3;
+	header->exposureTime = settings.exposureTime;
+}
+
+// runs outside of the camera thread, so it must not access the members guarded by the mutex
+void Camera::publishPreview(const unsigned char* frame, const CAMERA_SETTINGS& settings, uint64_t frameID) {
+	// the GUI still shows the previous frames, this one is skipped
+	auto buffer = m_previewBuffer->claimWrite();
+	if (buffer == nullptr) {
+		return;
+	}
+	memcpy(buffer, frame, (size_t)settings.roi.width * settings.roi.height * bytesPerPixel(m_previewBuffer->m_bufferSettings.pixelFormat));
+	writeFrameHeader(settings, frameID);
+	m_previewBuffer->commitWrite();
+}
+
+int Camera::acquireSeries(unsigned char* buffer, int count) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	size_t bytesPerFrame = (size_t)m_settings.roi.width * m_settings.roi.height * bytesPerPixel(m_previewBuffer->m_bufferSettings.pixelFormat);
+	for (gsl::index i{ 0 }; i < count; i++) {
+		acquireImage(buffer + i * bytesPerFrame);
+	}
+	// the cameras without a series mode do not report missing frames
+	return count;
+}
+
+void Camera::setCalibrationExposureTime(double exposureTime) {
+	m_settings.exposureTime = exposureTime;
+}
+
+std::vector<FRAME_METADATA> Camera::takeMetadata() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	std::vector<FRAME_METADATA> metadata(m_metadata.begin(), m_metadata.end());
+	m_metadata.clear();
+	return metadata;
+}
+
+void Camera::addMetadata(FRAME_METADATA metadata) {
+	metadata.frameID = m_frameID;
+	if (metadata.systemTime == 0) {
+		// QDateTime only resolves milliseconds
+		metadata.systemTime = 1e-6 * std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+	if (metadata.exposureTime == 0) {
+		metadata.exposureTime = m_settings.exposureTime;
+	}
+	if (m_metadata.size() >= METADATA_LIMIT) {
+		m_metadata.pop_front();
+	}
+	m_metadata.push_back(metadata);
+}
+
 void Camera::getImageForPreview() {
 	std::lock_guard<std::mutex> lockGuard(m_mutex);
 	if (m_isPreviewRunning) {
@@ -31,15 +108,17 @@ void Camera::getImageForPreview() {
 			return;
 		}
 
-		// if no image is ready return immediately
-		if (!m_previewBuffer->m_buffer->m_freeBuffers->tryAcquire()) {
-			Sleep(50);
-
-			QMetaObject::invokeMethod(this, "getImageForPreview", Qt::QueuedConnection);
-			return;
+		// if no buffer is free, the GUI is still busy with the previous frames
+		auto buffer = m_previewBuffer->claimWrite();
+		if (buffer == nullptr) {
+			// the frame is acquired and dropped, so the camera paces the loop instead of it spinning until a buffer is free
+			m_droppedFrame.resize(m_previewBuffer->m_bufferSettings.bufferSize);
+			acquireImage(m_droppedFrame.data());
+		} else {
+			acquireImage(buffer);
+			writeFrameHeader();
+			m_previewBuffer->commitWrite();
 		}
-		acquireImage(m_previewBuffer->m_buffer->getWriteBuffer());
-		m_previewBuffer->m_buffer->m_usedBuffers->release();
 
 		QMetaObject::invokeMethod(this, "getImageForPreview", Qt::QueuedConnection);
 	}
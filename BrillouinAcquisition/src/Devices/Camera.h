@@ -3,11 +3,13 @@
 
 #include <QtCore>
 #include <gsl/gsl>
+#include <deque>
 
 #include "Device.h"
 
 #include "cameraParameters.h"
 #include "..\previewBuffer.h"
+#include "..\frameHeader.h"
 
 class Camera : public Device {
 	Q_OBJECT
@@ -31,6 +33,21 @@ public:
 	// preview buffer for live acquisition
 	PreviewBuffer<unsigned char>* m_previewBuffer = new PreviewBuffer<unsigned char>;
 
+	// shows an already acquired frame, so the preview copy can be done outside of the acquisition loop,
+	// the settings and the frame ID are the ones the frame was acquired with
+	void publishPreview(const unsigned char* frame, const CAMERA_SETTINGS& settings, uint64_t frameID);
+
+	// acquires the frames into one contiguous buffer without updating the preview,
+	// cameras which support it capture all frames with a single command.
+	// Returns the number of frames acquired, the series stops at the first frame which timed out.
+	virtual int acquireSeries(unsigned char* buffer, int count);
+
+	// returns the metadata of the frames acquired since the last call in acquisition order
+	std::vector<FRAME_METADATA> takeMetadata();
+
+	// changes the exposure time while an acquisition is running
+	virtual void setCalibrationExposureTime(double exposureTime);
+
 public slots:
 	virtual void setSettings(CAMERA_SETTINGS) = 0;
 	virtual void startPreview() = 0;
@@ -50,7 +67,19 @@ protected:
 
 	std::mutex m_mutex;
 
+	// consecutive number of the acquired frames
+	uint64_t m_frameID{ 0 };
+
+	// completes the metadata of the frame just acquired and keeps it until it is taken
+	void addMetadata(FRAME_METADATA metadata);
+	std::deque<FRAME_METADATA> m_metadata;
+
 	virtual void acquireImage(unsigned char* buffer) = 0;
+	// receives the preview frames for which the GUI has no free buffer
+	std::vector<unsigned char> m_droppedFrame;
+	// describe the frame in the current write slot of the preview buffer
+	void writeFrameHeader();
+	void writeFrameHeader(const CAMERA_SETTINGS& settings, uint64_t frameID);
 
 signals:
 	void settingsChanged(CAMERA_SETTINGS);
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "NIDAQ.h"
+#include "../logger.h"
 #include <windows.h>
 
 NIDAQ::NIDAQ() noexcept {
@@ -42,7 +43,7 @@ void NIDAQ::connectDevice() {
 		// Configure analog output channels
 		DAQmxCreateAOVoltageChan(AOtaskHandle, "Dev1/ao0:1", "AO", -1.0, 1.0, DAQmx_Val_Volts, "");
 		// Configure sample rate to 1000 Hz
-		DAQmxCfgSampClkTiming(AOtaskHandle, "", 1000.0, DAQmx_Val_Rising, DAQmx_Val_ContSamps, 1000);
+		DAQmxCfgSampClkTiming(AOtaskHandle, "", m_sampleRate, DAQmx_Val_Rising, DAQmx_Val_ContSamps, 1000);
 
 		// Set analog output to zero
 		float64 data[2] = { 0, 0 };
@@ -55,7 +56,7 @@ void NIDAQ::connectDevice() {
 		// Configure digital output channel
 		DAQmxCreateDOChan(DOtaskHandle, "Dev1/Port0/Line0:0", "DO", DAQmx_Val_ChanForAllLines);
 		// Configure sample rate to 1000 Hz
-		DAQmxCfgSampClkTiming(DOtaskHandle, "/Dev1/ao/SampleClock", 1000.0, DAQmx_Val_Rising, DAQmx_Val_ContSamps, 1000);
+		DAQmxCfgSampClkTiming(DOtaskHandle, "/Dev1/ao/SampleClock", m_sampleRate, DAQmx_Val_Rising, DAQmx_Val_ContSamps, 1000);
 
 		// Set digital line to low
 		DAQmxWriteDigitalLines(DOtaskHandle, 1, false, 10, DAQmx_Val_GroupByChannel, &m_TTL.low, NULL, NULL);
@@ -361,7 +362,7 @@ void NIDAQ::applyScanPosition() {
 	announcePosition();
 }
 
-void NIDAQ::setPosition(POINT3 position) {
+void NIDAQ::clampToBounds(POINT3& position) {
 	// check if position is in valid range
 	// this could also throw an exception in the future
 	// x-value
@@ -378,6 +379,10 @@ void NIDAQ::setPosition(POINT3 position) {
 	if (position.y > m_calibration.bounds.yMax) {
 		position.y = m_calibration.bounds.yMax;
 	}
+}
+
+void NIDAQ::setPosition(POINT3 position) {
+	clampToBounds(position);
 
 	m_position = position;
 	// set the scan position
@@ -493,6 +498,124 @@ void NIDAQ::setAcquisitionVoltages(ACQ_VOLTAGES voltages) {
 	DAQmxStartTask(AOtaskHandle);
 }
 
+int NIDAQ::getSamplesPerPoint(RASTER_TIMING timing) {
+	// the trigger line has to be low before the first pulse
+	int settleSamples = simplemath::max<int>({ 1, (int)ceil(timing.settleTime * m_sampleRate) });
+	// one trigger pulse is two samples long
+	int frameSamples = simplemath::max<int>({ 3, (int)ceil((timing.exposureTime + timing.readoutTime) * m_sampleRate) });
+	return settleSamples + timing.frameCount * frameSamples;
+}
+
+bool NIDAQ::checkError(int32 error, std::string action) {
+	if (!DAQmxFailed(error)) {
+		return true;
+	}
+	char message[2048];
+	DAQmxGetExtendedErrorInfo(message, sizeof(message));
+	std::string info = "The DAQ could not " + action + ": " + message;
+	qWarning(logWarning()) << info.c_str();
+	return false;
+}
+
+bool NIDAQ::startRasterScan(std::vector<POINT3> positions, RASTER_TIMING timing) {
+	m_rasterScan.timing = timing;
+	m_rasterScan.samplesPerPoint = getSamplesPerPoint(timing);
+	m_rasterScan.nextPoint = 0;
+
+	// precompute the mirror voltages of all points, the solution of the calibration is too slow to do it while streaming
+	m_rasterScan.voltages.resize(positions.size());
+	for (gsl::index i{ 0 }; i < (gsl::index)positions.size(); i++) {
+		clampToBounds(positions[i]);
+		m_rasterScan.voltages[i] = positionToVoltage(POINT2{ 1e-6*positions[i].x, 1e-6*positions[i].y });
+	}
+
+	// the waveform is played exactly once, but the buffer only holds two chunks of it
+	uInt64 totalSamples = (uInt64)positions.size() * m_rasterScan.samplesPerPoint;
+	uInt32 bufferSamples = (uInt32)simplemath::min<uInt64>({ totalSamples, (uInt64)2 * timing.chunkPoints * m_rasterScan.samplesPerPoint });
+
+	// Stop DAQ tasks
+	DAQmxStopTask(AOtaskHandle);
+	DAQmxStopTask(DOtaskHandle);
+
+	// a chunk written too late must not be replaced by the voltages and triggers of the previous chunk,
+	// the DAQ stops with an error instead
+	bool configured = checkError(DAQmxCfgSampClkTiming(AOtaskHandle, "", m_sampleRate, DAQmx_Val_Rising, DAQmx_Val_FiniteSamps, totalSamples), "configure the analog timing")
+		&& checkError(DAQmxCfgOutputBuffer(AOtaskHandle, bufferSamples), "configure the analog buffer")
+		&& checkError(DAQmxSetWriteRegenMode(AOtaskHandle, DAQmx_Val_DoNotAllowRegen), "disable the analog regeneration")
+		&& checkError(DAQmxCfgSampClkTiming(DOtaskHandle, "/Dev1/ao/SampleClock", m_sampleRate, DAQmx_Val_Rising, DAQmx_Val_FiniteSamps, totalSamples), "configure the digital timing")
+		&& checkError(DAQmxCfgOutputBuffer(DOtaskHandle, bufferSamples), "configure the digital buffer")
+		&& checkError(DAQmxSetWriteRegenMode(DOtaskHandle, DAQmx_Val_DoNotAllowRegen), "disable the digital regeneration");
+	if (!configured) {
+		return false;
+	}
+
+	// fill the buffer before the tasks start
+	if (!writeRasterChunk() || !writeRasterChunk()) {
+		return false;
+	}
+
+	// Start analog task after digital task since AO is the master
+	return checkError(DAQmxStartTask(DOtaskHandle), "start the digital task")
+		&& checkError(DAQmxStartTask(AOtaskHandle), "start the analog task");
+}
+
+bool NIDAQ::writeRasterChunk() {
+	gsl::index first = m_rasterScan.nextPoint;
+	int count = simplemath::min<int>({ m_rasterScan.timing.chunkPoints, (int)(m_rasterScan.voltages.size() - first) });
+	if (count <= 0) {
+		return true;
+	}
+
+	int samplesPerPoint = m_rasterScan.samplesPerPoint;
+	int settleSamples = simplemath::max<int>({ 1, (int)ceil(m_rasterScan.timing.settleTime * m_sampleRate) });
+	int frameSamples = (samplesPerPoint - settleSamples) / m_rasterScan.timing.frameCount;
+
+	ACQ_VOLTAGES voltages;
+	voltages.numberSamples = count * samplesPerPoint;
+	voltages.trigger = std::vector<uInt8>(voltages.numberSamples, m_TTL.low);
+	voltages.mirror = std::vector<float64>(2 * voltages.numberSamples, 0);
+	for (gsl::index i{ 0 }; i < count; i++) {
+		const VOLTAGE2& voltage = m_rasterScan.voltages[first + i];
+		std::fill_n(voltages.mirror.begin() + i * samplesPerPoint, samplesPerPoint, voltage.Ux);
+		std::fill_n(voltages.mirror.begin() + i * samplesPerPoint + voltages.numberSamples, samplesPerPoint, voltage.Uy);
+		// trigger every frame of the point once the mirrors settled
+		for (gsl::index mm{ 0 }; mm < m_rasterScan.timing.frameCount; mm++) {
+			gsl::index pulse = i * samplesPerPoint + settleSamples + mm * frameSamples;
+			voltages.trigger[pulse] = m_TTL.high;
+			voltages.trigger[pulse + 1] = m_TTL.high;
+		}
+	}
+
+	// blocks until the DAQ played enough samples to make room for the chunk
+	float64 timeout = 10.0 + voltages.numberSamples / m_sampleRate;
+	// fails if the DAQ already ran out of samples
+	bool written = checkError(DAQmxWriteAnalogF64(AOtaskHandle, voltages.numberSamples, false, timeout, DAQmx_Val_GroupByChannel, &voltages.mirror[0], NULL, NULL), "write the mirror voltages")
+		&& checkError(DAQmxWriteDigitalLines(DOtaskHandle, voltages.numberSamples, false, timeout, DAQmx_Val_GroupByChannel, &voltages.trigger[0], NULL, NULL), "write the camera triggers");
+
+	m_rasterScan.nextPoint += count;
+	return written;
+}
+
+void NIDAQ::stopRasterScan() {
+	// Stop DAQ tasks
+	DAQmxStopTask(AOtaskHandle);
+	DAQmxStopTask(DOtaskHandle);
+
+	// restore the timing used for single positions, the buffer is sized by the samples written again
+	DAQmxCfgSampClkTiming(AOtaskHandle, "", m_sampleRate, DAQmx_Val_Rising, DAQmx_Val_ContSamps, 1000);
+	DAQmxResetBufOutputBufSize(AOtaskHandle);
+	DAQmxResetWriteRegenMode(AOtaskHandle);
+	DAQmxCfgSampClkTiming(DOtaskHandle, "/Dev1/ao/SampleClock", m_sampleRate, DAQmx_Val_Rising, DAQmx_Val_ContSamps, 1000);
+	DAQmxResetBufOutputBufSize(DOtaskHandle);
+	DAQmxResetWriteRegenMode(DOtaskHandle);
+
+	m_rasterScan.voltages.clear();
+	m_rasterScan.nextPoint = 0;
+
+	// move the mirrors back to the current position
+	applyScanPosition();
+}
+
 POINT3 NIDAQ::getPosition() {
 	return m_position;
 }
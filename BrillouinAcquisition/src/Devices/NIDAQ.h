@@ -29,6 +29,15 @@ struct ACQ_VOLTAGES {
 	std::vector<uInt8> trigger;
 };
 
+// timing of a hardware-timed raster scan
+struct RASTER_TIMING {
+	double settleTime{ 2e-3 };		// [s]	time for the galvo mirrors to settle at a new point
+	double exposureTime{ 0.5 };		// [s]	exposure time of one frame
+	double readoutTime{ 20e-3 };	// [s]	time between the end of an exposure and the next trigger
+	int frameCount{ 1 };			// [1]	number of frames per point
+	int chunkPoints{ 100 };			// [1]	number of points written to the DAQ buffer at once
+};
+
 class NIDAQ: public ScanControl {
 	Q_OBJECT
 
@@ -66,6 +75,21 @@ private:
 		bool valid = false;
 	} m_calibration;
 
+	void clampToBounds(POINT3& position);
+
+	// logs the extended error info of a failed DAQmx call, returns false if it failed
+	bool checkError(int32 error, std::string action);
+
+	const double m_sampleRate{ 1000 };	// [Hz] sample rate of the analog and digital output
+
+	// state of the running hardware-timed raster scan
+	struct RASTER_SCAN {
+		std::vector<VOLTAGE2> voltages;	// precomputed voltages of all points
+		RASTER_TIMING timing;
+		int samplesPerPoint{ 0 };		// [1] samples the mirrors stay at one point
+		gsl::index nextPoint{ 0 };		// first point not yet written to the DAQ buffer
+	} m_rasterScan;
+
 	VOLTAGE2 m_voltages{ 0, 0 };	// current voltage
 	POINT3 m_position{ 0, 0, 0 };	// current position
 	bool m_LEDon{ false };			// current state of the LED illumination source
@@ -113,6 +137,19 @@ public:
 
 	void setVoltage(VOLTAGE2 voltage);
 
+	/*
+	 * Hardware-timed raster scan
+	 * The mirror voltages of all points are played as one waveform clocked by the DAQ,
+	 * which triggers the camera at every point. The waveform is streamed in chunks.
+	 */
+	int getSamplesPerPoint(RASTER_TIMING timing);
+	// returns false if the DAQ could not be configured or started
+	bool startRasterScan(std::vector<POINT3> positions, RASTER_TIMING timing);
+	// writes the next chunk of the waveform, blocks until the DAQ buffer has room for it,
+	// returns false if the DAQ ran out of samples before
+	bool writeRasterChunk();
+	void stopRasterScan();
+
 	// NIDAQ specific function to move position to center of field of view
 	void centerPosition();
 
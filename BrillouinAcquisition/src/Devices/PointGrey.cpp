@@ -20,6 +20,13 @@ void PointGrey::connectDevice() {
 			m_camera.Connect(&m_guid);
 
 			m_isConnected = true;
+
+			// the camera embeds its frame counter and timestamp into the first pixels of every image
+			FlyCapture2::EmbeddedImageInfo embeddedInfo;
+			m_camera.GetEmbeddedImageInfo(&embeddedInfo);
+			embeddedInfo.frameCounter.onOff = embeddedInfo.frameCounter.available;
+			embeddedInfo.timestamp.onOff = embeddedInfo.timestamp.available;
+			m_camera.SetEmbeddedImageInfo(&embeddedInfo);
 			
 			readOptions();
 
@@ -282,7 +289,7 @@ void PointGrey::preparePreview() {
 	setSettings(m_settings);
 
 	int pixelNumber = m_settings.roi.width * m_settings.roi.height;
-	BUFFER_SETTINGS bufferSettings = { 4, pixelNumber, "unsigned char", m_settings.roi };
+	BUFFER_SETTINGS bufferSettings = { 4, pixelNumber, PIXEL_FORMAT::MONO8, m_settings.roi, BUFFER_MODE::LATEST_FRAME };
 	m_previewBuffer->initializeBuffer(bufferSettings);
 	emit(s_previewBufferSettingsChanged());
 
@@ -305,7 +312,7 @@ void PointGrey::startAcquisition(CAMERA_SETTINGS settings) {
 	setSettings(settings);
 
 	int pixelNumber = m_settings.roi.width * m_settings.roi.height;
-	BUFFER_SETTINGS bufferSettings = { 4, pixelNumber, "unsigned char", m_settings.roi };
+	BUFFER_SETTINGS bufferSettings = { 4, pixelNumber, PIXEL_FORMAT::MONO8, m_settings.roi, BUFFER_MODE::LATEST_FRAME };
 	m_previewBuffer->initializeBuffer(bufferSettings);
 	emit(s_previewBufferSettingsChanged());
 
@@ -335,6 +342,18 @@ void PointGrey::acquireImage(unsigned char* buffer) {
 	if (data != NULL && buffer != nullptr) {
 		memcpy(buffer, data, m_settings.roi.width*m_settings.roi.height);
 	}
+	m_frameID++;
+
+	/*
+	 * The cycle time is the clock of the camera, it counts 8000 cycles of 3072 offsets per second
+	 * and wraps around every 128 seconds. The seconds of the time stamp are set by the host.
+	 */
+	FRAME_METADATA metadata;
+	FlyCapture2::TimeStamp timeStamp = rawImage.GetTimeStamp();
+	metadata.timestamp = timeStamp.cycleSeconds + (timeStamp.cycleCount + timeStamp.cycleOffset / 3072.0) / 8000.0;
+	metadata.systemTime = timeStamp.seconds + 1e-6 * timeStamp.microSeconds;
+	metadata.cameraFrame = rawImage.GetMetadata().embeddedFrameCounter;
+	addMetadata(metadata);
 }
 
 void PointGrey::getImageForAcquisition(unsigned char* buffer, bool preview) {
@@ -345,9 +364,13 @@ void PointGrey::getImageForAcquisition(unsigned char* buffer, bool preview) {
 	acquireImage(buffer);
 
 	if (preview && buffer != nullptr) {
-		// write image to preview buffer
-		memcpy(m_previewBuffer->m_buffer->getWriteBuffer(), buffer, m_settings.roi.width * m_settings.roi.height);
-		m_previewBuffer->m_buffer->m_usedBuffers->release();
+		// write image to preview buffer, the GUI only shows the latest frame
+		auto previewBuffer = m_previewBuffer->claimWrite();
+		if (previewBuffer != nullptr) {
+			memcpy(previewBuffer, buffer, m_settings.roi.width * m_settings.roi.height);
+			writeFrameHeader();
+			m_previewBuffer->commitWrite();
+		}
 	}
 }
 
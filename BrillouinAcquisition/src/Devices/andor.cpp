@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include "andor.h"
+#include "../logger.h"
+#include "../pixelPacking.h"
 
 Andor::~Andor() {
 	std::lock_guard<std::mutex> lockGuard(m_mutex);
@@ -116,6 +118,16 @@ void Andor::setSettings(CAMERA_SETTINGS settings) {
 	AT_SetEnumeratedString(m_camera, L"CycleMode", m_settings.readout.cycleMode.c_str());
 	AT_SetEnumeratedString(m_camera, L"TriggerMode", m_settings.readout.triggerMode.c_str());
 
+	// every frame carries the timestamp of the sensor clock behind the image data
+	AT_BOOL metadata{ AT_FALSE };
+	AT_IsImplemented(m_camera, L"MetadataEnable", &metadata);
+	m_timestampFrequency = 0;
+	if (metadata) {
+		AT_SetBool(m_camera, L"MetadataEnable", AT_TRUE);
+		AT_SetBool(m_camera, L"MetadataTimestamp", AT_TRUE);
+		AT_GetInt(m_camera, L"TimestampClockFrequency", &m_timestampFrequency);
+	}
+
 	// Allocate a buffer
 	// Get the number of bytes required to store one frame
 	AT_64 ImageSizeBytes;
@@ -238,11 +250,13 @@ void Andor::preparePreview() {
 	AT_GetInt(m_camera, L"ImageSizeBytes", &ImageSizeBytes);
 	int BufferSize = static_cast<int>(ImageSizeBytes);
 
-	BUFFER_SETTINGS bufferSettings = { 5, BufferSize, "unsigned short", m_settings.roi };
+	BUFFER_SETTINGS bufferSettings = { 5, BufferSize, PIXEL_FORMAT::MONO16, m_settings.roi, BUFFER_MODE::LATEST_FRAME };
 	m_previewBuffer->initializeBuffer(bufferSettings);
 	emit(s_previewBufferSettingsChanged());
 
-	// Start acquisition
+	// Start acquisition, the preview consumes every frame, so the next one can be triggered ahead
+	queueBuffers();
+	m_triggerAhead = true;
 	AT_Command(m_camera, L"AcquisitionStart");
 	AT_InitialiseUtilityLibrary();
 }
@@ -267,11 +281,13 @@ void Andor::startAcquisition(CAMERA_SETTINGS settings) {
 	AT_GetInt(m_camera, L"ImageSizeBytes", &ImageSizeBytes);
 	int BufferSize = static_cast<int>(ImageSizeBytes);
 
-	BUFFER_SETTINGS bufferSettings = { 4, BufferSize, "unsigned short", m_settings.roi };
+	BUFFER_SETTINGS bufferSettings = { 4, BufferSize, PIXEL_FORMAT::MONO16, m_settings.roi, BUFFER_MODE::LATEST_FRAME };
 	m_previewBuffer->initializeBuffer(bufferSettings);
 	emit(s_previewBufferSettingsChanged());
 
-	// Start acquisition
+	// Start acquisition, the settings applied above reset a configured series
+	m_burstFrames = 0;
+	queueBuffers();
 	AT_Command(m_camera, L"AcquisitionStart");
 	AT_InitialiseUtilityLibrary();
 
@@ -281,41 +297,266 @@ void Andor::startAcquisition(CAMERA_SETTINGS settings) {
 
 void Andor::stopAcquisition() {
 	cleanupAcquisition();
+	logQueueStatistics();
 	m_isAcquisitionRunning = false;
 	emit(s_acquisitionRunning(m_isAcquisitionRunning));
 }
 
 void Andor::cleanupAcquisition() {
+	m_triggerAhead = false;
 	AT_FinaliseUtilityLibrary();
 	AT_Command(m_camera, L"AcquisitionStop");
 	AT_Flush(m_camera);
+	if (m_burstFrames > 0) {
+		endBurst(false);
+	}
+}
+
+void Andor::queueBuffers(bool resetStatistics) {
+	AT_Flush(m_camera);
+
+	// the sensor is exposed while the previous frame is read out, if the camera supports it
+	AT_BOOL overlap{ AT_FALSE };
+	AT_IsImplemented(m_camera, L"Overlap", &overlap);
+	if (overlap) {
+		AT_SetBool(m_camera, L"Overlap", AT_TRUE);
+	}
+
+	// the frame geometry does not change during the acquisition
+	AT_GetInt(m_camera, L"AOIHeight", &m_settings.roi.height);
+	AT_GetInt(m_camera, L"AOIWidth", &m_settings.roi.width);
+	AT_GetInt(m_camera, L"AOIStride", &m_imageStride);
+
+	// the buffers are only allocated again if the frame size changed
+	constexpr size_t alignment{ 8 };
+	size_t size = (size_t)m_bufferSize + alignment - 1;
+	if (m_sdkBuffers.size() != m_queueDepth || m_sdkBuffers[0].memory.size() != size) {
+		m_sdkBuffers = std::vector<SDK_BUFFER>(m_queueDepth);
+		for (auto& buffer : m_sdkBuffers) {
+			buffer.memory.resize(size);
+			auto address = reinterpret_cast<uintptr_t>(buffer.memory.data());
+			buffer.data = buffer.memory.data() + (alignment - address % alignment) % alignment;
+		}
+	}
+	for (auto& buffer : m_sdkBuffers) {
+		AT_QueueBuffer(m_camera, buffer.data, m_bufferSize);
+	}
+
+	// the flushed frames are gone, the ring only keeps the slot memory
+	int frameBytes = (int)(2 * m_settings.roi.width * m_settings.roi.height);
+	auto memory = m_ringArena.reserve(CircularBuffer<unsigned char>::getMemorySize((int)DEFAULT_QUEUE_DEPTH, frameBytes));
+	m_frameRing = std::make_unique<CircularBuffer<unsigned char>>((int)DEFAULT_QUEUE_DEPTH, frameBytes, memory);
+	m_framesInFlight = 0;
+
+	if (resetStatistics) {
+		m_queueStatistics = ANDOR_QUEUE_STATISTICS{};
+		if (m_settings.exposureTime > 0) {
+			m_queueStatistics.exposureRate = 1 / m_settings.exposureTime;
+		}
+		AT_GetFloatMax(m_camera, L"FrameRate", &m_queueStatistics.maxFrameRate);
+	}
+}
+
+bool Andor::waitFrame(unsigned char* destination, int timeout) {
+	// Sleep in this thread until data is ready
+	unsigned char* buffer{ nullptr };
+	int size{ 0 };
+	int ret = AT_WaitBuffer(m_camera, &buffer, &size, timeout);
+	if (ret != AT_SUCCESS) {
+		// polling for frames which already arrived is not a timeout
+		if (timeout > 0) {
+			m_queueStatistics.timeouts++;
+		}
+		return false;
+	}
+	if (m_framesInFlight > 0) {
+		m_framesInFlight--;
+	}
+	// the next frame is exposed while this one is converted
+	if (m_triggerAhead && m_settings.readout.triggerMode == L"Software") {
+		triggerFrame();
+	}
+
+	if (m_queueStatistics.frames == 0) {
+		m_queueTimer.start();
+	} else {
+		m_queueStatistics.duration = 1e-9 * m_queueTimer.nsecsElapsed();
+	}
+	m_queueStatistics.frames++;
+
+	// Process the image
+	if (destination != nullptr) {
+		convertFrame(buffer, reinterpret_cast<unsigned short*>(destination));
+	}
+
+	// the camera has no frame counter, the frames are counted from the start of the acquisition
+	FRAME_METADATA metadata;
+	metadata.cameraFrame = m_queueStatistics.frames;
+	AT_64 ticks{ 0 };
+	if (m_timestampFrequency > 0 && AT_GetTimeStampFromMetadata(buffer, m_bufferSize, ticks) == AT_SUCCESS) {
+		metadata.timestamp = (double)ticks / m_timestampFrequency;
+	}
+
+	// the camera gets the buffer back right away
+	AT_QueueBuffer(m_camera, buffer, m_bufferSize);
+	m_frameID++;
+	addMetadata(metadata);
+	return true;
+}
+
+/*
+ * Converts the frame to Mono16 and removes the padding of the rows.
+ * The 12 bit encodings are unpacked with the vectorised kernels, the others by the SDK.
+ */
+void Andor::convertFrame(const unsigned char* buffer, unsigned short* destination) {
+	auto width = (size_t)m_settings.roi.width;
+	if (m_settings.readout.pixelEncoding == L"Mono12Packed") {
+		for (gsl::index row{ 0 }; row < m_settings.roi.height; row++) {
+			PixelPacking::unpackMono12Packed(buffer + row * m_imageStride, destination + row * width, width);
+		}
+	} else if (m_settings.readout.pixelEncoding == L"Mono12") {
+		for (gsl::index row{ 0 }; row < m_settings.roi.height; row++) {
+			PixelPacking::unpackMono12(reinterpret_cast<const unsigned short*>(buffer + row * m_imageStride), destination + row * width, width);
+		}
+	} else {
+		AT_ConvertBuffer(const_cast<unsigned char*>(buffer), reinterpret_cast<unsigned char*>(destination), m_settings.roi.width,
+			m_settings.roi.height, m_imageStride, m_settings.readout.pixelEncoding.c_str(), L"Mono16");
+	}
 }
 
 void Andor::acquireImage(unsigned char* buffer) {
-	// Pass this buffer to the SDK
-	unsigned char* UserBuffer = new unsigned char[m_bufferSize];
-	AT_QueueBuffer(m_camera, UserBuffer, m_bufferSize);
+	acquireFrame(buffer);
+}
+
+bool Andor::acquireFrame(unsigned char* buffer) {
+	// single frames are triggered one by one again
+	if (m_burstFrames > 0) {
+		endBurst();
+	}
 
-	// Acquire camera images
+	// frames which already arrived are converted right away, so their SDK buffers are queued again
+	unsigned char* slot{ nullptr };
+	while ((slot = m_frameRing->claimWrite()) != nullptr && waitFrame(slot, 0)) {
+		m_frameRing->commitWrite();
+	}
+
+	auto frame = m_frameRing->claimRead();
+	if (frame != nullptr) {
+		memcpy(buffer, frame, m_frameRing->getBufferSize());
+		m_frameRing->releaseRead();
+		return true;
+	}
+
+	// Acquire camera images, externally triggered frames are started by the trigger line
+	int timeout = (int)(1500 * m_settings.exposureTime);
+	if (m_settings.readout.triggerMode == L"Software") {
+		// the frame might already be triggered ahead
+		if (m_framesInFlight == 0) {
+			triggerFrame();
+		}
+	} else {
+		// the frame additionally waits for the trigger
+		timeout += 1000;
+	}
+
+	if (!waitFrame(buffer, timeout)) {
+		// a frame arriving late must not be returned for the next request
+		discardFrames();
+		return false;
+	}
+	return true;
+}
+
+void Andor::triggerFrame() {
 	AT_Command(m_camera, L"SoftwareTrigger");
+	m_framesInFlight++;
+}
 
-	// Sleep in this thread until data is ready
-	unsigned char* Buffer;
-	int ret = AT_WaitBuffer(m_camera, &Buffer, &m_bufferSize, 1500 * m_settings.exposureTime);
-	// return if AT_WaitBuffer timed out
-	if (ret == AT_ERR_TIMEDOUT) {
+int Andor::acquireSeries(unsigned char* buffer, int count) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	int64_t bytesPerFrame = (int64_t)2 * m_settings.roi.width * m_settings.roi.height;
+
+	int acquired{ 0 };
+	// externally triggered frames are started by the trigger line one by one
+	if (m_settings.readout.triggerMode != L"Software" || count < 2) {
+		while (acquired < count && acquireFrame(buffer + acquired * bytesPerFrame)) {
+			acquired++;
+		}
+	} else {
+		if (m_burstFrames != count) {
+			startBurst(count);
+		}
+		// the camera exposes the frames back to back, every frame may take as long as a software triggered one
+		AT_Command(m_camera, L"AcquisitionStart");
+		int timeout = (int)(1500 * m_settings.exposureTime) + 1000;
+		while (acquired < count && waitFrame(buffer + acquired * bytesPerFrame, timeout)) {
+			acquired++;
+		}
+		AT_Command(m_camera, L"AcquisitionStop");
+		if (acquired < count) {
+			discardFrames();
+		}
+	}
+	return acquired;
+}
+
+void Andor::discardFrames() {
+	// a burst is started again by the next series
+	if (m_burstFrames > 0) {
+		queueBuffers(false);
 		return;
 	}
+	AT_Command(m_camera, L"AcquisitionStop");
+	queueBuffers(false);
+	AT_Command(m_camera, L"AcquisitionStart");
+}
 
-	// Process the image
-	//Unpack the 12 bit packed data
-	AT_GetInt(m_camera, L"AOIHeight", &m_settings.roi.height);
-	AT_GetInt(m_camera, L"AOIWidth", &m_settings.roi.width);
-	AT_GetInt(m_camera, L"AOIStride", &m_imageStride);
+void Andor::startBurst(int count) {
+	AT_Command(m_camera, L"AcquisitionStop");
+	AT_SetEnumeratedString(m_camera, L"CycleMode", L"Fixed");
+	AT_SetEnumeratedString(m_camera, L"TriggerMode", L"Internal");
+	AT_SetInt(m_camera, L"FrameCount", count);
+
+	// every frame of the series needs a queued buffer, so none is lost if the conversion falls behind
+	m_queueDepth = simplemath::max<size_t>({ DEFAULT_QUEUE_DEPTH, (size_t)count });
+	queueBuffers(false);
+	m_burstFrames = count;
+}
+
+void Andor::endBurst(bool restart) {
+	AT_Command(m_camera, L"AcquisitionStop");
+	AT_SetEnumeratedString(m_camera, L"CycleMode", m_settings.readout.cycleMode.c_str());
+	AT_SetEnumeratedString(m_camera, L"TriggerMode", m_settings.readout.triggerMode.c_str());
+	m_burstFrames = 0;
+	// the buffers of a long series are released again the next time the buffers are queued
+	m_queueDepth = DEFAULT_QUEUE_DEPTH;
+
+	if (restart) {
+		// frames of an interrupted series must not be returned as single frames
+		queueBuffers(false);
+		AT_Command(m_camera, L"AcquisitionStart");
+	}
+}
 
-	AT_ConvertBuffer(Buffer, buffer, m_settings.roi.width, m_settings.roi.height, m_imageStride, m_settings.readout.pixelEncoding.c_str(), L"Mono16");
+ANDOR_QUEUE_STATISTICS Andor::getQueueStatistics() {
+	ANDOR_QUEUE_STATISTICS statistics = m_queueStatistics;
+	if (statistics.frames > 1 && statistics.duration > 0) {
+		statistics.frameRate = (statistics.frames - 1) / statistics.duration;
+	}
+	return statistics;
+}
 
-	delete[] Buffer;
+void Andor::logQueueStatistics() {
+	ANDOR_QUEUE_STATISTICS statistics = getQueueStatistics();
+	if (statistics.frames < 2 || statistics.exposureRate <= 0) {
+		return;
+	}
+	// software-triggered acquisitions include the pauses between the triggers
+	std::string info = "Andor: " + std::to_string(statistics.frames) + " frames at " + std::to_string(statistics.frameRate)
+		+ " Hz, the exposure time limits the rate to " + std::to_string(statistics.exposureRate) + " Hz ("
+		+ std::to_string((int)round(100 * statistics.frameRate / statistics.exposureRate)) + " %), the camera supports up to "
+		+ std::to_string(statistics.maxFrameRate) + " Hz, " + std::to_string(statistics.timeouts) + " timeouts.";
+	qInfo(logInfo()) << info.c_str();
 }
 
 void Andor::getImageForAcquisition(unsigned char* buffer, bool preview) {
@@ -323,9 +564,13 @@ void Andor::getImageForAcquisition(unsigned char* buffer, bool preview) {
 	acquireImage(buffer);
 
 	if (preview) {
-		// write image to preview buffer
-		memcpy(m_previewBuffer->m_buffer->getWriteBuffer(), buffer, m_settings.roi.width * m_settings.roi.height * 2);
-		m_previewBuffer->m_buffer->m_usedBuffers->release();
+		// write image to preview buffer, the GUI only shows the latest frame
+		auto previewBuffer = m_previewBuffer->claimWrite();
+		if (previewBuffer != nullptr) {
+			memcpy(previewBuffer, buffer, m_settings.roi.width * m_settings.roi.height * 2);
+			writeFrameHeader();
+			m_previewBuffer->commitWrite();
+		}
 	}
 }
 
@@ -335,5 +580,8 @@ void Andor::setCalibrationExposureTime(double exposureTime) {
 	// Set the exposure time
 	AT_SetFloat(m_camera, L"ExposureTime", m_settings.exposureTime);
 
-	AT_Command(m_camera, L"AcquisitionStart");
+	// a series is started by acquireSeries() itself
+	if (m_burstFrames == 0) {
+		AT_Command(m_camera, L"AcquisitionStart");
+	}
 }
@@ -21,6 +21,16 @@ typedef struct {
 	ANDOR_TEMPERATURE_STATUS status = COOLER_OFF;
 } SensorTemperature;
 
+// frame rate of the queued acquisition
+struct ANDOR_QUEUE_STATISTICS {
+	int frames{ 0 };				// [1]	delivered frames
+	int timeouts{ 0 };				// [1]	frames which did not arrive in time
+	double duration{ 0 };			// [s]	time from the first to the last delivered frame
+	double frameRate{ 0 };			// [Hz]	achieved frame rate
+	double exposureRate{ 0 };		// [Hz]	frame rate limited by the exposure time
+	double maxFrameRate{ 0 };		// [Hz]	frame rate limited by exposure and readout as reported by the camera
+};
+
 class Andor : public Camera {
 	Q_OBJECT
 
@@ -37,13 +47,61 @@ private:
 	QTimer *m_tempTimer = nullptr;
 	SensorTemperature m_sensorTemperature;
 	AT_64 m_imageStride = 0;
+	AT_64 m_timestampFrequency = 0;		// [Hz]	clock of the metadata timestamps, 0 if the camera has no metadata
 	int m_bufferSize = -1;
 
+	/*
+	 * Queued acquisition: a set of SDK buffers is queued at all times and every buffer is queued again
+	 * as soon as its frame is converted. So the camera never waits for a buffer and the readout
+	 * of a frame overlaps the exposure of the next one.
+	 */
+	struct SDK_BUFFER {
+		std::vector<unsigned char> memory;
+		unsigned char* data{ nullptr };		// start of the buffer, aligned as required by the SDK
+	};
+	std::vector<SDK_BUFFER> m_sdkBuffers;
+	static constexpr size_t DEFAULT_QUEUE_DEPTH{ 8 };
+	size_t m_queueDepth{ DEFAULT_QUEUE_DEPTH };
+	ANDOR_QUEUE_STATISTICS m_queueStatistics;
+	QElapsedTimer m_queueTimer;				// started with the first delivered frame
+
+	// queues all SDK buffers, the acquisition has to be started afterwards
+	void queueBuffers(bool resetStatistics = true);
+	// waits for the next frame, converts it to Mono16 and queues its buffer again, returns false on a timeout
+	bool waitFrame(unsigned char* destination, int timeout);
+
+	/*
+	 * While the frames are consumed continuously, e.g. by the preview, the next software trigger is sent
+	 * as soon as a frame arrives and before it is converted, so the conversion overlaps the next exposure.
+	 * Frames which arrive before they are requested are converted right away, so their SDK buffers
+	 * are queued again, and wait in the ring until they are requested.
+	 */
+	bool m_triggerAhead{ false };
+	int m_framesInFlight{ 0 };				// [1]	software triggered frames which did not arrive yet
+	FrameArena m_ringArena;
+	std::unique_ptr<CircularBuffer<unsigned char>> m_frameRing;
+	void triggerFrame();
+	void convertFrame(const unsigned char* buffer, unsigned short* destination);
+	void logQueueStatistics();
+
+	/*
+	 * Burst mode: the frames of a series are exposed back to back by the internal trigger
+	 * after a single AcquisitionStart, instead of one software trigger per frame.
+	 * The camera stays configured for the series until a single frame is requested.
+	 */
+	int m_burstFrames{ 0 };					// [1]	number of frames the camera is configured for, 0 if not in burst mode
+	void startBurst(int count);
+	void endBurst(bool restart = true);
+	// drops the frames of an interrupted series, so a late frame is not returned by the next one
+	void discardFrames();
+
 	void cleanupAcquisition();
 	void getEnumString(AT_WC* feature, std::wstring* string);
 	void preparePreview();
 
 	void acquireImage(unsigned char* buffer) override;
+	// returns false if the frame timed out
+	bool acquireFrame(unsigned char* buffer);
 
 	/*
 	 * Members and functions inherited from base class
@@ -63,7 +121,8 @@ public:
 	bool getSensorCooling();
 	const std::string getTemperatureStatus();
 	double getSensorTemperature();
-	void setCalibrationExposureTime(double);
+	void setCalibrationExposureTime(double) override;
+	ANDOR_QUEUE_STATISTICS getQueueStatistics();
 
 private slots:
 	void checkSensorTemperature();
@@ -90,6 +149,7 @@ public slots:
 	void stopAcquisition();
 	
 	void getImageForAcquisition(unsigned char* buffer, bool preview = true) override;
+	int acquireSeries(unsigned char* buffer, int count) override;
 
 signals:
 	void cameraCoolingChanged(bool);
@@ -93,6 +93,28 @@ void ScanControl::calculateCurrentPositionBounds() {
 	emit(currentPositionBoundsChanged(m_currentPositionBounds));
 }
 
+int ScanControl::countPresetMoves(SCAN_PRESET presetType, const std::vector<int>& positions) {
+	auto preset = getPreset(presetType);
+	int moves{ 0 };
+	for (gsl::index ii = 0; ii < preset.elementPositions.size() && ii < positions.size(); ii++) {
+		if (!preset.elementPositions[ii].empty() && !simplemath::contains(preset.elementPositions[ii], positions[ii])) {
+			moves++;
+		}
+	}
+	return moves;
+}
+
+std::vector<int> ScanControl::applyPreset(SCAN_PRESET presetType, std::vector<int> positions) {
+	auto preset = getPreset(presetType);
+	// the elements are moved like setPreset() does
+	for (gsl::index ii = 0; ii < preset.elementPositions.size() && ii < positions.size(); ii++) {
+		if (!preset.elementPositions[ii].empty() && !simplemath::contains(preset.elementPositions[ii], positions[ii])) {
+			positions[ii] = preset.elementPositions[ii][0];
+		}
+	}
+	return positions;
+}
+
 Preset ScanControl::getPreset(SCAN_PRESET presetType) {
 	for (gsl::index ii = 0; ii < m_presets.size(); ii++) {
 		if (m_presets[ii].index == presetType) {
@@ -125,6 +147,10 @@ void ScanControl::deleteSavedPosition(int index) {
 	}
 }
 
+std::vector<POINT3> ScanControl::getSavedPositions() {
+	return m_savedPositions;
+}
+
 std::vector<POINT3> ScanControl::getSavedPositionsNormalized() {
 	std::vector<POINT3> savedPositionsNormalized = m_savedPositions;
 	std::transform(savedPositionsNormalized.begin(), savedPositionsNormalized.end(), savedPositionsNormalized.begin(),
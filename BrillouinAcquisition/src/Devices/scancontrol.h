@@ -152,6 +152,11 @@ public:
 	void movePosition(POINT3 distance);
 	virtual POINT3 getPosition() = 0;
 
+	// number of elements which have to move to set the preset, starting at the element positions
+	int countPresetMoves(SCAN_PRESET preset, const std::vector<int>& positions);
+	// element positions after setting the preset, starting at the element positions
+	std::vector<int> applyPreset(SCAN_PRESET preset, std::vector<int> positions);
+
 	QTimer *positionTimer = nullptr;
 	QTimer *elementPositionTimer = nullptr;
 
@@ -178,6 +183,7 @@ public slots:
 	void deleteSavedPosition(int index);
 	virtual void loadVoltagePositionCalibration(std::string filepath) {};
 
+	std::vector<POINT3> getSavedPositions();
 	std::vector<POINT3> getSavedPositionsNormalized();
 	void announceSavedPositionsNormalized();
 
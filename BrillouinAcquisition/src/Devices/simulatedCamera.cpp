@@ -0,0 +1,389 @@
+#include "stdafx.h"
+#include "simulatedCamera.h"
+#include "../pixelPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+namespace {
+	constexpr double PI{ 3.14159265358979323846 };
+	// [1] number of positions a row of noise can start at, a power of two
+	constexpr size_t NOISE_TABLE_SIZE{ 1 << 16 };
+
+	/*
+	 * VIPA spectrometer, in units of the sensor
+	 */
+	constexpr double FREE_SPECTRAL_RANGE{ 0.4 };	// [sensor width]	distance of the Rayleigh lines of two orders
+	constexpr double RAYLEIGH_POSITION{ 0.3 };		// [sensor width]	Rayleigh line of the first order
+	constexpr double BRILLOUIN_SHIFT{ 5.0 / 30 };	// [FSR]	Brillouin shift of 5 GHz at a free spectral range of 30 GHz
+	constexpr double SHIFT_DRIFT{ 0.1 / 30 };		// [FSR]	amplitude of the slow drift of the shift
+	constexpr double DRIFT_PERIOD{ 60 };			// [s]	period of the drift of the shift
+	constexpr double RAYLEIGH_WIDTH{ 2 };			// [pix]	half width at half maximum of the Rayleigh lines
+	constexpr double BRILLOUIN_WIDTH{ 4 };			// [pix]	half width at half maximum of the Brillouin peaks
+	constexpr double SPECTRUM_HEIGHT{ 4 };			// [pix]	standard deviation of the spectrum perpendicular to the dispersion
+	constexpr double RAYLEIGH_RATE{ 4e4 };			// [1/s]	counts of the Rayleigh lines at their maximum
+	constexpr double BRILLOUIN_RATE{ 1e4 };			// [1/s]	counts of the Brillouin peaks at their maximum
+	constexpr double BACKGROUND_RATE{ 100 };		// [1/s]	counts of the stray light
+	constexpr double DARK_OFFSET{ 100 };			// [1]	offset of the sensor
+	constexpr double READ_NOISE{ 2 };				// [1]	standard deviation of the readout
+	constexpr double POISSON_LIMIT{ 30 };			// [1]	expected counts below which the shot noise is not approximated by a normal distribution
+
+	/*
+	 * Hologram of a bead moving on a circle
+	 */
+	constexpr double BRIGHTFIELD_LEVEL{ 100 };		// [1]	mean counts at an exposure time of 10 ms
+	constexpr double FRINGE_VISIBILITY{ 0.6 };
+	constexpr int FRINGE_PERIOD{ 8 };				// [pix]	period of the carrier along both directions
+	constexpr double BEAD_RADIUS{ 40 };				// [pix]
+	constexpr double BEAD_PHASE{ 2 };				// [rad]	phase delay in the center of the bead
+	constexpr double BEAD_ABSORPTION{ 0.2 };
+	constexpr double BEAD_PERIOD{ 20 };				// [s]	period of the circular motion of the bead
+
+	double lorentzian(double x, double center, double width) {
+		double distance = (x - center) / width;
+		return 1 / (1 + distance * distance);
+	}
+
+	// rounds the counts to the range of the pixel, called for every pixel
+	double quantize(double value, double saturation) {
+		return (value < 0) ? 0 : ((value > saturation) ? saturation : floor(value + 0.5));
+	}
+}
+
+SimulatedCamera::SimulatedCamera(SIMULATED_CAMERA configuration) noexcept : m_configuration(configuration) {
+	if (m_configuration.pixelEncodings.empty()) {
+		if (m_configuration.role == SIMULATED_CAMERA_ROLE::SPECTROMETER) {
+			m_configuration.pixelEncodings = { L"Mono16", L"Mono12", L"Mono12Packed" };
+		} else {
+			m_configuration.pixelEncodings = { L"Mono8" };
+		}
+	}
+
+	// the noise is drawn from a table, so rendering a frame takes less time than exposing it
+	m_noise.resize(NOISE_TABLE_SIZE + (size_t)m_configuration.sensorSize[0]);
+	std::mt19937 generator;
+	std::normal_distribution<float> distribution;
+	for (auto& value : m_noise) {
+		value = distribution(generator);
+	}
+
+	m_settings.roi.left = 1;
+	m_settings.roi.top = 1;
+	m_settings.roi.width = m_configuration.sensorSize[0];
+	m_settings.roi.height = m_configuration.sensorSize[1];
+	m_settings.readout.pixelEncoding = m_configuration.pixelEncodings[0];
+	m_settings.readout.triggerMode = L"Software";
+	if (m_configuration.role == SIMULATED_CAMERA_ROLE::BRIGHTFIELD) {
+		m_settings.exposureTime = 0.01;
+	}
+}
+
+SimulatedCamera::~SimulatedCamera() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	disconnectDevice();
+}
+
+void SimulatedCamera::connectDevice() {
+	if (!m_isConnected) {
+		m_isConnected = true;
+		m_start = Clock::now();
+		m_nextFrame = m_start;
+		m_cameraFrame = 0;
+		readOptions();
+		setSettings(m_settings);
+	}
+	emit(connectedDevice(m_isConnected));
+}
+
+void SimulatedCamera::disconnectDevice() {
+	if (m_isConnected) {
+		if (m_isPreviewRunning) {
+			stopPreview();
+		}
+		m_isConnected = false;
+	}
+	emit(connectedDevice(m_isConnected));
+}
+
+void SimulatedCamera::readOptions() {
+	m_options.pixelEncodings = m_configuration.pixelEncodings;
+	m_options.triggerModes = { L"Internal", L"Software" };
+	m_options.exposureTimeLimits = { m_configuration.exposureTimeLimits[0], m_configuration.exposureTimeLimits[1] };
+	m_options.ROIWidthLimits = { m_configuration.ROIMinimum[0], m_configuration.sensorSize[0] };
+	m_options.ROIHeightLimits = { m_configuration.ROIMinimum[1], m_configuration.sensorSize[1] };
+
+	emit(optionsChanged(m_options));
+}
+
+void SimulatedCamera::setSettings(CAMERA_SETTINGS settings) {
+	m_settings = settings;
+
+	// apply the limits of the sensor like a camera would, the ROI starts at 1
+	m_settings.exposureTime = simplemath::min<double>({ simplemath::max<double>({ m_settings.exposureTime,
+		m_configuration.exposureTimeLimits[0] }), m_configuration.exposureTimeLimits[1] });
+	for (gsl::index i{ 0 }; i < 2; i++) {
+		AT_64& size = (i == 0) ? m_settings.roi.width : m_settings.roi.height;
+		AT_64& start = (i == 0) ? m_settings.roi.left : m_settings.roi.top;
+		size = simplemath::min<AT_64>({ simplemath::max<AT_64>({ size, m_configuration.ROIMinimum[i] }), m_configuration.sensorSize[i] });
+		start = simplemath::min<AT_64>({ simplemath::max<AT_64>({ start, 1 }), m_configuration.sensorSize[i] - size + 1 });
+	}
+	m_settings.roi.binning = L"1x1";
+
+	auto encodings = m_configuration.pixelEncodings;
+	if (std::find(encodings.begin(), encodings.end(), m_settings.readout.pixelEncoding) == encodings.end()) {
+		m_settings.readout.pixelEncoding = encodings[0];
+	}
+	// there is no trigger line, so external triggers are replaced by the software trigger
+	if (m_settings.readout.triggerMode != L"Internal") {
+		m_settings.readout.triggerMode = L"Software";
+	}
+
+	// the free running sensor restarts with the new settings
+	m_nextFrame = Clock::now();
+
+	readSettings();
+}
+
+void SimulatedCamera::readSettings() {
+	// emit signal that settings changed
+	emit(settingsChanged(m_settings));
+}
+
+void SimulatedCamera::setCalibrationExposureTime(double exposureTime) {
+	m_settings.exposureTime = simplemath::min<double>({ simplemath::max<double>({ exposureTime,
+		m_configuration.exposureTimeLimits[0] }), m_configuration.exposureTimeLimits[1] });
+	m_nextFrame = Clock::now();
+}
+
+PIXEL_FORMAT SimulatedCamera::pixelFormat() {
+	if (m_configuration.role == SIMULATED_CAMERA_ROLE::SPECTROMETER) {
+		return PIXEL_FORMAT::MONO16;
+	}
+	return PIXEL_FORMAT::MONO8;
+}
+
+size_t SimulatedCamera::frameSize() {
+	return (size_t)m_settings.roi.width * m_settings.roi.height * bytesPerPixel(pixelFormat());
+}
+
+void SimulatedCamera::startPreview() {
+	// don't do anything if an acquisition is running
+	if (m_isAcquisitionRunning) {
+		return;
+	}
+	m_isPreviewRunning = true;
+	m_stopPreview = false;
+	preparePreview();
+	getImageForPreview();
+
+	emit(s_previewRunning(m_isPreviewRunning));
+}
+
+void SimulatedCamera::preparePreview() {
+	// always use the full sensor for live preview
+	m_settings.roi.left = 1;
+	m_settings.roi.top = 1;
+	m_settings.roi.width = m_configuration.sensorSize[0];
+	m_settings.roi.height = m_configuration.sensorSize[1];
+	m_settings.readout.triggerMode = L"Internal";
+
+	setSettings(m_settings);
+
+	BUFFER_SETTINGS bufferSettings = { 5, (int)frameSize(), pixelFormat(), m_settings.roi, BUFFER_MODE::LATEST_FRAME };
+	m_previewBuffer->initializeBuffer(bufferSettings);
+	emit(s_previewBufferSettingsChanged());
+}
+
+void SimulatedCamera::stopPreview() {
+	m_isPreviewRunning = false;
+	m_stopPreview = false;
+	emit(s_previewRunning(m_isPreviewRunning));
+}
+
+void SimulatedCamera::startAcquisition(CAMERA_SETTINGS settings) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	// check if currently a preview is running and stop it in case
+	if (m_isPreviewRunning) {
+		stopPreview();
+	}
+
+	setSettings(settings);
+
+	BUFFER_SETTINGS bufferSettings = { 4, (int)frameSize(), pixelFormat(), m_settings.roi, BUFFER_MODE::LATEST_FRAME };
+	m_previewBuffer->initializeBuffer(bufferSettings);
+	emit(s_previewBufferSettingsChanged());
+
+	m_isAcquisitionRunning = true;
+	emit(s_acquisitionRunning(m_isAcquisitionRunning));
+}
+
+void SimulatedCamera::stopAcquisition() {
+	m_isAcquisitionRunning = false;
+	emit(s_acquisitionRunning(m_isAcquisitionRunning));
+}
+
+void SimulatedCamera::acquireImage(unsigned char* buffer) {
+	/*
+	 * The rows are read out one after another. With the internal trigger the readout overlaps
+	 * the exposure of the next frame, with the software trigger the frame is exposed on request.
+	 */
+	double readoutTime = m_configuration.readoutTime * m_settings.roi.height / m_configuration.sensorSize[1];
+	auto now = Clock::now();
+	Clock::time_point frameTime;
+	if (m_settings.readout.triggerMode == L"Internal") {
+		auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+			simplemath::max<double>({ m_settings.exposureTime, readoutTime })));
+		if (m_nextFrame < now) {
+			// the frames read out in the meantime are dropped, the latest one is returned immediately
+			auto dropped = (now - m_nextFrame) / period;
+			m_cameraFrame += dropped;
+			m_nextFrame += dropped * period;
+		}
+		frameTime = m_nextFrame;
+		m_nextFrame += period;
+	} else {
+		frameTime = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_settings.exposureTime + readoutTime));
+		m_nextFrame = frameTime;
+	}
+	double timestamp = std::chrono::duration<double>(frameTime - m_start).count();
+
+	// the frame is rendered while it is exposed
+	if (buffer != nullptr) {
+		if (m_configuration.role == SIMULATED_CAMERA_ROLE::SPECTROMETER) {
+			auto frame = reinterpret_cast<unsigned short*>(buffer);
+			renderSpectrum(frame, timestamp);
+			if (m_settings.readout.pixelEncoding == L"Mono12Packed") {
+				size_t pixels = (size_t)m_settings.roi.width * m_settings.roi.height;
+				m_packed.resize(PixelPacking::packedSize(pixels));
+				PixelPacking::packMono12Packed(frame, m_packed.data(), pixels);
+				PixelPacking::unpackMono12Packed(m_packed.data(), frame, pixels);
+			}
+		} else {
+			renderHologram(buffer, timestamp);
+		}
+	}
+	std::this_thread::sleep_until(frameTime);
+
+	m_cameraFrame++;
+	m_frameID++;
+
+	FRAME_METADATA metadata;
+	metadata.cameraFrame = m_cameraFrame;
+	metadata.timestamp = timestamp;
+	addMetadata(metadata);
+}
+
+uint32_t SimulatedCamera::nextNoiseState() {
+	m_noiseState ^= m_noiseState << 13;
+	m_noiseState ^= m_noiseState >> 17;
+	m_noiseState ^= m_noiseState << 5;
+	return m_noiseState;
+}
+
+const float* SimulatedCamera::noiseRow() {
+	return m_noise.data() + (nextNoiseState() & (NOISE_TABLE_SIZE - 1));
+}
+
+int SimulatedCamera::poissonCounts(double expected) {
+	// multiplies uniform values until their product drops below exp(-expected), takes about expected + 1 steps
+	double limit = exp(-expected);
+	double product = 1;
+	int counts{ -1 };
+	do {
+		product *= (nextNoiseState() + 0.5) / 4294967296.0;
+		counts++;
+	} while (product > limit);
+	return counts;
+}
+
+void SimulatedCamera::renderSpectrum(unsigned short* frame, double time) {
+	double sensorWidth = (double)m_configuration.sensorSize[0];
+	double saturation = (m_settings.readout.pixelEncoding == L"Mono16") ? 65535 : 4095;
+
+	// dispersion along the rows, the Stokes peak of the first and the anti-Stokes peak of the second order lie between the Rayleigh lines
+	double rayleigh[2] = { RAYLEIGH_POSITION * sensorWidth, (RAYLEIGH_POSITION + FREE_SPECTRAL_RANGE) * sensorWidth };
+	double shift = (BRILLOUIN_SHIFT + SHIFT_DRIFT * sin(2 * PI * time / DRIFT_PERIOD)) * FREE_SPECTRAL_RANGE * sensorWidth;
+
+	std::vector<double> spectrum((size_t)m_settings.roi.width);
+	for (gsl::index x{ 0 }; x < m_settings.roi.width; x++) {
+		double position = (double)m_settings.roi.left - 1 + x;
+		spectrum[x] = RAYLEIGH_RATE * (lorentzian(position, rayleigh[0], RAYLEIGH_WIDTH) + lorentzian(position, rayleigh[1], RAYLEIGH_WIDTH))
+			+ BRILLOUIN_RATE * (lorentzian(position, rayleigh[0] + shift, BRILLOUIN_WIDTH) + lorentzian(position, rayleigh[1] - shift, BRILLOUIN_WIDTH));
+	}
+
+	double center = m_configuration.sensorSize[1] / 2.0;
+	for (gsl::index y{ 0 }; y < m_settings.roi.height; y++) {
+		double distance = ((double)m_settings.roi.top - 1 + y - center) / SPECTRUM_HEIGHT;
+		double profile = exp(-0.5 * distance * distance);
+		auto row = frame + y * m_settings.roi.width;
+		auto noise = noiseRow();
+		for (gsl::index x{ 0 }; x < m_settings.roi.width; x++) {
+			double counts = m_settings.exposureTime * (BACKGROUND_RATE + profile * spectrum[x]);
+			double value;
+			if (counts < POISSON_LIMIT) {
+				// the few counts of the background are drawn exactly, they are skewed and never negative
+				value = DARK_OFFSET + poissonCounts(counts) + READ_NOISE * noise[x];
+			} else {
+				// the shot noise of the expected counts is approximated by a normal distribution
+				value = DARK_OFFSET + counts + sqrt(counts + READ_NOISE * READ_NOISE) * noise[x];
+			}
+			row[x] = (unsigned short)quantize(value, saturation);
+		}
+	}
+}
+
+void SimulatedCamera::renderHologram(unsigned char* frame, double time) {
+	double level = BRIGHTFIELD_LEVEL * m_settings.exposureTime / 0.01;
+
+	// without the bead the fringes only depend on the position modulo their period
+	std::array<double, FRINGE_PERIOD> fringes;
+	std::array<double, FRINGE_PERIOD> fringeNoise;
+	for (gsl::index i{ 0 }; i < FRINGE_PERIOD; i++) {
+		fringes[i] = level * (1 + FRINGE_VISIBILITY * cos(2 * PI * i / FRINGE_PERIOD));
+		fringeNoise[i] = sqrt(fringes[i] + READ_NOISE * READ_NOISE);
+	}
+
+	double radius = m_configuration.sensorSize[0] / 8.0;
+	double beadX = m_configuration.sensorSize[0] / 2.0 + radius * cos(2 * PI * time / BEAD_PERIOD);
+	double beadY = m_configuration.sensorSize[1] / 2.0 + radius * sin(2 * PI * time / BEAD_PERIOD);
+	// [BEAD_RADIUS]	the bead is neglected beyond this distance
+	constexpr double beadExtent{ 3 };
+
+	for (gsl::index y{ 0 }; y < m_settings.roi.height; y++) {
+		double distanceY = ((double)m_settings.roi.top - 1 + y - beadY) / BEAD_RADIUS;
+		auto row = frame + y * m_settings.roi.width;
+		auto noise = noiseRow();
+		gsl::index fringe = (y + m_settings.roi.left + m_settings.roi.top) % FRINGE_PERIOD;
+		for (gsl::index x{ 0 }; x < m_settings.roi.width; x++, fringe = (fringe + 1) % FRINGE_PERIOD) {
+			double counts = fringes[fringe];
+			double deviation = fringeNoise[fringe];
+			double distanceX = ((double)m_settings.roi.left - 1 + x - beadX) / BEAD_RADIUS;
+			if (fabs(distanceX) < beadExtent && fabs(distanceY) < beadExtent) {
+				// the bead delays and absorbs the object wave
+				double bead = exp(-(distanceX * distanceX + distanceY * distanceY));
+				double phase = 2 * PI * fringe / FRINGE_PERIOD + BEAD_PHASE * bead;
+				counts = level * (1 - BEAD_ABSORPTION * bead) * (1 + FRINGE_VISIBILITY * cos(phase));
+				deviation = sqrt(counts + READ_NOISE * READ_NOISE);
+			}
+			double value = counts + deviation * noise[x];
+			row[x] = (unsigned char)quantize(value, 255);
+		}
+	}
+}
+
+void SimulatedCamera::getImageForAcquisition(unsigned char* buffer, bool preview) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	acquireImage(buffer);
+
+	if (preview && buffer != nullptr) {
+		// write image to preview buffer, the GUI only shows the latest frame
+		auto previewBuffer = m_previewBuffer->claimWrite();
+		if (previewBuffer != nullptr) {
+			memcpy(previewBuffer, buffer, frameSize());
+			writeFrameHeader();
+			m_previewBuffer->commitWrite();
+		}
+	}
+}
\ No newline at end of file
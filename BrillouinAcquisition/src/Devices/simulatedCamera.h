@@ -0,0 +1,95 @@
+#ifndef SIMULATEDCAMERA_H
+#define SIMULATEDCAMERA_H
+
+#include "Camera.h"
+
+#include <array>
+#include <chrono>
+#include <vector>
+
+enum class SIMULATED_CAMERA_ROLE {
+	SPECTROMETER,		// VIPA spectra, 16 bit
+	BRIGHTFIELD			// off-axis hologram of a moving bead, 8 bit
+};
+
+// configuration of the simulated sensor
+struct SIMULATED_CAMERA {
+	SIMULATED_CAMERA_ROLE role{ SIMULATED_CAMERA_ROLE::SPECTROMETER };
+	std::array<AT_64, 2> sensorSize{ 2048, 2048 };		// [pix]	width and height of the sensor
+	std::array<AT_64, 2> ROIMinimum{ 16, 16 };			// [pix]	minimum width and height of the ROI
+	std::array<double, 2> exposureTimeLimits{ 1e-4, 30 };	// [s]	minimum and maximum exposure time
+	double readoutTime{ 0.01 };							// [s]	readout time of the full sensor, scales with the rows of the ROI
+	std::vector<std::wstring> pixelEncodings;			//		supported encodings, the default ones of the role if empty
+};
+
+/*
+ * Camera without hardware, so the acquisition modes, the preview and the storage can be run and benchmarked anywhere.
+ *
+ * A frame becomes available after the exposure time and the readout time of its rows. With the internal trigger
+ * the camera runs freely and frames which are not fetched in time are dropped, with the software trigger
+ * the exposure starts with the request. The frame is rendered while the exposure is simulated.
+ *
+ * The spectrometer frames show two orders of a VIPA spectrum, each with the Rayleigh line and the
+ * anti-Stokes and Stokes Brillouin peaks, whose shift drifts slowly. The shot noise follows the
+ * Poisson statistics of the expected counts, which scale with the exposure time.
+ * Mono12 and Mono12Packed saturate at 12 bit, Mono12Packed frames are packed and unpacked like the real ones.
+ */
+class SimulatedCamera : public Camera {
+	Q_OBJECT
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	SIMULATED_CAMERA m_configuration;
+
+	Clock::time_point m_start;				// time the camera was connected, origin of the timestamps
+	Clock::time_point m_nextFrame;			// time the next frame is read out
+	uint64_t m_cameraFrame{ 0 };			// [1]	frames exposed by the sensor, including the dropped ones
+
+	// standard normal values the noise is drawn from, every row starts at a random position
+	std::vector<float> m_noise;
+	uint32_t m_noiseState{ 2463534242u };
+	uint32_t nextNoiseState();
+	const float* noiseRow();
+	// Poisson distributed counts, only used for small expected counts
+	int poissonCounts(double expected);
+
+	std::vector<unsigned char> m_packed;	// Mono12Packed frame
+
+	void preparePreview();
+	PIXEL_FORMAT pixelFormat();
+	size_t frameSize();
+
+	void renderSpectrum(unsigned short* frame, double time);
+	void renderHologram(unsigned char* frame, double time);
+
+	void acquireImage(unsigned char* buffer) override;
+
+	/*
+	 * Members and functions inherited from base class
+	 */
+	void readOptions();
+	void readSettings();
+
+public:
+	SimulatedCamera(SIMULATED_CAMERA configuration = SIMULATED_CAMERA{}) noexcept;
+	~SimulatedCamera();
+
+	void setCalibrationExposureTime(double exposureTime) override;
+
+public slots:
+	void init() {};
+	void connectDevice();
+	void disconnectDevice();
+
+	void setSettings(CAMERA_SETTINGS);
+
+	void startPreview();
+	void stopPreview();
+	void startAcquisition(CAMERA_SETTINGS);
+	void stopAcquisition();
+
+	void getImageForAcquisition(unsigned char* buffer, bool preview = true) override;
+};
+
+#endif //SIMULATEDCAMERA_H
\ No newline at end of file
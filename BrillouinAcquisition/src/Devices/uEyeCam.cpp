@@ -270,7 +270,7 @@ void uEyeCam::preparePreview() {
 	setSettings(m_settings);
 
 	int pixelNumber = m_settings.roi.width * m_settings.roi.height;
-	BUFFER_SETTINGS bufferSettings = { 1, pixelNumber, "unsigned char", m_settings.roi };
+	BUFFER_SETTINGS bufferSettings = { 1, pixelNumber, PIXEL_FORMAT::MONO8, m_settings.roi, BUFFER_MODE::LATEST_FRAME };
 	m_previewBuffer->initializeBuffer(bufferSettings);
 	emit(s_previewBufferSettingsChanged());
 
@@ -305,7 +305,7 @@ void uEyeCam::startAcquisition(CAMERA_SETTINGS settings) {
 	Sleep(500);
 
 	int pixelNumber = m_settings.roi.width * m_settings.roi.height;
-	BUFFER_SETTINGS bufferSettings = { 1, pixelNumber, "unsigned char", m_settings.roi };
+	BUFFER_SETTINGS bufferSettings = { 1, pixelNumber, PIXEL_FORMAT::MONO8, m_settings.roi, BUFFER_MODE::LATEST_FRAME };
 	m_previewBuffer->initializeBuffer(bufferSettings);
 	emit(s_previewBufferSettingsChanged());
 
@@ -334,6 +334,16 @@ void uEyeCam::acquireImage(unsigned char* buffer) {
 	if (m_imageBuffer != NULL && buffer != nullptr) {
 		memcpy(buffer, m_imageBuffer, m_settings.roi.width*m_settings.roi.height);
 	}
+	m_frameID++;
+
+	// the device timestamp counts in units of 100 ns
+	FRAME_METADATA metadata;
+	uEye::UEYEIMAGEINFO imageInfo;
+	if (uEye::is_GetImageInfo(m_camera, m_imageBufferId, &imageInfo, sizeof(imageInfo)) == IS_SUCCESS) {
+		metadata.timestamp = 1e-7 * imageInfo.u64TimestampDevice;
+		metadata.cameraFrame = imageInfo.u64FrameNumber;
+	}
+	addMetadata(metadata);
 }
 
 void uEyeCam::getImageForAcquisition(unsigned char* buffer, bool preview) {
@@ -341,8 +351,12 @@ void uEyeCam::getImageForAcquisition(unsigned char* buffer, bool preview) {
 	acquireImage(buffer);
 
 	if (preview && buffer != nullptr) {
-		// write image to preview buffer
-		memcpy(m_previewBuffer->m_buffer->getWriteBuffer(), buffer, m_settings.roi.width * m_settings.roi.height);
-		m_previewBuffer->m_buffer->m_usedBuffers->release();
+		// write image to preview buffer, the GUI only shows the latest frame
+		auto previewBuffer = m_previewBuffer->claimWrite();
+		if (previewBuffer != nullptr) {
+			memcpy(previewBuffer, buffer, m_settings.roi.width * m_settings.roi.height);
+			writeFrameHeader();
+			m_previewBuffer->commitWrite();
+		}
 	}
 }
\ No newline at end of file
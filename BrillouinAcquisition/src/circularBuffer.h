@@ -3,42 +3,88 @@
 
 #include <QtCore>
 #include <gsl/gsl>
+#include <atomic>
 
+#include "frameArena.h"
+
+// size of a cache line, used to keep the producer and consumer indices apart
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/*
+ * Lock-free single-producer/single-consumer ring of frame buffers.
+ *
+ * The producer (camera thread) calls claimWrite() to get the next free buffer,
+ * fills it and publishes it with commitWrite(). The consumer (GUI thread) calls
+ * claimRead() to get the oldest published buffer and hands it back with releaseRead().
+ * claimWrite() and claimRead() never block, they return nullptr if no buffer is available.
+ */
 template<class T> class CircularBuffer {
 
 public:
 	CircularBuffer() noexcept;
 	CircularBuffer(const int bufferNumber, const int bufferSize);
+	// uses the given memory for the slots, it has to hold getMemorySize() bytes and outlive the buffer
+	CircularBuffer(const int bufferNumber, const int bufferSize, unsigned char* memory);
 	~CircularBuffer();
 
-	T* getWriteBuffer();
-	T* getReadBuffer();
+	T* claimWrite();
+	void commitWrite();
+	T* claimRead();
+	void releaseRead();
+
+	// header of the buffer returned by claimWrite() and claimRead()
+	FRAME_HEADER* getWriteHeader();
+	FRAME_HEADER* getReadHeader();
 
-	QSemaphore* m_freeBuffers;
-	QSemaphore* m_usedBuffers = new QSemaphore;
+	int getBufferNumber() const;
+	int getBufferSize() const;
+
+	static size_t getMemorySize(const int bufferNumber, const int bufferSize);
 
 	T** m_buffers;
 
 private:
+	FRAME_HEADER** m_headers;
+
 	static int checkBufferNumber(int bufferNumber);
 	const int m_bufferSize;
 	const int m_bufferNumber;
-	unsigned int m_writeCount = 0;
-	unsigned int m_readCount = 0;
+	bool m_ownsMemory{ true };
+
+	// the write index is only modified by the producer, the read index only by the consumer
+	alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> m_writeIndex{ 0 };
+	// the alignment also pads the read index to a full cache line
+	alignas(CACHE_LINE_SIZE) std::atomic<unsigned int> m_readIndex{ 0 };
 };
 
 template<class T>
-inline CircularBuffer<T>::CircularBuffer() noexcept : m_bufferNumber(0), m_bufferSize(0), m_freeBuffers(new QSemaphore(0)) {
+inline CircularBuffer<T>::CircularBuffer() noexcept : m_bufferNumber(0), m_bufferSize(0) {
 	m_buffers = nullptr;
+	m_headers = nullptr;
 }
 
 template<class T>
-inline CircularBuffer<T>::CircularBuffer(const int bufferNumber, const int bufferSize) : m_bufferNumber(checkBufferNumber(bufferNumber)), m_bufferSize(bufferSize),
-	m_freeBuffers(new QSemaphore(checkBufferNumber(bufferNumber))) {
+inline CircularBuffer<T>::CircularBuffer(const int bufferNumber, const int bufferSize) : m_bufferNumber(checkBufferNumber(bufferNumber)), m_bufferSize(bufferSize) {
 
 	m_buffers = new T*[m_bufferNumber];
+	m_headers = new FRAME_HEADER*[m_bufferNumber];
 	for (gsl::index i = 0; i < m_bufferNumber; i++) {
 		m_buffers[i] = new T[m_bufferSize]{};
+		m_headers[i] = new FRAME_HEADER;
+	}
+}
+
+template<class T>
+inline CircularBuffer<T>::CircularBuffer(const int bufferNumber, const int bufferSize, unsigned char* memory) :
+	m_bufferNumber(checkBufferNumber(bufferNumber)), m_bufferSize(bufferSize), m_ownsMemory(false) {
+
+	m_buffers = new T*[m_bufferNumber];
+	m_headers = new FRAME_HEADER*[m_bufferNumber];
+	size_t slotSize = FrameArena::slotSize<T>(m_bufferSize);
+	for (gsl::index i = 0; i < m_bufferNumber; i++) {
+		// every slot starts with the frame header
+		m_headers[i] = new (memory + i * slotSize) FRAME_HEADER;
+		m_buffers[i] = reinterpret_cast<T*>(memory + i * slotSize + FRAME_HEADER_SIZE);
 	}
 }
 
@@ -50,23 +96,70 @@ inline int CircularBuffer<T>::checkBufferNumber(int bufferNumber) {
 
 template<class T>
 inline CircularBuffer<T>::~CircularBuffer() {
-	for (gsl::index i = 0; i < m_bufferNumber; i++) {
-		delete[] m_buffers[i];
+	if (m_ownsMemory) {
+		for (gsl::index i = 0; i < m_bufferNumber; i++) {
+			delete[] m_buffers[i];
+			delete m_headers[i];
+		}
 	}
 	delete[] m_buffers;
-	delete m_freeBuffers;
-	delete m_usedBuffers;
+	delete[] m_headers;
+}
+
+template<class T>
+inline T * CircularBuffer<T>::claimWrite() {
+	unsigned int writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+	// the ring is full if the producer is a whole lap ahead of the consumer
+	if (m_bufferNumber == 0 || writeIndex - m_readIndex.load(std::memory_order_acquire) >= (unsigned int)m_bufferNumber) {
+		return nullptr;
+	}
+	return m_buffers[writeIndex % m_bufferNumber];
+}
+
+template<class T>
+inline void CircularBuffer<T>::commitWrite() {
+	// publish the buffer, the release makes the written data visible to the consumer
+	m_writeIndex.store(m_writeIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template<class T>
+inline T * CircularBuffer<T>::claimRead() {
+	unsigned int readIndex = m_readIndex.load(std::memory_order_relaxed);
+	// the ring is empty if the consumer caught up with the producer
+	if (readIndex == m_writeIndex.load(std::memory_order_acquire)) {
+		return nullptr;
+	}
+	return m_buffers[readIndex % m_bufferNumber];
+}
+
+template<class T>
+inline void CircularBuffer<T>::releaseRead() {
+	// hand the buffer back, the release makes sure we are done reading before it is reused
+	m_readIndex.store(m_readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template<class T>
+inline FRAME_HEADER * CircularBuffer<T>::getWriteHeader() {
+	return m_headers[m_writeIndex.load(std::memory_order_relaxed) % m_bufferNumber];
+}
+
+template<class T>
+inline FRAME_HEADER * CircularBuffer<T>::getReadHeader() {
+	return m_headers[m_readIndex.load(std::memory_order_relaxed) % m_bufferNumber];
+}
+
+template<class T>
+inline int CircularBuffer<T>::getBufferNumber() const {
+	return m_bufferNumber;
 }
 
 template<class T>
-inline T * CircularBuffer<T>::getWriteBuffer() {
-	// return pointer to buffer and increment m_writeCount
-	return m_buffers[m_writeCount++ % m_bufferNumber];
+inline int CircularBuffer<T>::getBufferSize() const {
+	return m_bufferSize;
 }
 
 template<class T>
-inline T * CircularBuffer<T>::getReadBuffer() {
-	// return pointer to buffer and increment m_readCount
-	return m_buffers[m_readCount++ % m_bufferNumber];
+inline size_t CircularBuffer<T>::getMemorySize(const int bufferNumber, const int bufferSize) {
+	return checkBufferNumber(bufferNumber) * FrameArena::slotSize<T>(bufferSize);
 }
 #endif //CIRCULARBUFFER_H
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "stdafx.h"
+#include "compression.h"
+#include "simplemath.h"
+
+#include <zlib.h>
+
+namespace {
+	class CompressionTask : public QRunnable {
+	public:
+		CompressionTask(std::packaged_task<COMPRESSED_DATA()> task) : m_task(std::move(task)) {};
+		void run() override {
+			m_task();
+		};
+
+	private:
+		std::packaged_task<COMPRESSED_DATA()> m_task;
+	};
+
+	size_t elementCount(const std::vector<hsize_t>& dims) {
+		size_t count{ 1 };
+		for (auto dim : dims) {
+			count *= dim;
+		}
+		return count;
+	}
+
+	/*
+	 * Copies the part of the data covered by the chunk at the given offset into the chunk buffer.
+	 * Chunks reaching over the edge of the dataset keep the padding they were initialized with.
+	 */
+	void gatherChunk(const unsigned char* data, unsigned char* chunk, size_t elementSize,
+		const std::vector<hsize_t>& dims, const std::vector<hsize_t>& chunkShape, const std::vector<hsize_t>& offset) {
+
+		size_t rank = dims.size();
+		// the last dimension is contiguous and copied row by row
+		size_t rowLength = simplemath::min<hsize_t>({ chunkShape[rank - 1], dims[rank - 1] - offset[rank - 1] }) * elementSize;
+
+		// position of the row inside the chunk
+		std::vector<hsize_t> position(rank - 1, 0);
+		while (true) {
+			bool inside{ true };
+			size_t source{ 0 };
+			size_t destination{ 0 };
+			for (gsl::index i{ 0 }; i < (gsl::index)rank; i++) {
+				hsize_t index = (i < (gsl::index)rank - 1) ? position[i] : 0;
+				inside &= (offset[i] + index < dims[i]);
+				source = source * dims[i] + offset[i] + index;
+				destination = destination * chunkShape[i] + index;
+			}
+			if (inside) {
+				memcpy(&chunk[destination * elementSize], &data[source * elementSize], rowLength);
+			}
+
+			// advance to the next row
+			gsl::index dim = (gsl::index)rank - 2;
+			for (; dim >= 0; dim--) {
+				if (++position[dim] < chunkShape[dim]) {
+					break;
+				}
+				position[dim] = 0;
+			}
+			if (dim < 0) {
+				return;
+			}
+		}
+	}
+}
+
+bool ChunkCompressor::isAvailable(COMPRESSION_CODEC codec) {
+	switch (codec) {
+		case COMPRESSION_CODEC::NONE:
+			return true;
+		case COMPRESSION_CODEC::DEFLATE:
+			return H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0 && H5Zfilter_avail(H5Z_FILTER_SHUFFLE) > 0;
+		case COMPRESSION_CODEC::LZ4:
+			// the plugin is loaded from HDF5_PLUGIN_PATH if it is installed
+			return H5Zfilter_avail(H5Z_FILTER_LZ4) > 0 && H5Zfilter_avail(H5Z_FILTER_SHUFFLE) > 0;
+		default:
+			return false;
+	}
+}
+
+bool ChunkCompressor::isDirect(const COMPRESSION_SETTINGS& settings) {
+	return settings.codec == COMPRESSION_CODEC::DEFLATE;
+}
+
+std::vector<hsize_t> ChunkCompressor::getChunkShape(const COMPRESSION_SETTINGS& settings, int rank, const hsize_t* dims) {
+	std::vector<hsize_t> chunkShape(dims, dims + rank);
+	for (gsl::index i{ 0 }; i < rank; i++) {
+		if (i < (gsl::index)settings.chunkShape.size() && settings.chunkShape[i] > 0) {
+			chunkShape[i] = simplemath::min<hsize_t>({ settings.chunkShape[i], dims[i] });
+		}
+		// HDF5 does not allow empty chunks
+		if (chunkShape[i] == 0) {
+			chunkShape[i] = 1;
+		}
+	}
+	return chunkShape;
+}
+
+hid_t ChunkCompressor::createProperties(const COMPRESSION_SETTINGS& settings, int rank, const hsize_t* dims) {
+	return createProperties(settings, getChunkShape(settings, rank, dims));
+}
+
+hid_t ChunkCompressor::createProperties(const COMPRESSION_SETTINGS& settings, const std::vector<hsize_t>& chunkShape) {
+	hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(properties, (int)chunkShape.size(), chunkShape.data());
+
+	// the order of the filters has to match the chunks created by compress()
+	if (settings.shuffle) {
+		H5Pset_shuffle(properties);
+	}
+	if (settings.codec == COMPRESSION_CODEC::DEFLATE) {
+		H5Pset_deflate(properties, settings.level);
+	} else if (settings.codec == COMPRESSION_CODEC::LZ4) {
+		H5Pset_filter(properties, H5Z_FILTER_LZ4, H5Z_FLAG_OPTIONAL, 0, nullptr);
+	}
+	return properties;
+}
+
+bool ChunkCompressor::matches(const COMPRESSED_DATA& compressed, const COMPRESSION_SETTINGS& settings, const std::vector<hsize_t>& chunkShape) {
+	if (compressed.settings.codec != settings.codec || compressed.settings.shuffle != settings.shuffle
+		|| compressed.settings.level != settings.level || compressed.chunkShape.size() > chunkShape.size()) {
+		return false;
+	}
+	return std::equal(compressed.chunkShape.begin(), compressed.chunkShape.end(), chunkShape.end() - compressed.chunkShape.size());
+}
+
+hid_t ChunkCompressor::createDataset(hid_t location, const std::string& name, hid_t type, hid_t properties, int rank, const hsize_t* dims) {
+	// the groups of the repetition might not exist yet
+	hid_t linkProperties = H5Pcreate(H5P_LINK_CREATE);
+	H5Pset_create_intermediate_group(linkProperties, 1);
+	hid_t space = H5Screate_simple(rank, dims, nullptr);
+
+	hid_t dataset = H5Dcreate2(location, name.c_str(), type, space, linkProperties, properties, H5P_DEFAULT);
+
+	H5Sclose(space);
+	H5Pclose(linkProperties);
+	return dataset;
+}
+
+COMPRESSED_DATA ChunkCompressor::compress(const COMPRESSION_SETTINGS& settings, const unsigned char* data,
+	size_t elementSize, int rank, const hsize_t* dims) {
+
+	QElapsedTimer compressionTimer;
+	compressionTimer.start();
+
+	COMPRESSED_DATA compressed;
+	compressed.settings = settings;
+	if (rank < 1) {
+		return compressed;
+	}
+	compressed.dims.assign(dims, dims + rank);
+	compressed.chunkShape = getChunkShape(settings, rank, dims);
+	compressed.rawBytes = elementCount(compressed.dims) * elementSize;
+
+	size_t chunkBytes = elementCount(compressed.chunkShape) * elementSize;
+	std::vector<unsigned char> chunk(chunkBytes);
+	std::vector<unsigned char> shuffled(settings.shuffle ? chunkBytes : 0);
+
+	std::vector<hsize_t> offset(rank, 0);
+	while (true) {
+		std::fill(chunk.begin(), chunk.end(), (unsigned char)0);
+		gatherChunk(data, chunk.data(), elementSize, compressed.dims, compressed.chunkShape, offset);
+		if (settings.shuffle) {
+			shuffle(chunk.data(), shuffled.data(), chunkBytes, elementSize);
+			std::swap(chunk, shuffled);
+		}
+
+		COMPRESSED_CHUNK compressedChunk;
+		compressedChunk.offset = offset;
+		if (!deflate(settings, chunk, compressedChunk.data)) {
+			// the chunk does not get smaller, so the deflate filter is skipped for it
+			compressedChunk.data = chunk;
+			compressedChunk.filterMask = settings.shuffle ? 0x02 : 0x01;
+		}
+		compressed.compressedBytes += compressedChunk.data.size();
+		compressed.chunks.push_back(std::move(compressedChunk));
+
+		// advance to the next chunk
+		gsl::index dim = rank - 1;
+		for (; dim >= 0; dim--) {
+			offset[dim] += compressed.chunkShape[dim];
+			if (offset[dim] < compressed.dims[dim]) {
+				break;
+			}
+			offset[dim] = 0;
+		}
+		if (dim < 0) {
+			break;
+		}
+	}
+
+	compressed.duration = 1e-9 * compressionTimer.nsecsElapsed();
+	return compressed;
+}
+
+hid_t ChunkCompressor::write(hid_t location, const std::string& name, hid_t type, const COMPRESSED_DATA& compressed) {
+
+	int rank = (int)compressed.dims.size();
+	hid_t properties = createProperties(compressed.settings, rank, compressed.dims.data());
+	hid_t dataset = createDataset(location, name, type, properties, rank, compressed.dims.data());
+	H5Pclose(properties);
+	if (dataset < 0) {
+		return dataset;
+	}
+
+	if (!writeChunks(dataset, compressed)) {
+		H5Dclose(dataset);
+		H5Ldelete(location, name.c_str(), H5P_DEFAULT);
+		return -1;
+	}
+	return dataset;
+}
+
+bool ChunkCompressor::writeChunks(hid_t dataset, const COMPRESSED_DATA& compressed, const std::vector<hsize_t>& offset) {
+	std::vector<hsize_t> chunkOffset = offset;
+	// the chunks are already filtered, so HDF5 only has to write them
+	for (const auto& chunk : compressed.chunks) {
+		chunkOffset.resize(offset.size());
+		chunkOffset.insert(chunkOffset.end(), chunk.offset.begin(), chunk.offset.end());
+		herr_t status = H5Dwrite_chunk(dataset, H5P_DEFAULT, chunk.filterMask, chunkOffset.data(), chunk.data.size(), chunk.data.data());
+		if (status < 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+hid_t ChunkCompressor::write(hid_t location, const std::string& name, hid_t type, const COMPRESSION_SETTINGS& settings,
+	const void* data, int rank, const hsize_t* dims) {
+
+	hid_t properties = createProperties(settings, rank, dims);
+	hid_t dataset = createDataset(location, name, type, properties, rank, dims);
+	H5Pclose(properties);
+	if (dataset < 0) {
+		return dataset;
+	}
+
+	herr_t status = H5Dwrite(dataset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+	if (status < 0) {
+		H5Dclose(dataset);
+		H5Ldelete(location, name.c_str(), H5P_DEFAULT);
+		return -1;
+	}
+	return dataset;
+}
+
+/*
+ * Same byte transposition as the HDF5 shuffle filter:
+ * first all first bytes of the elements, then all second bytes and so on.
+ */
+void ChunkCompressor::shuffle(const unsigned char* source, unsigned char* destination, size_t bytes, size_t elementSize) {
+	size_t count = bytes / elementSize;
+	for (gsl::index j{ 0 }; j < (gsl::index)elementSize; j++) {
+		for (gsl::index i{ 0 }; i < (gsl::index)count; i++) {
+			destination[j * count + i] = source[i * elementSize + j];
+		}
+	}
+	// bytes which do not form a whole element are copied as they are
+	memcpy(&destination[count * elementSize], &source[count * elementSize], bytes - count * elementSize);
+}
+
+bool ChunkCompressor::deflate(const COMPRESSION_SETTINGS& settings, const std::vector<unsigned char>& source, std::vector<unsigned char>& destination) {
+	uLongf length = compressBound((uLong)source.size());
+	destination.resize(length);
+	int result = compress2(destination.data(), &length, source.data(), (uLong)source.size(), settings.level);
+	if (result != Z_OK || length >= source.size()) {
+		return false;
+	}
+	destination.resize(length);
+	return true;
+}
+
+CompressionPool::~CompressionPool() {
+	m_pool.waitForDone();
+}
+
+void CompressionPool::setWorkerNumber(int workerNumber) {
+	m_pool.setMaxThreadCount(workerNumber > 0 ? workerNumber : QThread::idealThreadCount());
+}
+
+std::shared_future<COMPRESSED_DATA> CompressionPool::submit(std::function<COMPRESSED_DATA()> job) {
+	std::packaged_task<COMPRESSED_DATA()> task(std::move(job));
+	std::shared_future<COMPRESSED_DATA> result = task.get_future().share();
+	// the pool deletes the task after it ran
+	m_pool.start(new CompressionTask(std::move(task)));
+	return result;
+}
+
+void CompressionPool::waitForDone() {
+	m_pool.waitForDone();
+}
\ No newline at end of file
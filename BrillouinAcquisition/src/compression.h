@@ -0,0 +1,115 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <QtCore>
+#include <gsl/gsl>
+#include <functional>
+#include <future>
+#include <vector>
+
+#include "H5Cpp.h"
+
+// filter id of the registered HDF5 LZ4 plugin
+constexpr H5Z_filter_t H5Z_FILTER_LZ4 = 32004;
+
+enum class COMPRESSION_CODEC {
+	NONE,
+	DEFLATE,
+	LZ4
+};
+
+struct COMPRESSION_SETTINGS {
+	COMPRESSION_CODEC codec{ COMPRESSION_CODEC::NONE };
+	int level{ 4 };						// [1]	deflate level from 1 (fast) to 9 (small)
+	bool shuffle{ true };				// group the bytes of the pixels before compressing, the built-in filter of HDF5 rather than bitshuffle,
+										// which needs a plugin to read the files
+	std::vector<hsize_t> chunkShape;	// [pix] chunk extent per dimension, 0 or a missing entry uses the full extent
+	int workerNumber{ 0 };				// [1]	number of compression threads, 0 uses one per core
+};
+
+struct COMPRESSION_STATISTICS {
+	unsigned long long rawBytes{ 0 };			// [byte]	payload data passed to the compression
+	unsigned long long compressedBytes{ 0 };	// [byte]	payload data after the compression
+	double compressionDuration{ 0 };			// [s]		time the workers spent compressing
+	double ratio{ 1 };							// [1]		raw size divided by compressed size
+	double throughput{ 0 };						// [MB/s]	raw data compressed per worker thread
+};
+
+struct COMPRESSED_CHUNK {
+	std::vector<hsize_t> offset;		// [pix]	position of the chunk in the dataset
+	std::vector<unsigned char> data;	// filtered chunk as HDF5 stores it
+	uint32_t filterMask{ 0 };			// filters of the pipeline which were skipped for this chunk
+};
+
+struct COMPRESSED_DATA {
+	COMPRESSION_SETTINGS settings;		// settings the chunks were created with
+	std::vector<hsize_t> dims;
+	std::vector<hsize_t> chunkShape;
+	std::vector<COMPRESSED_CHUNK> chunks;
+	size_t rawBytes{ 0 };
+	size_t compressedBytes{ 0 };
+	double duration{ 0 };				// [s]	time needed to compress the data
+};
+
+/*
+ * Compresses payload data into HDF5 chunks outside of the HDF5 library.
+ *
+ * compress() only uses zlib, so it can run on any thread. The resulting chunks are
+ * exactly what the shuffle and deflate filters would produce, so the writer thread can
+ * store them with H5Dwrite_chunk and the files stay readable by every HDF5 tool.
+ * LZ4 is only available through the HDF5 filter plugin, these datasets are written
+ * through the regular filter pipeline.
+ */
+class ChunkCompressor {
+
+public:
+	static bool isAvailable(COMPRESSION_CODEC codec);
+	// whether the chunks are compressed by compress() and written directly
+	static bool isDirect(const COMPRESSION_SETTINGS& settings);
+
+	static std::vector<hsize_t> getChunkShape(const COMPRESSION_SETTINGS& settings, int rank, const hsize_t* dims);
+	// dataset creation properties matching the chunks created by compress()
+	static hid_t createProperties(const COMPRESSION_SETTINGS& settings, int rank, const hsize_t* dims);
+	static hid_t createProperties(const COMPRESSION_SETTINGS& settings, const std::vector<hsize_t>& chunkShape);
+	// whether the compressed chunks fit into a dataset with the given settings and chunk extent of the trailing dimensions
+	static bool matches(const COMPRESSED_DATA& compressed, const COMPRESSION_SETTINGS& settings, const std::vector<hsize_t>& chunkShape);
+
+	// creates the dataset and all groups leading to it
+	static hid_t createDataset(hid_t location, const std::string& name, hid_t type, hid_t properties, int rank, const hsize_t* dims);
+
+	static COMPRESSED_DATA compress(const COMPRESSION_SETTINGS& settings, const unsigned char* data,
+		size_t elementSize, int rank, const hsize_t* dims);
+
+	// creates the dataset and stores the compressed chunks, returns the dataset which has to be closed by the caller
+	static hid_t write(hid_t location, const std::string& name, hid_t type, const COMPRESSED_DATA& compressed);
+	// stores the compressed chunks in an existing dataset, the offset is prepended to the offsets of the chunks
+	static bool writeChunks(hid_t dataset, const COMPRESSED_DATA& compressed, const std::vector<hsize_t>& offset = {});
+	// creates the dataset and lets the HDF5 filter pipeline compress the data
+	static hid_t write(hid_t location, const std::string& name, hid_t type, const COMPRESSION_SETTINGS& settings,
+		const void* data, int rank, const hsize_t* dims);
+
+private:
+	static void shuffle(const unsigned char* source, unsigned char* destination, size_t bytes, size_t elementSize);
+	static bool deflate(const COMPRESSION_SETTINGS& settings, const std::vector<unsigned char>& source, std::vector<unsigned char>& destination);
+};
+
+/*
+ * Worker pool for the compression jobs.
+ *
+ * The jobs are queued on a QThreadPool, the returned futures are waited for by the writer thread.
+ */
+class CompressionPool {
+
+public:
+	CompressionPool() noexcept {};
+	~CompressionPool();
+
+	void setWorkerNumber(int workerNumber);
+	std::shared_future<COMPRESSED_DATA> submit(std::function<COMPRESSED_DATA()> job);
+	void waitForDone();
+
+private:
+	QThreadPool m_pool;
+};
+
+#endif //COMPRESSION_H
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "stdafx.h"
+#include "frameArena.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+FrameArena::~FrameArena() {
+	release();
+}
+
+unsigned char* FrameArena::reserve(size_t size, bool largePages) {
+	// reuse the existing memory if it is large enough
+	if (m_memory != nullptr && size <= m_statistics.capacity) {
+		m_statistics.reuses++;
+		return m_memory;
+	}
+	release();
+	if (size == 0) {
+		return nullptr;
+	}
+
+	if (largePages) {
+#ifdef _WIN32
+		// large pages need the SeLockMemoryPrivilege, fall back to normal pages if it is not available
+		size_t pageSize = GetLargePageMinimum();
+		if (pageSize > 0) {
+			size_t largeSize = (size + pageSize - 1) / pageSize * pageSize;
+			m_memory = static_cast<unsigned char*>(VirtualAlloc(nullptr, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
+			if (m_memory != nullptr) {
+				size = largeSize;
+			}
+		}
+#else
+		void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory != MAP_FAILED) {
+			m_memory = static_cast<unsigned char*>(memory);
+		}
+#endif
+		m_statistics.largePages = (m_memory != nullptr);
+	}
+	if (m_memory == nullptr) {
+		size = (size + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+#ifdef _WIN32
+		m_memory = static_cast<unsigned char*>(_aligned_malloc(size, FRAME_ALIGNMENT));
+#else
+		m_memory = static_cast<unsigned char*>(aligned_alloc(FRAME_ALIGNMENT, size));
+#endif
+		if (m_memory == nullptr) {
+			throw std::bad_alloc();
+		}
+	}
+	m_statistics.capacity = size;
+	m_statistics.allocations++;
+	return m_memory;
+}
+
+ARENA_STATISTICS FrameArena::getStatistics() const {
+	return m_statistics;
+}
+
+void FrameArena::release() {
+	if (m_memory == nullptr) {
+		return;
+	}
+	if (m_statistics.largePages) {
+#ifdef _WIN32
+		VirtualFree(m_memory, 0, MEM_RELEASE);
+#else
+		munmap(m_memory, m_statistics.capacity);
+#endif
+	} else {
+#ifdef _WIN32
+		_aligned_free(m_memory);
+#else
+		free(m_memory);
+#endif
+	}
+	m_memory = nullptr;
+	m_statistics.capacity = 0;
+	m_statistics.largePages = false;
+}
\ No newline at end of file
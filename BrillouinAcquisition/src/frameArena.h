@@ -0,0 +1,54 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <QtCore>
+#include <gsl/gsl>
+
+#include "frameHeader.h"
+
+// alignment of every frame slot in the arena
+constexpr size_t FRAME_ALIGNMENT = 64;
+// space reserved for the frame header in front of every slot
+constexpr size_t FRAME_HEADER_SIZE = (sizeof(FRAME_HEADER) + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+
+struct ARENA_STATISTICS {
+	size_t capacity{ 0 };			// [byte] currently allocated memory
+	unsigned long long allocations{ 0 };	// number of times the arena had to grow
+	unsigned long long reuses{ 0 };		// number of times the existing memory was sufficient
+	bool largePages{ false };		// whether the memory is backed by large pages
+};
+
+/*
+ * Persistent memory block backing the frame slots of the preview buffers.
+ *
+ * The memory is only reallocated if a larger size is requested, otherwise it is reused.
+ * This avoids reallocating several MB every time a preview or acquisition is started.
+ */
+class FrameArena {
+
+public:
+	FrameArena() noexcept {};
+	~FrameArena();
+
+	unsigned char* reserve(size_t size, bool largePages = false);
+
+	ARENA_STATISTICS getStatistics() const;
+
+	// size of one slot of bufferSize elements including the frame header, padded to the frame alignment
+	template<class T>
+	static size_t slotSize(int bufferSize);
+
+private:
+	void release();
+
+	unsigned char* m_memory{ nullptr };
+	ARENA_STATISTICS m_statistics;
+};
+
+template<class T>
+inline size_t FrameArena::slotSize(int bufferSize) {
+	size_t size = bufferSize * sizeof(T);
+	return FRAME_HEADER_SIZE + (size + FRAME_ALIGNMENT - 1) / FRAME_ALIGNMENT * FRAME_ALIGNMENT;
+}
+
+#endif //FRAMEARENA_H
\ No newline at end of file
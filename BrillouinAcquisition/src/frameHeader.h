@@ -0,0 +1,63 @@
+#ifndef FRAMEHEADER_H
+#define FRAMEHEADER_H
+
+#include <cstdint>
+
+enum class PIXEL_FORMAT : int32_t {
+	MONO8,
+	MONO16
+};
+
+// pixel type belonging to a pixel format, used to dispatch at compile time
+template<PIXEL_FORMAT F> struct PixelTraits;
+
+template<> struct PixelTraits<PIXEL_FORMAT::MONO8> {
+	typedef unsigned char type;
+};
+
+template<> struct PixelTraits<PIXEL_FORMAT::MONO16> {
+	typedef unsigned short type;
+};
+
+/*
+ * Fixed-layout header stored with every frame slot.
+ * It describes the frame in the slot, so a consumer does not depend on the
+ * buffer settings, which might already belong to the next acquisition.
+ */
+struct FRAME_HEADER {
+	PIXEL_FORMAT pixelFormat{ PIXEL_FORMAT::MONO8 };
+	int32_t reserved{ 0 };
+	int64_t left{ 1 };				// [pix]	position of the ROI on the sensor, counting starts at 1
+	int64_t top{ 1 };				// [pix]
+	int64_t width{ 0 };				// [pix]	size of the frame
+	int64_t height{ 0 };			// [pix]
+	int64_t stride{ 0 };			// [byte]	distance between the starts of two rows
+	uint64_t frameID{ 0 };			// [1]		consecutive number of the frame
+	double timestamp{ 0 };			// [s]		time the frame was acquired
+	double exposureTime{ 0 };		// [s]		exposure time of the frame
+};
+static_assert(sizeof(FRAME_HEADER) == 72, "FRAME_HEADER must have a fixed layout");
+
+/*
+ * Metadata of a single acquired frame.
+ * The drivers fill in what their camera reports, the remaining fields are
+ * completed by the Camera base class when the frame is received.
+ */
+struct FRAME_METADATA {
+	uint64_t frameID{ 0 };			// [1]	consecutive number of the frame, counted by the driver
+	uint64_t cameraFrame{ 0 };		// [1]	frame counter of the camera, gaps indicate dropped frames
+	double timestamp{ 0 };			// [s]	sensor timestamp, its origin depends on the camera
+	double systemTime{ 0 };			// [s]	time the frame was received, since the epoch
+	double exposureTime{ 0 };		// [s]	exposure time the frame was acquired with
+};
+
+inline int64_t bytesPerPixel(PIXEL_FORMAT pixelFormat) {
+	switch (pixelFormat) {
+		case PIXEL_FORMAT::MONO16:
+			return sizeof(PixelTraits<PIXEL_FORMAT::MONO16>::type);
+		default:
+			return sizeof(PixelTraits<PIXEL_FORMAT::MONO8>::type);
+	}
+}
+
+#endif //FRAMEHEADER_H
\ No newline at end of file
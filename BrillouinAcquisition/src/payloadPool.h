@@ -0,0 +1,87 @@
+#ifndef PAYLOADPOOL_H
+#define PAYLOADPOOL_H
+
+#include <QtCore>
+#include <gsl/gsl>
+#include <mutex>
+#include <algorithm>
+
+struct POOL_STATISTICS {
+	unsigned long long hits{ 0 };	// [1]	number of buffers served from the pool
+	unsigned long long misses{ 0 };	// [1]	number of buffers which had to be allocated
+	int pooledBuffers{ 0 };			// [1]	number of buffers currently waiting in the pool
+};
+
+/*
+ * Recycles the data buffers of the storage payloads.
+ *
+ * The acquisition modes get a buffer, let the camera write into it and move it into the payload.
+ * After the payload is written to the file, the storage hands the buffer back for the next frame.
+ */
+template<class T> class PayloadPool {
+
+public:
+	PayloadPool(int maxBuffers = 32) noexcept : m_maxBuffers(maxBuffers) {};
+
+	std::vector<T> getBuffer(size_t size);
+	void returnBuffer(std::vector<T>&& buffer);
+
+	// take the buffer back from a written payload
+	void reclaim(std::vector<T>& buffer);
+
+	POOL_STATISTICS getStatistics();
+
+private:
+	std::mutex m_mutex;
+	std::vector<std::vector<T>> m_buffers;
+	const int m_maxBuffers;
+	POOL_STATISTICS m_statistics;
+};
+
+template<class T>
+inline std::vector<T> PayloadPool<T>::getBuffer(size_t size) {
+	std::vector<T> buffer;
+	{
+		std::lock_guard<std::mutex> lockGuard(m_mutex);
+		// use the first pooled buffer which is large enough
+		auto pooled = std::find_if(m_buffers.begin(), m_buffers.end(), [size](const std::vector<T>& buffer) {
+			return buffer.capacity() >= size;
+		});
+		if (pooled != m_buffers.end()) {
+			buffer = std::move(*pooled);
+			m_buffers.erase(pooled);
+			m_statistics.hits++;
+		} else {
+			m_statistics.misses++;
+		}
+		m_statistics.pooledBuffers = (int)m_buffers.size();
+	}
+	// a reused buffer of the same size is not initialized again
+	buffer.resize(size);
+	return buffer;
+}
+
+template<class T>
+inline void PayloadPool<T>::returnBuffer(std::vector<T>&& buffer) {
+	if (buffer.capacity() == 0) {
+		return;
+	}
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	if ((int)m_buffers.size() < m_maxBuffers) {
+		m_buffers.push_back(std::move(buffer));
+	}
+	m_statistics.pooledBuffers = (int)m_buffers.size();
+}
+
+template<class T>
+inline void PayloadPool<T>::reclaim(std::vector<T>& buffer) {
+	returnBuffer(std::move(buffer));
+}
+
+template<class T>
+inline POOL_STATISTICS PayloadPool<T>::getStatistics() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	return m_statistics;
+}
+
+#endif //PAYLOADPOOL_H
\ No newline at end of file
@@ -0,0 +1,341 @@
+#include "stdafx.h"
+#include "payloadSpool.h"
+#include "simplemath.h"
+
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	size_t align(size_t size, size_t alignment) {
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+	std::string indexPath(const std::string& path) {
+		return path + ".index";
+	}
+}
+
+PayloadSpool::PayloadSpool(const std::string& path, size_t segmentSize) noexcept :
+	m_path(path), m_segmentSize(align(segmentSize, SPOOL_SEGMENT_ALIGNMENT)) {
+}
+
+PayloadSpool::~PayloadSpool() {
+	close();
+}
+
+std::string PayloadSpool::spoolPath(const std::string& filePath) {
+	return filePath + ".spool";
+}
+
+bool PayloadSpool::exists(const std::string& path) {
+	return QFile::exists(QString::fromStdString(path));
+}
+
+void PayloadSpool::remove(const std::string& path) {
+	QFile::remove(QString::fromStdString(path));
+	QFile::remove(QString::fromStdString(indexPath(path)));
+}
+
+bool PayloadSpool::open() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	bool recover = exists(m_path) && exists(indexPath(m_path));
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+		recover ? OPEN_EXISTING : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	m_file = file;
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	m_fileSize = fileSize.QuadPart;
+#else
+	m_file = ::open(m_path.c_str(), recover ? O_RDWR : (O_RDWR | O_CREAT | O_TRUNC), 0644);
+	if (m_file < 0) {
+		return false;
+	}
+	struct stat fileStatus;
+	fstat(m_file, &fileStatus);
+	m_fileSize = fileStatus.st_size;
+#endif
+	// the file only ever grows by whole segments
+	m_fileSize = m_fileSize / SPOOL_SEGMENT_ALIGNMENT * SPOOL_SEGMENT_ALIGNMENT;
+
+	m_index = fopen(indexPath(m_path).c_str(), recover ? "r+b" : "w+b");
+	if (m_index == nullptr) {
+		return false;
+	}
+	if (!recover || m_fileSize == 0) {
+		return true;
+	}
+
+	// map the existing records as one segment, new records go into new segments behind it
+	SEGMENT segment;
+	segment.offset = 0;
+	segment.size = m_fileSize;
+	segment.used = m_fileSize;
+	if (!mapSegment(segment)) {
+		return false;
+	}
+
+	SPOOL_INDEX_ENTRY entry;
+	while (fread(&entry, sizeof(entry), 1, m_index) == 1) {
+		// only entries of completely written records are valid
+		const SPOOL_RECORD* record = (entry.offset + sizeof(SPOOL_RECORD) <= m_fileSize)
+			? reinterpret_cast<const SPOOL_RECORD*>(segment.memory + entry.offset) : nullptr;
+		bool valid = record != nullptr && record->magic == SPOOL_MAGIC && record->committed == 1
+			&& record->sequence == entry.sequence && entry.offset + sizeof(SPOOL_RECORD) + record->dataBytes <= m_fileSize;
+		if (!valid) {
+			entry.state = SPOOL_STATE::CONVERTED;
+		}
+		m_entries.push_back(entry);
+		m_sequence = entry.sequence + 1;
+		segment.records++;
+		if (entry.state == SPOOL_STATE::CONVERTED) {
+			segment.converted++;
+		} else {
+			m_statistics.pendingRecords++;
+		}
+	}
+	m_segments.push_back(segment);
+	m_statistics.segments = (int)m_segments.size();
+	// invalid entries are marked, so they are skipped by the next recovery as well
+	for (gsl::index i{ 0 }; i < (gsl::index)m_entries.size(); i++) {
+		writeIndex(i);
+	}
+	return true;
+}
+
+void PayloadSpool::close() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	for (auto& segment : m_segments) {
+		unmapSegment(segment);
+	}
+	m_segments.clear();
+	m_statistics.segments = 0;
+
+	if (m_index != nullptr) {
+		fclose(m_index);
+		m_index = nullptr;
+	}
+#ifdef _WIN32
+	if (m_file == nullptr) {
+		return;
+	}
+	CloseHandle(m_file);
+	m_file = nullptr;
+#else
+	if (m_file < 0) {
+		return;
+	}
+	::close(m_file);
+	m_file = -1;
+#endif
+
+	// the spool is only kept if it still holds data which is not in the HDF5 file
+	bool converted = std::all_of(m_entries.begin(), m_entries.end(), [](const SPOOL_INDEX_ENTRY& entry) {
+		return entry.state == SPOOL_STATE::CONVERTED;
+	});
+	if (converted) {
+		remove(m_path);
+	}
+}
+
+bool PayloadSpool::append(SPOOL_RECORD header, const void* data) {
+	QElapsedTimer appendTimer;
+	appendTimer.start();
+
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	size_t recordSize = align(sizeof(SPOOL_RECORD) + header.dataBytes, SPOOL_PAGE_SIZE);
+
+	// start a new segment if the record does not fit into the current one
+	if (m_segments.empty() || m_segments.back().used + recordSize > m_segments.back().size) {
+		if (!m_segments.empty()) {
+			// the finished segment is written back in the background
+#ifdef _WIN32
+			FlushViewOfFile(m_segments.back().memory, 0);
+#else
+			msync(m_segments.back().memory, m_segments.back().size, MS_ASYNC);
+#endif
+		}
+		SEGMENT segment;
+		segment.offset = m_fileSize;
+		segment.size = simplemath::max<size_t>({ m_segmentSize, align(recordSize, SPOOL_SEGMENT_ALIGNMENT) });
+		if (!mapSegment(segment)) {
+			return false;
+		}
+		m_fileSize += segment.size;
+		m_segments.push_back(segment);
+		m_statistics.segments = (int)m_segments.size();
+	}
+	SEGMENT& segment = m_segments.back();
+
+	SPOOL_INDEX_ENTRY entry;
+	entry.offset = segment.offset + segment.used;
+	entry.sequence = m_sequence++;
+
+	header.magic = SPOOL_MAGIC;
+	header.sequence = entry.sequence;
+	header.committed = 0;
+	unsigned char* record = segment.memory + segment.used;
+	memcpy(record, &header, sizeof(SPOOL_RECORD));
+	memcpy(record + sizeof(SPOOL_RECORD), data, header.dataBytes);
+	// the record only counts as written once the data is in place
+	std::atomic_thread_fence(std::memory_order_release);
+	reinterpret_cast<SPOOL_RECORD*>(record)->committed = 1;
+
+	segment.used += recordSize;
+	segment.records++;
+	m_entries.push_back(entry);
+	writeIndex(m_entries.size() - 1);
+
+	m_statistics.appendedRecords++;
+	m_statistics.appendedBytes += header.dataBytes;
+	m_statistics.appendDuration += 1e-9 * appendTimer.nsecsElapsed();
+	m_statistics.pendingRecords++;
+	return true;
+}
+
+const unsigned char* PayloadSpool::next(SPOOL_RECORD& header) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	while (m_nextEntry < (gsl::index)m_entries.size() && m_entries[m_nextEntry].state == SPOOL_STATE::CONVERTED) {
+		m_nextEntry++;
+	}
+	if (m_nextEntry >= (gsl::index)m_entries.size()) {
+		return nullptr;
+	}
+	const SPOOL_INDEX_ENTRY& entry = m_entries[m_nextEntry++];
+	SEGMENT* segment = findSegment(entry.offset);
+	if (segment == nullptr) {
+		return nullptr;
+	}
+	// the segment stays mapped until all its records are converted
+	const unsigned char* record = segment->memory + (entry.offset - segment->offset);
+	memcpy(&header, record, sizeof(SPOOL_RECORD));
+	return record + sizeof(SPOOL_RECORD);
+}
+
+void PayloadSpool::markConverted(uint64_t sequence) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	if (m_entries.empty() || sequence < m_entries.front().sequence) {
+		return;
+	}
+	// the sequence numbers of the entries are consecutive
+	gsl::index index = sequence - m_entries.front().sequence;
+	if (index >= (gsl::index)m_entries.size() || m_entries[index].state == SPOOL_STATE::CONVERTED) {
+		return;
+	}
+	m_entries[index].state = SPOOL_STATE::CONVERTED;
+	writeIndex(index);
+
+	SEGMENT* segment = findSegment(m_entries[index].offset);
+	if (segment != nullptr) {
+		segment->converted++;
+	}
+	m_statistics.convertedRecords++;
+	m_statistics.pendingRecords--;
+	releaseConvertedSegments();
+}
+
+bool PayloadSpool::hasPending() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	for (gsl::index i{ m_nextEntry }; i < (gsl::index)m_entries.size(); i++) {
+		if (m_entries[i].state != SPOOL_STATE::CONVERTED) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PayloadSpool::isConverted() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	return m_statistics.pendingRecords == 0;
+}
+
+SPOOL_STATISTICS PayloadSpool::getStatistics() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	SPOOL_STATISTICS statistics = m_statistics;
+	if (statistics.appendDuration > 0) {
+		statistics.throughput = 1e-6 * statistics.appendedBytes / statistics.appendDuration;
+	}
+	return statistics;
+}
+
+bool PayloadSpool::mapSegment(SEGMENT& segment) {
+	uint64_t end = segment.offset + segment.size;
+#ifdef _WIN32
+	// the mapping grows the file to the end of the segment
+	HANDLE mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, (DWORD)(end >> 32), (DWORD)end, nullptr);
+	if (mapping == nullptr) {
+		return false;
+	}
+	void* memory = MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)(segment.offset >> 32), (DWORD)segment.offset, segment.size);
+	if (memory == nullptr) {
+		CloseHandle(mapping);
+		return false;
+	}
+	segment.mapping = mapping;
+#else
+	if (end > m_fileSize && ftruncate(m_file, end) != 0) {
+		return false;
+	}
+	void* memory = mmap(nullptr, segment.size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, segment.offset);
+	if (memory == MAP_FAILED) {
+		return false;
+	}
+#endif
+	segment.memory = static_cast<unsigned char*>(memory);
+	return true;
+}
+
+void PayloadSpool::unmapSegment(SEGMENT& segment) {
+	if (segment.memory == nullptr) {
+		return;
+	}
+#ifdef _WIN32
+	FlushViewOfFile(segment.memory, 0);
+	UnmapViewOfFile(segment.memory);
+	CloseHandle(segment.mapping);
+	segment.mapping = nullptr;
+#else
+	msync(segment.memory, segment.size, MS_SYNC);
+	munmap(segment.memory, segment.size);
+#endif
+	segment.memory = nullptr;
+}
+
+PayloadSpool::SEGMENT* PayloadSpool::findSegment(uint64_t offset) {
+	for (auto& segment : m_segments) {
+		if (offset >= segment.offset && offset < segment.offset + segment.size) {
+			return &segment;
+		}
+	}
+	return nullptr;
+}
+
+void PayloadSpool::writeIndex(gsl::index index) {
+	fseek(m_index, (long)(index * sizeof(SPOOL_INDEX_ENTRY)), SEEK_SET);
+	fwrite(&m_entries[index], sizeof(SPOOL_INDEX_ENTRY), 1, m_index);
+	fflush(m_index);
+}
+
+void PayloadSpool::releaseConvertedSegments() {
+	// the last segment still receives records
+	for (gsl::index i{ (gsl::index)m_segments.size() - 2 }; i >= 0; i--) {
+		SEGMENT& segment = m_segments[i];
+		if (segment.records > 0 && segment.converted == segment.records) {
+			unmapSegment(segment);
+			m_segments.erase(m_segments.begin() + i);
+		}
+	}
+	m_statistics.segments = (int)m_segments.size();
+}
\ No newline at end of file
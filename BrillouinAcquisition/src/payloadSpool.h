@@ -0,0 +1,136 @@
+#ifndef PAYLOADSPOOL_H
+#define PAYLOADSPOOL_H
+
+#include <QtCore>
+#include <gsl/gsl>
+#include <mutex>
+#include <deque>
+#include <cstdio>
+
+// marks the start of every record in the spool file
+constexpr uint32_t SPOOL_MAGIC = 0x4C505342;	// "BSPL"
+// alignment of the records in the spool file
+constexpr size_t SPOOL_PAGE_SIZE = 4096;
+// alignment of the segments, the Windows allocation granularity
+constexpr size_t SPOOL_SEGMENT_ALIGNMENT = 65536;
+
+enum class SPOOL_PAYLOAD : uint32_t {
+	IMAGE,
+	ODTIMAGE,
+	FLUOIMAGE,
+	CALIBRATION
+};
+
+enum class SPOOL_STATE : uint32_t {
+	WRITTEN,
+	CONVERTED
+};
+
+/*
+ * Header in front of every payload in the spool file.
+ * It holds everything needed to reconstruct the payload.
+ */
+struct SPOOL_RECORD {
+	uint32_t magic{ SPOOL_MAGIC };
+	SPOOL_PAYLOAD type{ SPOOL_PAYLOAD::IMAGE };
+	uint64_t sequence{ 0 };		// [1]		number of the record in the spool
+	uint64_t dataBytes{ 0 };	// [byte]	size of the data following the header
+	int32_t indices[3]{};		// [1]		indX, indY, indZ of images, the index of all other payloads
+	int32_t rank{ 0 };			// [1]		rank of the data
+	uint64_t dims[4]{};			// [pix]	dimensions of the data
+	double shift{ 0 };			// [GHz]	shift of the calibration sample
+	char date[32]{};			// date of the acquisition
+	char text[64]{};			// channel name of fluorescence images, sample name of calibrations
+	uint32_t committed{ 0 };	// set after the data is completely written
+	uint32_t reserved{ 0 };
+};
+
+// entry of the index file, one per record
+struct SPOOL_INDEX_ENTRY {
+	uint64_t offset{ 0 };		// [byte]	position of the record in the spool file
+	uint64_t sequence{ 0 };		// [1]		number of the record
+	SPOOL_STATE state{ SPOOL_STATE::WRITTEN };
+	uint32_t reserved{ 0 };
+};
+
+struct SPOOL_STATISTICS {
+	unsigned long long appendedRecords{ 0 };	// [1]		records written to the spool
+	unsigned long long appendedBytes{ 0 };		// [byte]	data written to the spool
+	double appendDuration{ 0 };					// [s]		time spent writing to the spool
+	double throughput{ 0 };						// [MB/s]	write throughput of the spool
+	unsigned long long convertedRecords{ 0 };	// [1]		records converted to the HDF5 file
+	int pendingRecords{ 0 };					// [1]		records waiting for the conversion
+	int segments{ 0 };							// [1]		currently mapped segments
+};
+
+/*
+ * Crash-safe raw spool for the acquired payloads.
+ *
+ * The payloads are appended to a memory-mapped file in page-aligned records, so writing them
+ * only costs a copy at disk bandwidth. The file grows in preallocated segments. Every record
+ * gets an entry in a small index file, which is marked once the record is converted to HDF5.
+ * If the acquisition is interrupted, the spool and index stay on disk and can be recovered.
+ */
+class PayloadSpool {
+
+public:
+	PayloadSpool(const std::string& path, size_t segmentSize = (size_t)256 << 20) noexcept;
+	~PayloadSpool();
+
+	// path of the spool belonging to the given HDF5 file
+	static std::string spoolPath(const std::string& filePath);
+	static bool exists(const std::string& path);
+	static void remove(const std::string& path);
+
+	// creates a new spool or opens an existing one to recover the records which were not converted
+	bool open();
+	// removes the files if all records were converted
+	void close();
+
+	// appends the record and its data, the sequence of the header is set by the spool
+	bool append(SPOOL_RECORD header, const void* data);
+	// copies the header and returns the data of the next record which was not handed out yet, nullptr if there is none
+	const unsigned char* next(SPOOL_RECORD& header);
+	void markConverted(uint64_t sequence);
+
+	bool hasPending();
+	bool isConverted();
+	SPOOL_STATISTICS getStatistics();
+
+private:
+	struct SEGMENT {
+		uint64_t offset{ 0 };			// [byte]	position of the segment in the spool file
+		size_t size{ 0 };				// [byte]	size of the segment
+		size_t used{ 0 };				// [byte]	space filled with records
+		unsigned char* memory{ nullptr };
+		void* mapping{ nullptr };		// mapping object of the segment on Windows
+		int records{ 0 };				// [1]	records stored in the segment
+		int converted{ 0 };				// [1]	records of the segment converted to HDF5
+	};
+
+	bool mapSegment(SEGMENT& segment);
+	void unmapSegment(SEGMENT& segment);
+	SEGMENT* findSegment(uint64_t offset);
+	void writeIndex(gsl::index index);
+	void releaseConvertedSegments();
+
+	std::string m_path;
+	size_t m_segmentSize;
+	std::mutex m_mutex;
+
+#ifdef _WIN32
+	void* m_file{ nullptr };
+#else
+	int m_file{ -1 };
+#endif
+	FILE* m_index{ nullptr };
+	uint64_t m_fileSize{ 0 };
+
+	std::deque<SEGMENT> m_segments;
+	std::vector<SPOOL_INDEX_ENTRY> m_entries;
+	gsl::index m_nextEntry{ 0 };		// next entry handed out for the conversion
+	uint64_t m_sequence{ 0 };
+	SPOOL_STATISTICS m_statistics;
+};
+
+#endif //PAYLOADSPOOL_H
\ No newline at end of file
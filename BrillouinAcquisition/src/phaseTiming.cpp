@@ -0,0 +1,74 @@
+#include "stdafx.h"
+#include "phaseTiming.h"
+#include "simplemath.h"
+
+PhaseTimer::PhaseTimer(int window) : m_window(simplemath::max<int>({ window, 1 })) {
+	reset();
+}
+
+void PhaseTimer::reset() {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	for (auto& ring : m_rings) {
+		ring = RING{};
+		ring.durations.reserve(m_window);
+	}
+}
+
+void PhaseTimer::add(ACQUISITION_PHASE phase, double duration) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	RING& ring = m_rings[(int)phase];
+	if ((int)ring.durations.size() < m_window) {
+		ring.durations.push_back(duration);
+	} else {
+		ring.sum -= ring.durations[ring.next];
+		ring.durations[ring.next] = duration;
+	}
+	ring.next = (ring.next + 1) % m_window;
+	ring.sum += duration;
+	ring.total += duration;
+	ring.count++;
+}
+
+double PhaseTimer::mean(ACQUISITION_PHASE phase, double fallback) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	const RING& ring = m_rings[(int)phase];
+	if (ring.durations.empty()) {
+		return fallback;
+	}
+	return ring.sum / ring.durations.size();
+}
+
+double PhaseTimer::total(ACQUISITION_PHASE phase) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	return m_rings[(int)phase].total;
+}
+
+int PhaseTimer::count(ACQUISITION_PHASE phase) {
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	return m_rings[(int)phase].count;
+}
+
+PHASE_TIMING PhaseTimer::getTiming() {
+	PHASE_TIMING timing;
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	for (gsl::index i{ 0 }; i < (gsl::index)m_rings.size(); i++) {
+		const RING& ring = m_rings[i];
+		PHASE_STATISTICS& statistics = timing.phases[i];
+		statistics.count = ring.count;
+		statistics.total = ring.total;
+		if (ring.durations.empty()) {
+			continue;
+		}
+		std::vector<double> sorted = ring.durations;
+		std::sort(sorted.begin(), sorted.end());
+		statistics.mean = ring.sum / sorted.size();
+		statistics.median = sorted[sorted.size() / 2];
+		statistics.p99 = sorted[simplemath::min<size_t>({ sorted.size() - 1, (size_t)(0.99 * sorted.size()) })];
+		statistics.max = sorted.back();
+		for (double duration : sorted) {
+			int bin = (duration > 1e-6) ? (int)floor(log2(1e6 * duration)) : 0;
+			statistics.histogram[simplemath::min<int>({ bin, PHASE_HISTOGRAM_BINS - 1 })]++;
+		}
+	}
+	return timing;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#ifndef PHASETIMING_H
+#define PHASETIMING_H
+
+#include <QtCore>
+#include <gsl/gsl>
+#include <array>
+#include <mutex>
+
+enum class ACQUISITION_PHASE {
+	MOVE,			// moving the stage or the galvo mirrors
+	SETTLE,			// waiting for the stage, the optical elements or the camera settings to settle
+	EXPOSURE,		// exposing and reading out the camera
+	PACKAGING,		// timestamping and creating the payloads
+	ENQUEUE,		// handing the payloads to the storage
+	CALIBRATION,	// acquiring a calibration, including its presets
+	PRESET,			// moving the optical elements to a preset
+	COUNT
+};
+
+constexpr int PHASE_HISTOGRAM_BINS{ 24 };
+
+struct PHASE_STATISTICS {
+	int count{ 0 };			// [1]	occurrences since the reset
+	double total{ 0 };		// [s]	duration of all occurrences since the reset
+	double mean{ 0 };		// [s]	duration of the recent occurrences
+	double median{ 0 };		// [s]
+	double p99{ 0 };		// [s]
+	double max{ 0 };		// [s]
+	// [1]	recent occurrences per duration, bin i holds the durations from 2^i to 2^(i+1) us
+	std::array<int, PHASE_HISTOGRAM_BINS> histogram{};
+};
+
+struct PHASE_TIMING {
+	std::array<PHASE_STATISTICS, (int)ACQUISITION_PHASE::COUNT> phases;
+
+	static std::vector<std::string> names() {
+		return { "move", "settle", "exposure", "packaging", "enqueue", "calibration", "preset" };
+	};
+};
+
+/*
+ * Durations of the phases of an acquisition.
+ *
+ * The recent durations of every phase are kept in a ring, so the statistics follow
+ * changes during long acquisitions. The phases may be measured from several threads.
+ */
+class PhaseTimer {
+
+public:
+	// window: [1] number of recent durations kept per phase
+	PhaseTimer(int window = 1024);
+
+	void reset();
+	// duration: [s]
+	void add(ACQUISITION_PHASE phase, double duration);
+	// [s] mean duration of the recent occurrences, fallback if the phase did not occur yet
+	double mean(ACQUISITION_PHASE phase, double fallback = 0);
+	// [s] duration of all occurrences since the reset
+	double total(ACQUISITION_PHASE phase);
+	int count(ACQUISITION_PHASE phase);
+	PHASE_TIMING getTiming();
+
+	// measures the phase until it goes out of scope
+	class Scope {
+	public:
+		Scope(PhaseTimer& phaseTimer, ACQUISITION_PHASE phase) : m_phaseTimer(phaseTimer), m_phase(phase) {
+			m_timer.start();
+		};
+		~Scope() {
+			m_phaseTimer.add(m_phase, 1e-9 * m_timer.nsecsElapsed());
+		};
+
+	private:
+		PhaseTimer& m_phaseTimer;
+		ACQUISITION_PHASE m_phase;
+		QElapsedTimer m_timer;
+	};
+
+private:
+	struct RING {
+		std::vector<double> durations;	// [s]	recent durations
+		gsl::index next{ 0 };			// [1]	position of the next duration
+		int count{ 0 };					// [1]	occurrences since the reset
+		double total{ 0 };				// [s]	duration of all occurrences since the reset
+		double sum{ 0 };				// [s]	duration of the recent occurrences
+	};
+
+	std::mutex m_mutex;
+	int m_window;
+	std::array<RING, (int)ACQUISITION_PHASE::COUNT> m_rings;
+};
+
+#endif //PHASETIMING_H
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef PIPELINESTAGE_H
+#define PIPELINESTAGE_H
+
+#include <QtCore>
+
+/*
+ * One stage of an acquisition pipeline.
+ *
+ * The submitted jobs run one after another on a thread of their own, so their order is kept.
+ * At most depth jobs are in flight, submit() blocks until the stage has a free slot.
+ * This bounds the memory held by the jobs if the stage is slower than the acquisition.
+ */
+class PipelineStage {
+
+public:
+	PipelineStage(int depth = 2) : m_freeSlots(depth) {
+		m_pool.setMaxThreadCount(1);
+	};
+	~PipelineStage() {
+		waitForDone();
+	};
+
+	template<typename F>
+	void submit(F&& job) {
+		if (!m_freeSlots.tryAcquire()) {
+			QElapsedTimer stallTimer;
+			stallTimer.start();
+			m_freeSlots.acquire();
+			m_stallDuration += 1e-9 * stallTimer.nsecsElapsed();
+		}
+		// the pool deletes the job after it ran
+		m_pool.start(new PipelineJob<std::decay_t<F>>(std::forward<F>(job), &m_freeSlots));
+	};
+
+	void waitForDone() {
+		m_pool.waitForDone();
+	};
+
+	// [s] time submit() waited for a free slot
+	double getStallDuration() const {
+		return m_stallDuration;
+	};
+
+private:
+	template<typename F>
+	class PipelineJob : public QRunnable {
+	public:
+		PipelineJob(F job, QSemaphore* freeSlots) : m_job(std::move(job)), m_freeSlots(freeSlots) {};
+		void run() override {
+			m_job();
+			m_freeSlots->release();
+		};
+
+	private:
+		F m_job;
+		QSemaphore* m_freeSlots;
+	};
+
+	QThreadPool m_pool;
+	QSemaphore m_freeSlots;
+	double m_stallDuration{ 0 };
+};
+
+#endif //PIPELINESTAGE_H
\ No newline at end of file
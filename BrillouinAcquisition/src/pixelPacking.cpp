@@ -0,0 +1,307 @@
+#include "stdafx.h"
+#include "pixelPacking.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define PIXELPACKING_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles the intrinsics of all instruction sets, GCC and Clang only for the functions marked
+#ifdef _MSC_VER
+#define PIXELPACKING_TARGET(features)
+#else
+#define PIXELPACKING_TARGET(features) __attribute__((target(features)))
+#endif
+
+namespace {
+	constexpr unsigned short MONO12_MAX{ 0x0FFF };
+
+	void unpackMono12PackedScalar(const unsigned char* source, unsigned short* destination, size_t pixels) {
+		size_t i{ 0 };
+		for (; i + 1 < pixels; i += 2) {
+			const unsigned char* packed = source + i / 2 * 3;
+			destination[i] = (packed[0] << 4) | (packed[1] & 0x0F);
+			destination[i + 1] = (packed[2] << 4) | (packed[1] >> 4);
+		}
+		// an odd pixel only occupies two bytes
+		if (i < pixels) {
+			const unsigned char* packed = source + i / 2 * 3;
+			destination[i] = (packed[0] << 4) | (packed[1] & 0x0F);
+		}
+	}
+
+	void packMono12PackedScalar(const unsigned short* source, unsigned char* destination, size_t pixels) {
+		size_t i{ 0 };
+		for (; i + 1 < pixels; i += 2) {
+			unsigned short first = (source[i] < MONO12_MAX) ? source[i] : MONO12_MAX;
+			unsigned short second = (source[i + 1] < MONO12_MAX) ? source[i + 1] : MONO12_MAX;
+			unsigned char* packed = destination + i / 2 * 3;
+			packed[0] = (unsigned char)(first >> 4);
+			packed[1] = (unsigned char)((first & 0x0F) | ((second & 0x0F) << 4));
+			packed[2] = (unsigned char)(second >> 4);
+		}
+		if (i < pixels) {
+			unsigned short first = (source[i] < MONO12_MAX) ? source[i] : MONO12_MAX;
+			unsigned char* packed = destination + i / 2 * 3;
+			packed[0] = (unsigned char)(first >> 4);
+			packed[1] = (unsigned char)(first & 0x0F);
+		}
+	}
+
+	void unpackMono12Scalar(const unsigned short* source, unsigned short* destination, size_t pixels) {
+		for (size_t i{ 0 }; i < pixels; i++) {
+			destination[i] = source[i] & MONO12_MAX;
+		}
+	}
+
+	void packMono12Scalar(const unsigned short* source, unsigned short* destination, size_t pixels) {
+		for (size_t i{ 0 }; i < pixels; i++) {
+			destination[i] = (source[i] < MONO12_MAX) ? source[i] : MONO12_MAX;
+		}
+	}
+
+#ifdef PIXELPACKING_X86
+	/*
+	 * The vector kernels convert groups of eight pixels, which are twelve packed bytes.
+	 * The shuffle moves the bytes of every pixel into a 16 bit lane, the byte holding
+	 * the lower bits into the lower half:
+	 *   first pixel:  (low nibbles, upper bits) -> upper bits << 4 | low nibble of the first
+	 *   second pixel: (low nibbles, upper bits) -> shifted right by 4
+	 * Loads and stores are 16 bytes wide, so they need four bytes behind the group.
+	 */
+	PIXELPACKING_TARGET("ssse3,sse4.1")
+	void unpackMono12PackedSSE4(const unsigned char* source, unsigned short* destination, size_t pixels) {
+		const __m128i shuffle = _mm_setr_epi8(1, 0, 1, 2, 4, 3, 4, 5, 7, 6, 7, 8, 10, 9, 10, 11);
+		const __m128i upperMask = _mm_setr_epi16(0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF);
+		const __m128i lowerMask = _mm_setr_epi16(0x000F, 0, 0x000F, 0, 0x000F, 0, 0x000F, 0);
+		size_t packedBytes = PixelPacking::packedSize(pixels);
+		size_t i{ 0 };
+		for (; i + 8 <= pixels && i / 2 * 3 + 16 <= packedBytes; i += 8) {
+			__m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i / 2 * 3));
+			__m128i words = _mm_shuffle_epi8(packed, shuffle);
+			__m128i unpacked = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(words, 4), upperMask), _mm_and_si128(words, lowerMask));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), unpacked);
+		}
+		unpackMono12PackedScalar(source + i / 2 * 3, destination + i, pixels - i);
+	}
+
+	/*
+	 * Every 32 bit lane holds two pixels, it is arranged as
+	 * (upper bits of the first, low nibbles, upper bits of the second, unused)
+	 * and the unused bytes are removed by the shuffle.
+	 */
+	PIXELPACKING_TARGET("ssse3,sse4.1")
+	__m128i packLanesSSE4(__m128i pixels) {
+		pixels = _mm_min_epu16(pixels, _mm_set1_epi16(MONO12_MAX));
+		__m128i upper = _mm_srli_epi16(pixels, 4);
+		__m128i nibbles = _mm_and_si128(pixels, _mm_set1_epi16(0x000F));
+		__m128i lower = _mm_and_si128(_mm_or_si128(nibbles, _mm_srli_epi32(nibbles, 12)), _mm_set1_epi32(0xFF));
+		__m128i lanes = _mm_or_si128(upper, _mm_slli_epi32(lower, 8));
+		return _mm_shuffle_epi8(lanes, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+	}
+
+	PIXELPACKING_TARGET("ssse3,sse4.1")
+	void packMono12PackedSSE4(const unsigned short* source, unsigned char* destination, size_t pixels) {
+		size_t packedBytes = PixelPacking::packedSize(pixels);
+		size_t i{ 0 };
+		for (; i + 8 <= pixels && i / 2 * 3 + 16 <= packedBytes; i += 8) {
+			__m128i unpacked = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i / 2 * 3), packLanesSSE4(unpacked));
+		}
+		packMono12PackedScalar(source + i, destination + i / 2 * 3, pixels - i);
+	}
+
+	PIXELPACKING_TARGET("ssse3,sse4.1")
+	void unpackMono12SSE4(const unsigned short* source, unsigned short* destination, size_t pixels) {
+		const __m128i mask = _mm_set1_epi16(MONO12_MAX);
+		size_t i{ 0 };
+		for (; i + 8 <= pixels; i += 8) {
+			__m128i unpacked = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_and_si128(unpacked, mask));
+		}
+		unpackMono12Scalar(source + i, destination + i, pixels - i);
+	}
+
+	PIXELPACKING_TARGET("ssse3,sse4.1")
+	void packMono12SSE4(const unsigned short* source, unsigned short* destination, size_t pixels) {
+		const __m128i maximum = _mm_set1_epi16(MONO12_MAX);
+		size_t i{ 0 };
+		for (; i + 8 <= pixels; i += 8) {
+			__m128i unpacked = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_min_epu16(unpacked, maximum));
+		}
+		packMono12Scalar(source + i, destination + i, pixels - i);
+	}
+
+	/*
+	 * The AVX2 shuffles only work within 128 bit lanes,
+	 * so every lane converts a group of eight pixels like the SSE4 kernels.
+	 */
+	PIXELPACKING_TARGET("avx2")
+	void unpackMono12PackedAVX2(const unsigned char* source, unsigned short* destination, size_t pixels) {
+		const __m256i shuffle = _mm256_setr_epi8(1, 0, 1, 2, 4, 3, 4, 5, 7, 6, 7, 8, 10, 9, 10, 11,
+			1, 0, 1, 2, 4, 3, 4, 5, 7, 6, 7, 8, 10, 9, 10, 11);
+		const __m256i upperMask = _mm256_setr_epi16(0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF,
+			0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF, 0x0FF0, 0x0FFF);
+		const __m256i lowerMask = _mm256_setr_epi16(0x000F, 0, 0x000F, 0, 0x000F, 0, 0x000F, 0,
+			0x000F, 0, 0x000F, 0, 0x000F, 0, 0x000F, 0);
+		size_t packedBytes = PixelPacking::packedSize(pixels);
+		size_t i{ 0 };
+		for (; i + 16 <= pixels && i / 2 * 3 + 28 <= packedBytes; i += 16) {
+			const unsigned char* packed = source + i / 2 * 3;
+			__m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed));
+			__m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + 12));
+			__m256i words = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(first), second, 1), shuffle);
+			__m256i unpacked = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(words, 4), upperMask), _mm256_and_si256(words, lowerMask));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), unpacked);
+		}
+		unpackMono12PackedSSE4(source + i / 2 * 3, destination + i, pixels - i);
+	}
+
+	PIXELPACKING_TARGET("avx2")
+	void packMono12PackedAVX2(const unsigned short* source, unsigned char* destination, size_t pixels) {
+		const __m256i compact = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+			0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+		size_t packedBytes = PixelPacking::packedSize(pixels);
+		size_t i{ 0 };
+		for (; i + 16 <= pixels && i / 2 * 3 + 28 <= packedBytes; i += 16) {
+			__m256i unpacked = _mm256_min_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i)), _mm256_set1_epi16(MONO12_MAX));
+			__m256i upper = _mm256_srli_epi16(unpacked, 4);
+			__m256i nibbles = _mm256_and_si256(unpacked, _mm256_set1_epi16(0x000F));
+			__m256i lower = _mm256_and_si256(_mm256_or_si256(nibbles, _mm256_srli_epi32(nibbles, 12)), _mm256_set1_epi32(0xFF));
+			__m256i packed = _mm256_shuffle_epi8(_mm256_or_si256(upper, _mm256_slli_epi32(lower, 8)), compact);
+			// the second store overwrites the four unused bytes of the first one
+			unsigned char* target = destination + i / 2 * 3;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target), _mm256_castsi256_si128(packed));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target + 12), _mm256_extracti128_si256(packed, 1));
+		}
+		packMono12PackedSSE4(source + i, destination + i / 2 * 3, pixels - i);
+	}
+
+	PIXELPACKING_TARGET("avx2")
+	void unpackMono12AVX2(const unsigned short* source, unsigned short* destination, size_t pixels) {
+		const __m256i mask = _mm256_set1_epi16(MONO12_MAX);
+		size_t i{ 0 };
+		for (; i + 16 <= pixels; i += 16) {
+			__m256i unpacked = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_and_si256(unpacked, mask));
+		}
+		unpackMono12SSE4(source + i, destination + i, pixels - i);
+	}
+
+	PIXELPACKING_TARGET("avx2")
+	void packMono12AVX2(const unsigned short* source, unsigned short* destination, size_t pixels) {
+		const __m256i maximum = _mm256_set1_epi16(MONO12_MAX);
+		size_t i{ 0 };
+		for (; i + 16 <= pixels; i += 16) {
+			__m256i unpacked = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_min_epu16(unpacked, maximum));
+		}
+		packMono12SSE4(source + i, destination + i, pixels - i);
+	}
+
+	SIMD_LEVEL detectLevel() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		int maxFunction = info[0];
+		__cpuid(info, 1);
+		bool sse4 = (info[2] & (1 << 9)) && (info[2] & (1 << 19));
+		// AVX registers have to be saved by the operating system
+		bool osAVX = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6);
+		bool avx2{ false };
+		if (maxFunction >= 7 && osAVX) {
+			__cpuidex(info, 7, 0);
+			avx2 = info[1] & (1 << 5);
+		}
+#else
+		__builtin_cpu_init();
+		bool sse4 = __builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1");
+		bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+		if (avx2) {
+			return SIMD_LEVEL::AVX2;
+		}
+		return sse4 ? SIMD_LEVEL::SSE4 : SIMD_LEVEL::SCALAR;
+	}
+#endif
+}
+
+SIMD_LEVEL PixelPacking::supportedLevel() {
+#ifdef PIXELPACKING_X86
+	static const SIMD_LEVEL level = detectLevel();
+	return level;
+#else
+	return SIMD_LEVEL::SCALAR;
+#endif
+}
+
+std::string PixelPacking::name(SIMD_LEVEL level) {
+	switch (level) {
+		case SIMD_LEVEL::AVX2:
+			return "AVX2";
+		case SIMD_LEVEL::SSE4:
+			return "SSE4";
+		default:
+			return "scalar";
+	}
+}
+
+size_t PixelPacking::packedSize(size_t pixels) {
+	return (pixels * 3 + 1) / 2;
+}
+
+/*
+ * A level above the supported one would crash with an illegal instruction,
+ * so it is lowered to the supported level.
+ */
+void PixelPacking::unpackMono12Packed(const unsigned char* source, unsigned short* destination, size_t pixels, SIMD_LEVEL level) {
+#ifdef PIXELPACKING_X86
+	level = (level > supportedLevel()) ? supportedLevel() : level;
+	if (level == SIMD_LEVEL::AVX2) {
+		return unpackMono12PackedAVX2(source, destination, pixels);
+	} else if (level == SIMD_LEVEL::SSE4) {
+		return unpackMono12PackedSSE4(source, destination, pixels);
+	}
+#endif
+	unpackMono12PackedScalar(source, destination, pixels);
+}
+
+void PixelPacking::packMono12Packed(const unsigned short* source, unsigned char* destination, size_t pixels, SIMD_LEVEL level) {
+#ifdef PIXELPACKING_X86
+	level = (level > supportedLevel()) ? supportedLevel() : level;
+	if (level == SIMD_LEVEL::AVX2) {
+		return packMono12PackedAVX2(source, destination, pixels);
+	} else if (level == SIMD_LEVEL::SSE4) {
+		return packMono12PackedSSE4(source, destination, pixels);
+	}
+#endif
+	packMono12PackedScalar(source, destination, pixels);
+}
+
+void PixelPacking::unpackMono12(const unsigned short* source, unsigned short* destination, size_t pixels, SIMD_LEVEL level) {
+#ifdef PIXELPACKING_X86
+	level = (level > supportedLevel()) ? supportedLevel() : level;
+	if (level == SIMD_LEVEL::AVX2) {
+		return unpackMono12AVX2(source, destination, pixels);
+	} else if (level == SIMD_LEVEL::SSE4) {
+		return unpackMono12SSE4(source, destination, pixels);
+	}
+#endif
+	unpackMono12Scalar(source, destination, pixels);
+}
+
+void PixelPacking::packMono12(const unsigned short* source, unsigned short* destination, size_t pixels, SIMD_LEVEL level) {
+#ifdef PIXELPACKING_X86
+	level = (level > supportedLevel()) ? supportedLevel() : level;
+	if (level == SIMD_LEVEL::AVX2) {
+		return packMono12AVX2(source, destination, pixels);
+	} else if (level == SIMD_LEVEL::SSE4) {
+		return packMono12SSE4(source, destination, pixels);
+	}
+#endif
+	packMono12Scalar(source, destination, pixels);
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef PIXELPACKING_H
+#define PIXELPACKING_H
+
+#include <cstddef>
+#include <string>
+
+enum class SIMD_LEVEL {
+	SCALAR,
+	SSE4,		// SSSE3 shuffles and SSE4.1 saturation
+	AVX2
+};
+
+/*
+ * Conversion between the 12 bit pixel encodings of the cameras and 16 bit pixels.
+ *
+ * Mono12Packed stores two pixels in three bytes: the upper eight bits of the first pixel,
+ * the lower four bits of the first and the second pixel and the upper eight bits of the second pixel.
+ * Mono12 stores every pixel in the lower twelve bits of 16 bits.
+ *
+ * The kernels use the widest instruction set the processor supports, unless a level is requested.
+ * Packing saturates values which do not fit into 12 bits.
+ */
+class PixelPacking {
+
+public:
+	static SIMD_LEVEL supportedLevel();
+	static std::string name(SIMD_LEVEL level);
+
+	// [byte] size of the pixels in Mono12Packed
+	static size_t packedSize(size_t pixels);
+
+	static void unpackMono12Packed(const unsigned char* source, unsigned short* destination, size_t pixels,
+		SIMD_LEVEL level = supportedLevel());
+	static void packMono12Packed(const unsigned short* source, unsigned char* destination, size_t pixels,
+		SIMD_LEVEL level = supportedLevel());
+
+	static void unpackMono12(const unsigned short* source, unsigned short* destination, size_t pixels,
+		SIMD_LEVEL level = supportedLevel());
+	static void packMono12(const unsigned short* source, unsigned short* destination, size_t pixels,
+		SIMD_LEVEL level = supportedLevel());
+};
+
+#endif //PIXELPACKING_H
\ No newline at end of file
@@ -4,16 +4,24 @@
 #include <QtCore>
 #include <gsl/gsl>
 #include "circularBuffer.h"
+#include "tripleBuffer.h"
 #include "Devices\cameraParameters.h"
 
+enum class BUFFER_MODE {
+	QUEUE,			// every frame is shown, the producer has to wait for a free buffer
+	LATEST_FRAME	// only the newest frame is shown, older frames are dropped
+};
+
 struct BUFFER_SETTINGS {
 	int bufferNumber = 0;
 	int bufferSize = 0;
-	std::string bufferType = "unsigned char";
+	PIXEL_FORMAT pixelFormat = PIXEL_FORMAT::MONO8;
 	CAMERA_ROI roi;
+	BUFFER_MODE mode = BUFFER_MODE::QUEUE;
+	bool largePages = false;	// try to back the frame memory with large pages
 	BUFFER_SETTINGS() noexcept {};
-	BUFFER_SETTINGS(int bufferNumber, int bufferSize, std::string bufferType, CAMERA_ROI roi) : roi(roi), bufferNumber(bufferNumber),
-		bufferSize(bufferSize), bufferType(bufferType) {};
+	BUFFER_SETTINGS(int bufferNumber, int bufferSize, PIXEL_FORMAT pixelFormat, CAMERA_ROI roi, BUFFER_MODE mode = BUFFER_MODE::QUEUE) :
+		roi(roi), bufferNumber(bufferNumber), bufferSize(bufferSize), pixelFormat(pixelFormat), mode(mode) {};
 };
 
 template<class T> class PreviewBuffer {
@@ -25,10 +33,28 @@ public:
 
 	void initializeBuffer(BUFFER_SETTINGS bufferSettings);
 
+	// forward to the buffer of the selected mode
+	T* claimWrite();
+	void commitWrite();
+	T* claimRead();
+	void releaseRead();
+
+	// header of the frame returned by claimWrite() and claimRead()
+	FRAME_HEADER* getWriteHeader();
+	FRAME_HEADER* getReadHeader();
+
+	unsigned long long getDroppedFrames() const;
+	ARENA_STATISTICS getArenaStatistics() const;
+
 	std::mutex m_mutex;
 
 	CircularBuffer<T>* m_buffer = new CircularBuffer<T>;
+	TripleBuffer<T>* m_latestBuffer = new TripleBuffer<T>;
 	BUFFER_SETTINGS m_bufferSettings;
+
+private:
+	// the memory of the frame slots is kept when the buffer is reinitialized
+	FrameArena m_arena;
 };
 
 template<class T>
@@ -44,6 +70,7 @@ inline PreviewBuffer<T>::PreviewBuffer(BUFFER_SETTINGS bufferSettings) :
 template<class T>
 inline PreviewBuffer<T>::~PreviewBuffer() {
 	delete m_buffer;
+	delete m_latestBuffer;
 }
 
 template<class T>
@@ -54,7 +81,80 @@ void inline PreviewBuffer<T>::initializeBuffer(BUFFER_SETTINGS bufferSettings) {
 	if (m_buffer != nullptr) {
 		delete m_buffer;
 	}
-	m_buffer = new CircularBuffer<T>(m_bufferSettings.bufferNumber, m_bufferSettings.bufferSize);
+	if (m_latestBuffer != nullptr) {
+		delete m_latestBuffer;
+	}
+	// only the buffer which is actually used gets memory from the arena
+	if (m_bufferSettings.mode == BUFFER_MODE::LATEST_FRAME) {
+		auto memory = m_arena.reserve(TripleBuffer<T>::getMemorySize(m_bufferSettings.bufferSize), m_bufferSettings.largePages);
+		m_buffer = new CircularBuffer<T>;
+		m_latestBuffer = new TripleBuffer<T>(m_bufferSettings.bufferSize, memory);
+	} else {
+		auto memory = m_arena.reserve(CircularBuffer<T>::getMemorySize(m_bufferSettings.bufferNumber, m_bufferSettings.bufferSize),
+			m_bufferSettings.largePages);
+		m_buffer = new CircularBuffer<T>(m_bufferSettings.bufferNumber, m_bufferSettings.bufferSize, memory);
+		m_latestBuffer = new TripleBuffer<T>;
+	}
+}
+
+template<class T>
+inline T * PreviewBuffer<T>::claimWrite() {
+	if (m_bufferSettings.mode == BUFFER_MODE::LATEST_FRAME) {
+		return m_latestBuffer->claimWrite();
+	}
+	return m_buffer->claimWrite();
+}
+
+template<class T>
+inline void PreviewBuffer<T>::commitWrite() {
+	if (m_bufferSettings.mode == BUFFER_MODE::LATEST_FRAME) {
+		m_latestBuffer->commitWrite();
+	} else {
+		m_buffer->commitWrite();
+	}
+}
+
+template<class T>
+inline T * PreviewBuffer<T>::claimRead() {
+	if (m_bufferSettings.mode == BUFFER_MODE::LATEST_FRAME) {
+		return m_latestBuffer->claimRead();
+	}
+	return m_buffer->claimRead();
+}
+
+template<class T>
+inline void PreviewBuffer<T>::releaseRead() {
+	if (m_bufferSettings.mode == BUFFER_MODE::LATEST_FRAME) {
+		m_latestBuffer->releaseRead();
+	} else {
+		m_buffer->releaseRead();
+	}
+}
+
+template<class T>
+inline FRAME_HEADER * PreviewBuffer<T>::getWriteHeader() {
+	if (m_bufferSettings.mode == BUFFER_MODE::LATEST_FRAME) {
+		return m_latestBuffer->getWriteHeader();
+	}
+	return m_buffer->getWriteHeader();
+}
+
+template<class T>
+inline FRAME_HEADER * PreviewBuffer<T>::getReadHeader() {
+	if (m_bufferSettings.mode == BUFFER_MODE::LATEST_FRAME) {
+		return m_latestBuffer->getReadHeader();
+	}
+	return m_buffer->getReadHeader();
+}
+
+template<class T>
+inline unsigned long long PreviewBuffer<T>::getDroppedFrames() const {
+	return m_latestBuffer->getDroppedFrames();
+}
+
+template<class T>
+inline ARENA_STATISTICS PreviewBuffer<T>::getArenaStatistics() const {
+	return m_arena.getStatistics();
 }
 
 #endif //PREVIEWBUFFER_H
\ No newline at end of file
@@ -1,49 +1,399 @@
 #include "stdafx.h"
 #include "storageWrapper.h"
 #include "logger.h"
+#include "simplemath.h"
+#include "pixelPacking.h"
 
+namespace {
+	// memory held by the data of a payload
+	template<typename T>
+	size_t payloadSize(T* payload) {
+		return payload->data.size() * sizeof(payload->data[0]);
+	}
+
+	// the metadata does not count towards the memory limit
+	size_t payloadSize(PAYLOAD_METADATA* metadata) {
+		return 0;
+	}
+
+	void writeAttribute(hid_t location, const std::string& name, const void* value, hid_t type, hsize_t count = 1) {
+		hid_t space = (count > 1) ? H5Screate_simple(1, &count, nullptr) : H5Screate(H5S_SCALAR);
+		// existing attributes are overwritten, e.g. the progress of a checkpoint
+		hid_t attribute = (H5Aexists(location, name.c_str()) > 0)
+			? H5Aopen(location, name.c_str(), H5P_DEFAULT)
+			: H5Acreate2(location, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT);
+		H5Awrite(attribute, type, value);
+		H5Aclose(attribute);
+		H5Sclose(space);
+	}
+
+	void writeAttribute(hid_t location, const std::string& name, const std::string& value) {
+		hid_t type = H5Tcopy(H5T_C_S1);
+		H5Tset_size(type, simplemath::max<size_t>({ value.size(), 1 }));
+		writeAttribute(location, name, value.c_str(), type);
+		H5Tclose(type);
+	}
+
+	void writeAttribute(hid_t location, const std::string& name, int value) {
+		writeAttribute(location, name, &value, H5T_NATIVE_INT);
+	}
+
+	void writeAttribute(hid_t location, const std::string& name, double value) {
+		writeAttribute(location, name, &value, H5T_NATIVE_DOUBLE);
+	}
+
+	template<size_t N>
+	void writeAttribute(hid_t location, const std::string& name, const std::array<int, N>& values) {
+		writeAttribute(location, name, values.data(), H5T_NATIVE_INT, N);
+	}
+
+	template<size_t N>
+	void writeAttribute(hid_t location, const std::string& name, const std::array<double, N>& values) {
+		writeAttribute(location, name, values.data(), H5T_NATIVE_DOUBLE, N);
+	}
+
+	// returns false if the attribute does not exist or has a different number of elements
+	bool readAttribute(hid_t location, const std::string& name, void* value, hid_t type, hsize_t count = 1) {
+		if (H5Aexists(location, name.c_str()) <= 0) {
+			return false;
+		}
+		hid_t attribute = H5Aopen(location, name.c_str(), H5P_DEFAULT);
+		hid_t space = H5Aget_space(attribute);
+		bool read = H5Sget_simple_extent_npoints(space) == (hssize_t)count && H5Aread(attribute, type, value) >= 0;
+		H5Sclose(space);
+		H5Aclose(attribute);
+		return read;
+	}
+
+	template<typename T, size_t N>
+	bool readAttribute(hid_t location, const std::string& name, std::array<T, N>& values) {
+		return readAttribute(location, name, values.data(), std::is_same<T, int>::value ? H5T_NATIVE_INT : H5T_NATIVE_DOUBLE, N);
+	}
+
+	// [1] number of written positions after which the checkpoint is flushed to disk
+	constexpr int CHECKPOINT_FLUSH_INTERVAL = 100;
+
+	// [byte] length of the date strings of the scan points
+	constexpr size_t DATE_LENGTH = 32;
+
+	// appends the values to the 1-D dataset, which is created with all groups leading to it if it does not exist
+	void appendElements(hid_t location, const std::string& name, hid_t type, const void* values, hsize_t count) {
+		hid_t dataset{ -1 };
+		if (H5Lexists(location, name.c_str(), H5P_DEFAULT) > 0) {
+			dataset = H5Dopen2(location, name.c_str(), H5P_DEFAULT);
+		} else {
+			hsize_t size{ 0 };
+			hsize_t maxSize{ H5S_UNLIMITED };
+			hsize_t chunkSize{ 1024 };
+			hid_t space = H5Screate_simple(1, &size, &maxSize);
+			hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+			H5Pset_chunk(properties, 1, &chunkSize);
+			hid_t linkProperties = H5Pcreate(H5P_LINK_CREATE);
+			H5Pset_create_intermediate_group(linkProperties, 1);
+			dataset = H5Dcreate2(location, name.c_str(), type, space, linkProperties, properties, H5P_DEFAULT);
+			H5Pclose(linkProperties);
+			H5Pclose(properties);
+			H5Sclose(space);
+		}
+		if (dataset < 0) {
+			return;
+		}
+		hid_t fileSpace = H5Dget_space(dataset);
+		hsize_t start{ 0 };
+		H5Sget_simple_extent_dims(fileSpace, &start, nullptr);
+		H5Sclose(fileSpace);
+
+		hsize_t size = start + count;
+		H5Dset_extent(dataset, &size);
+		fileSpace = H5Dget_space(dataset);
+		H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &start, nullptr, &count, nullptr);
+		hid_t memorySpace = H5Screate_simple(1, &count, nullptr);
+		H5Dwrite(dataset, type, memorySpace, fileSpace, H5P_DEFAULT, values);
+		H5Sclose(memorySpace);
+		H5Sclose(fileSpace);
+		H5Dclose(dataset);
+	}
+
+	void writeElement(hid_t dataset, hsize_t index, hid_t type, const void* value) {
+		hsize_t count{ 1 };
+		hid_t fileSpace = H5Dget_space(dataset);
+		H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, &index, nullptr, &count, nullptr);
+		hid_t memorySpace = H5Screate_simple(1, &count, nullptr);
+		H5Dwrite(dataset, type, memorySpace, fileSpace, H5P_DEFAULT, value);
+		H5Sclose(memorySpace);
+		H5Sclose(fileSpace);
+	}
+
+	template<typename T>
+	SPOOL_RECORD spoolRecord(SPOOL_PAYLOAD type, T* payload) {
+		SPOOL_RECORD record;
+		record.type = type;
+		record.dataBytes = payloadSize(payload);
+		record.rank = payload->rank;
+		for (gsl::index i{ 0 }; i < payload->rank; i++) {
+			record.dims[i] = payload->dims[i];
+		}
+		strncpy(record.date, payload->date.c_str(), sizeof(record.date) - 1);
+		return record;
+	}
+
+	SPOOL_RECORD spoolRecord(IMAGE* img) {
+		SPOOL_RECORD record = spoolRecord(SPOOL_PAYLOAD::IMAGE, img);
+		record.indices[0] = img->indX;
+		record.indices[1] = img->indY;
+		record.indices[2] = img->indZ;
+		return record;
+	}
+
+	SPOOL_RECORD spoolRecord(ODTIMAGE* img) {
+		SPOOL_RECORD record = spoolRecord(SPOOL_PAYLOAD::ODTIMAGE, img);
+		record.indices[0] = img->ind;
+		return record;
+	}
+
+	SPOOL_RECORD spoolRecord(FLUOIMAGE* img) {
+		SPOOL_RECORD record = spoolRecord(SPOOL_PAYLOAD::FLUOIMAGE, img);
+		record.indices[0] = img->ind;
+		strncpy(record.text, img->channel.c_str(), sizeof(record.text) - 1);
+		return record;
+	}
+
+	SPOOL_RECORD spoolRecord(CALIBRATION* cal) {
+		SPOOL_RECORD record = spoolRecord(SPOOL_PAYLOAD::CALIBRATION, cal);
+		record.indices[0] = cal->index;
+		record.shift = cal->shift;
+		strncpy(record.text, cal->sample.c_str(), sizeof(record.text) - 1);
+		return record;
+	}
+
+	std::string modeGroup(ACQUISITION_MODE mode) {
+		switch (mode) {
+			case ACQUISITION_MODE::BRILLOUIN:
+				return "/Brillouin";
+			case ACQUISITION_MODE::ODT:
+				return "/ODT";
+			case ACQUISITION_MODE::FLUORESCENCE:
+				return "/Fluorescence";
+			default:
+				return "/";
+		}
+	}
+}
+
+StorageWrapper::StorageWrapper(QObject *parent, const std::string fullPath, int flags) :
+	H5BM(parent, fullPath, flags) {
+	// HDF5 shares the already opened file between both handles
+	if (flags != H5F_ACC_RDONLY) {
+		m_file = H5Fopen(fullPath.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+	}
+
+	int recoveredPayloads{ 0 };
+	m_spoolPath = PayloadSpool::spoolPath(fullPath);
+	if (PayloadSpool::exists(m_spoolPath)) {
+		if (flags == H5F_ACC_TRUNC) {
+			// the spool belongs to the file which is overwritten
+			PayloadSpool::remove(m_spoolPath);
+		} else if (openSpool()) {
+			// the recovered payloads belong to the last repetitions in the file
+			for (auto mode : { ACQUISITION_MODE::BRILLOUIN, ACQUISITION_MODE::ODT, ACQUISITION_MODE::FLUORESCENCE }) {
+				selectLastRepetition(mode);
+			}
+			for (auto direction : { "x", "y" }) {
+				m_resolution[direction] = H5BM::getResolution(direction);
+			}
+			recoveredPayloads = m_spool->getStatistics().pendingRecords;
+			m_statistics.queueDepth = recoveredPayloads;
+			m_statistics.peakQueueDepth = recoveredPayloads;
+		}
+	}
+
+	m_writerThread.startWorker(this);
+
+	// convert the payloads of an interrupted acquisition
+	if (recoveredPayloads > 0) {
+		std::string info = "Recovering " + std::to_string(recoveredPayloads) + " payloads from the spool.";
+		qInfo(logInfo()) << info.c_str();
+		QMetaObject::invokeMethod(this, "s_writeQueues", Qt::QueuedConnection);
+	}
+}
 
 StorageWrapper::~StorageWrapper() {
+	m_writerThread.quit();
+	m_writerThread.wait();
+
+	// write what is left in the queues, unless the acquisition was aborted
+	if (!m_abort) {
+		s_writeQueues();
+	}
+	// the compression jobs still read the data of the remaining payloads
+	m_compressionPool.waitForDone();
+	m_compressedPayloads.clear();
+	m_packedPayloads.clear();
+	closeScan();
+	closeCheckpoint();
 	// clear image queue in case acquisition was aborted
 	// and the queue is still filled
-	if (m_abort) {
-		while (!m_payloadQueueBrillouin.isEmpty()) {
-			IMAGE *img = m_payloadQueueBrillouin.dequeue();
-			delete img;
-		}
-		while (!m_payloadQueueODT.isEmpty()) {
-			ODTIMAGE *img = m_payloadQueueODT.dequeue();
-			delete img;
-		}
-		while (!m_payloadQueueFluorescence.isEmpty()) {
-			FLUOIMAGE *img = m_payloadQueueFluorescence.dequeue();
-			delete img;
+	while (!m_payloadQueueBrillouin.isEmpty()) {
+		IMAGE *img = m_payloadQueueBrillouin.dequeue();
+		delete img;
+	}
+	while (!m_payloadQueueODT.isEmpty()) {
+		ODTIMAGE *img = m_payloadQueueODT.dequeue();
+		delete img;
+	}
+	while (!m_payloadQueueFluorescence.isEmpty()) {
+		FLUOIMAGE *img = m_payloadQueueFluorescence.dequeue();
+		delete img;
+	}
+	while (!m_calibrationQueue.isEmpty()) {
+		CALIBRATION *cal = m_calibrationQueue.dequeue();
+		delete cal;
+	}
+	while (!m_metadataQueue.isEmpty()) {
+		delete m_metadataQueue.dequeue();
+	}
+	m_spooledPayloads.clear();
+	if (m_spool != nullptr) {
+		int pendingRecords = m_spool->getStatistics().pendingRecords;
+		if (pendingRecords > 0) {
+			std::string info = "The spool still holds " + std::to_string(pendingRecords)
+				+ " payloads, they are recovered when the file is opened again.";
+			qWarning(logWarning()) << info.c_str();
 		}
-		while (!m_calibrationQueue.isEmpty()) {
-			CALIBRATION *cal = m_calibrationQueue.dequeue();
-			delete cal;
+		// the spool is only deleted if all payloads are in the file
+		m_spool->close();
+	}
+	if (m_file >= 0) {
+		H5Fclose(m_file);
+	}
+}
+
+// has to be called with the queue mutex locked
+template<typename T>
+void StorageWrapper::copyDimensions(T* payload) {
+	auto dims = std::make_unique<hsize_t[]>(payload->rank);
+	std::copy(payload->dims, payload->dims + payload->rank, dims.get());
+	payload->dims = dims.get();
+	m_payloadDims[payload] = std::move(dims);
+}
+
+void StorageWrapper::releaseDimensions(const void* payload) {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	m_payloadDims.erase(payload);
+}
+
+template<typename T>
+void StorageWrapper::enqueue(QQueue<T*>& queue, T* payload) {
+	if (spool(payload)) {
+		return;
+	}
+	size_t bytes = payloadSize(payload);
+	{
+		std::unique_lock<std::mutex> lock(m_queueMutex);
+		// apply backpressure if the queued payloads exceed the memory limit,
+		// a payload larger than the limit is accepted once the queues are empty
+		if (m_statistics.bytesInFlight > 0 && m_statistics.bytesInFlight + bytes > m_memoryLimit) {
+			QElapsedTimer blockedTimer;
+			blockedTimer.start();
+			m_queueChanged.wait(lock, [this, bytes] {
+				return m_abort || m_statistics.bytesInFlight == 0 || m_statistics.bytesInFlight + bytes <= m_memoryLimit;
+			});
+			m_statistics.blockedDuration += 1e-9 * blockedTimer.nsecsElapsed();
 		}
+		copyDimensions(payload);
+		// start compressing right away, the writer thread picks up the result
+		compress(payload);
+		queue.enqueue(payload);
+		m_statistics.queueDepth++;
+		m_statistics.bytesInFlight += bytes;
+		m_statistics.peakQueueDepth = simplemath::max<int>({ m_statistics.peakQueueDepth, m_statistics.queueDepth });
+		m_statistics.peakBytesInFlight = simplemath::max<size_t>({ m_statistics.peakBytesInFlight, m_statistics.bytesInFlight });
 	}
+	QMetaObject::invokeMethod(this, "s_writeQueues", Qt::QueuedConnection);
 }
 
 void StorageWrapper::s_enqueuePayload(IMAGE *img) {
-	m_payloadQueueBrillouin.enqueue(img);
-	s_writeQueues();
+	pack(img);
+	enqueue(m_payloadQueueBrillouin, img);
 }
 
 void StorageWrapper::s_enqueuePayload(ODTIMAGE *img) {
-	m_payloadQueueODT.enqueue(img);
-	s_writeQueues();
+	enqueue(m_payloadQueueODT, img);
 }
 
 void StorageWrapper::s_enqueuePayload(FLUOIMAGE *img) {
-	m_payloadQueueFluorescence.enqueue(img);
-	s_writeQueues();
+	enqueue(m_payloadQueueFluorescence, img);
 }
 
 void StorageWrapper::s_enqueueCalibration(CALIBRATION *cal) {
-	m_calibrationQueue.enqueue(cal);
-	s_writeQueues();
+	enqueue(m_calibrationQueue, cal);
+}
+
+void StorageWrapper::s_enqueuePayload(IMAGE* img, std::vector<FRAME_METADATA> metadata) {
+	enqueueMetadata(new PAYLOAD_METADATA{ ACQUISITION_MODE::BRILLOUIN, { (int)img->indX, (int)img->indY, (int)img->indZ }, std::move(metadata) });
+	s_enqueuePayload(img);
+}
+
+void StorageWrapper::s_enqueuePayload(ODTIMAGE* img, std::vector<FRAME_METADATA> metadata) {
+	enqueueMetadata(new PAYLOAD_METADATA{ ACQUISITION_MODE::ODT, { (int)img->ind, 0, 0 }, std::move(metadata) });
+	s_enqueuePayload(img);
+}
+
+void StorageWrapper::s_enqueuePayload(FLUOIMAGE* img, std::vector<FRAME_METADATA> metadata) {
+	enqueueMetadata(new PAYLOAD_METADATA{ ACQUISITION_MODE::FLUORESCENCE, { (int)img->ind, 0, 0 }, std::move(metadata) });
+	s_enqueuePayload(img);
+}
+
+void StorageWrapper::enqueueMetadata(PAYLOAD_METADATA* metadata) {
+	if (metadata->frames.empty()) {
+		delete metadata;
+		return;
+	}
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	m_metadataQueue.enqueue(metadata);
+	m_statistics.queueDepth++;
+	m_statistics.peakQueueDepth = simplemath::max<int>({ m_statistics.peakQueueDepth, m_statistics.queueDepth });
+}
+
+/*
+ * Appends one row per frame to the metadata datasets of the current repetition of the mode.
+ */
+void StorageWrapper::writeMetadata(PAYLOAD_METADATA* metadata) {
+	if (m_file < 0) {
+		return;
+	}
+	// the Brillouin images are named by their position in the scan
+	int index = metadata->indices[0];
+	if (metadata->mode == ACQUISITION_MODE::BRILLOUIN) {
+		index = (metadata->indices[2] * m_resolution["y"] + metadata->indices[1]) * m_resolution["x"] + metadata->indices[0];
+	}
+
+	hsize_t count = metadata->frames.size();
+	std::vector<int> indices(count, index);
+	std::vector<int> frames(count);
+	std::vector<uint64_t> frameIDs(count);
+	std::vector<uint64_t> cameraFrames(count);
+	std::vector<double> timestamps(count);
+	std::vector<double> systemTimes(count);
+	std::vector<double> exposureTimes(count);
+	for (gsl::index i{ 0 }; i < (gsl::index)count; i++) {
+		const FRAME_METADATA& frame = metadata->frames[i];
+		frames[i] = (int)i;
+		frameIDs[i] = frame.frameID;
+		cameraFrames[i] = frame.cameraFrame;
+		timestamps[i] = frame.timestamp;
+		systemTimes[i] = frame.systemTime;
+		exposureTimes[i] = frame.exposureTime;
+	}
+
+	std::string group = repetitionGroup(metadata->mode) + "/metadata/";
+	appendElements(m_file, group + "index", H5T_NATIVE_INT, indices.data(), count);
+	appendElements(m_file, group + "frame", H5T_NATIVE_INT, frames.data(), count);
+	appendElements(m_file, group + "frameID", H5T_NATIVE_UINT64, frameIDs.data(), count);
+	appendElements(m_file, group + "cameraFrame", H5T_NATIVE_UINT64, cameraFrames.data(), count);
+	appendElements(m_file, group + "timestamp", H5T_NATIVE_DOUBLE, timestamps.data(), count);
+	appendElements(m_file, group + "systemTime", H5T_NATIVE_DOUBLE, systemTimes.data(), count);
+	appendElements(m_file, group + "exposureTime", H5T_NATIVE_DOUBLE, exposureTimes.data(), count);
 }
 
 void StorageWrapper::s_finishedQueueing() {
@@ -53,67 +403,991 @@ void StorageWrapper::s_finishedQueueing() {
 void StorageWrapper::startWritingQueues() {
 	m_observeQueues = true;
 	m_finishedQueueing = false;
-	s_writeQueues();
+	QMetaObject::invokeMethod(this, "s_writeQueues", Qt::QueuedConnection);
 }
 
 void StorageWrapper::stopWritingQueues() {
 	m_observeQueues = false;
 }
 
+void StorageWrapper::waitForQueues() {
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	m_queueChanged.wait(lock, [this] { return m_abort || m_statistics.queueDepth == 0; });
+}
+
+void StorageWrapper::logStatistics() {
+	STORAGE_STATISTICS statistics = getStatistics();
+	std::string info = "Storage: " + std::to_string(statistics.writtenBytes / 1048576) + " MB written at "
+		+ std::to_string((int)statistics.throughput) + " MB/s, peak queue depth " + std::to_string(statistics.peakQueueDepth)
+		+ " (" + std::to_string(statistics.peakBytesInFlight / 1048576) + " MB), acquisition blocked for "
+		+ std::to_string(statistics.blockedDuration) + " s.";
+	qInfo(logInfo()) << info.c_str();
+
+	COMPRESSION_STATISTICS compression = getCompressionStatistics();
+	if (compression.rawBytes > 0) {
+		info = "Compression: ratio " + std::to_string(compression.ratio) + ", "
+			+ std::to_string((int)compression.throughput) + " MB/s per worker.";
+		qInfo(logInfo()) << info.c_str();
+	}
+
+	if (m_spool != nullptr) {
+		SPOOL_STATISTICS spool = m_spool->getStatistics();
+		info = "Spool: " + std::to_string(spool.appendedBytes / 1048576) + " MB spooled at "
+			+ std::to_string((int)spool.throughput) + " MB/s, " + std::to_string(spool.convertedRecords)
+			+ " payloads converted, " + std::to_string(spool.pendingRecords) + " pending.";
+		qInfo(logInfo()) << info.c_str();
+	}
+
+	POOL_STATISTICS imagePool = m_imagePool.getStatistics();
+	POOL_STATISTICS brightfieldPool = m_brightfieldPool.getStatistics();
+	info = "Payload buffers: " + std::to_string(imagePool.hits + brightfieldPool.hits) + " reused, "
+		+ std::to_string(imagePool.misses + brightfieldPool.misses) + " allocated.";
+	qInfo(logInfo()) << info.c_str();
+}
+
+void StorageWrapper::setMemoryLimit(size_t bytes) {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	m_memoryLimit = bytes;
+	m_queueChanged.notify_all();
+}
+
+STORAGE_STATISTICS StorageWrapper::getStatistics() {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	STORAGE_STATISTICS statistics = m_statistics;
+	if (statistics.writeDuration > 0) {
+		statistics.throughput = 1e-6 * statistics.writtenBytes / statistics.writeDuration;
+	}
+	return statistics;
+}
+
+void StorageWrapper::setCompression(COMPRESSION_SETTINGS settings) {
+	bool available{ false };
+	{
+		std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+		available = ChunkCompressor::isAvailable(settings.codec);
+	}
+	if (!available) {
+		std::string info = "The requested compression filter is not available, the payloads are stored uncompressed.";
+		qWarning(logWarning()) << info.c_str();
+		settings.codec = COMPRESSION_CODEC::NONE;
+	}
+	m_compressionPool.setWorkerNumber(settings.workerNumber);
+
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	m_compression = settings;
+}
+
+COMPRESSION_STATISTICS StorageWrapper::getCompressionStatistics() {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	COMPRESSION_STATISTICS statistics = m_compressionStatistics;
+	if (statistics.compressedBytes > 0) {
+		statistics.ratio = (double)statistics.rawBytes / statistics.compressedBytes;
+	}
+	if (statistics.compressionDuration > 0) {
+		statistics.throughput = 1e-6 * statistics.rawBytes / statistics.compressionDuration;
+	}
+	return statistics;
+}
+
+void StorageWrapper::addCompressionStatistics(size_t rawBytes, size_t compressedBytes, double duration) {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	m_compressionStatistics.rawBytes += rawBytes;
+	m_compressionStatistics.compressedBytes += compressedBytes;
+	m_compressionStatistics.compressionDuration += duration;
+}
+
+/*
+ * Queues the compression of the payload on the worker pool.
+ * Has to be called with the queue mutex locked.
+ */
+template<typename T>
+void StorageWrapper::compress(T* payload) {
+	if (m_file < 0 || !ChunkCompressor::isDirect(m_compression)) {
+		return;
+	}
+	COMPRESSION_SETTINGS settings = m_compression;
+	auto data = reinterpret_cast<const unsigned char*>(payload->data.data());
+	size_t elementSize = sizeof(payload->data[0]);
+	std::vector<hsize_t> dims(payload->dims, payload->dims + payload->rank);
+	// packed images are compressed as bytes
+	if (m_packedPayloads.count(payload)) {
+		elementSize = 1;
+		dims.back() = PixelPacking::packedSize(dims.back());
+	}
+
+	m_compressedPayloads[payload] = m_compressionPool.submit([settings, data, elementSize, dims] {
+		return ChunkCompressor::compress(settings, data, elementSize, (int)dims.size(), dims.data());
+	});
+}
+
+/*
+ * Writes the payload as compressed dataset.
+ * Returns the dataset, which has to be closed by the caller, or -1 if the payload is not compressed.
+ */
+template<typename T>
+hid_t StorageWrapper::writeCompressed(T* payload, hid_t type, const std::string& name) {
+	COMPRESSION_SETTINGS settings;
+	{
+		std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+		settings = m_compression;
+	}
+	std::shared_future<COMPRESSED_DATA> compressed = takeCompressed(payload);
+
+	if (compressed.valid()) {
+		const COMPRESSED_DATA& data = compressed.get();
+		addCompressionStatistics(data.rawBytes, data.compressedBytes, data.duration);
+		return ChunkCompressor::write(m_file, name, type, data);
+	}
+
+	// filters only available as HDF5 plugin compress while writing
+	if (m_file >= 0 && settings.codec != COMPRESSION_CODEC::NONE && !ChunkCompressor::isDirect(settings)) {
+		QElapsedTimer compressionTimer;
+		compressionTimer.start();
+		hid_t dataset = ChunkCompressor::write(m_file, name, type, settings, payload->data.data(), payload->rank, payload->dims);
+		if (dataset >= 0) {
+			addCompressionStatistics(payloadSize(payload), H5Dget_storage_size(dataset), 1e-9 * compressionTimer.nsecsElapsed());
+		}
+		return dataset;
+	}
+	return -1;
+}
+
+std::shared_future<COMPRESSED_DATA> StorageWrapper::takeCompressed(const void* payload) {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	std::shared_future<COMPRESSED_DATA> compressed;
+	auto job = m_compressedPayloads.find(payload);
+	if (job != m_compressedPayloads.end()) {
+		compressed = job->second;
+		m_compressedPayloads.erase(job);
+	}
+	return compressed;
+}
+
+void StorageWrapper::setPacking(bool enabled) {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	m_packing = enabled;
+}
+
+bool StorageWrapper::getPacking() {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	return m_packing;
+}
+
+/*
+ * Packs the image in place, the buffer keeps its capacity for the pool.
+ * Packing in place is possible, since the kernels never write behind the pixels they already read.
+ */
+void StorageWrapper::pack(IMAGE* img) {
+	{
+		std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+		// the spool stores the images as they are
+		if (!m_packing || m_spooling || img->rank < 1 || img->dims[img->rank - 1] % 2) {
+			return;
+		}
+	}
+	size_t pixels = img->data.size();
+	auto data = img->data.data();
+	PixelPacking::packMono12Packed(data, reinterpret_cast<unsigned char*>(data), pixels);
+	img->data.resize((PixelPacking::packedSize(pixels) + 1) / 2);
+
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	m_packedPayloads.insert(img);
+}
+
+bool StorageWrapper::takePacked(const void* payload) {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	return m_packedPayloads.erase(payload) > 0;
+}
+
+std::vector<hsize_t> StorageWrapper::packedDims(const IMAGE* img) {
+	std::vector<hsize_t> dims(img->dims, img->dims + img->rank);
+	dims.back() = PixelPacking::packedSize(dims.back());
+	return dims;
+}
+
+/*
+ * Writes the packed image as byte dataset.
+ * Returns the dataset, which has to be closed by the caller, or -1 if it could not be written.
+ */
+hid_t StorageWrapper::writePacked(IMAGE* img, const std::string& name) {
+	hid_t dataset{ -1 };
+	std::shared_future<COMPRESSED_DATA> compressed = takeCompressed(img);
+	if (compressed.valid()) {
+		const COMPRESSED_DATA& data = compressed.get();
+		addCompressionStatistics(data.rawBytes, data.compressedBytes, data.duration);
+		dataset = ChunkCompressor::write(m_file, name, H5T_NATIVE_UCHAR, data);
+	} else if (m_file >= 0) {
+		COMPRESSION_SETTINGS settings;
+		{
+			std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+			settings = m_compression;
+		}
+		std::vector<hsize_t> dims = packedDims(img);
+		dataset = ChunkCompressor::write(m_file, name, H5T_NATIVE_UCHAR, settings, img->data.data(), img->rank, dims.data());
+	}
+	if (dataset >= 0) {
+		writeAttribute(dataset, "encoding", std::string("Mono12Packed"));
+		writeAttribute(dataset, "width", (int)img->dims[img->rank - 1]);
+	}
+	return dataset;
+}
+
+// restores the 16 bit pixels of a packed image, if it has to be written unpacked after all
+void StorageWrapper::unpack(IMAGE* img) {
+	size_t pixels{ 1 };
+	for (gsl::index i{ 0 }; i < img->rank; i++) {
+		pixels *= img->dims[i];
+	}
+	std::vector<unsigned short> unpacked = m_imagePool.getBuffer(pixels);
+	PixelPacking::unpackMono12Packed(reinterpret_cast<const unsigned char*>(img->data.data()), unpacked.data(), pixels);
+	m_imagePool.reclaim(img->data);
+	img->data = std::move(unpacked);
+}
+
+void StorageWrapper::setLayout(STORAGE_LAYOUT layout) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	m_layout = layout;
+}
+
+STORAGE_LAYOUT StorageWrapper::getLayout() {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	return m_layout;
+}
+
+void StorageWrapper::createScan(hsize_t zSteps, hsize_t xSteps, hsize_t ySteps, int rank, const hsize_t* dims) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	closeScan();
+	if (m_layout != STORAGE_LAYOUT::HYPERSLAB || m_file < 0) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+		m_scan.compression = m_compression;
+		m_scan.packed = m_packing && !m_spooling && rank > 0 && dims[rank - 1] % 2 == 0;
+	}
+
+	// packed images are stored as bytes, every row takes one and a half bytes per pixel
+	std::vector<hsize_t> frameDims(dims, dims + rank);
+	if (m_scan.packed) {
+		frameDims.back() = PixelPacking::packedSize(frameDims.back());
+	}
+	m_scan.dims = { zSteps, xSteps, ySteps };
+	m_scan.dims.insert(m_scan.dims.end(), frameDims.begin(), frameDims.end());
+	// a chunk never spans more than one scan point
+	m_scan.chunkShape = { 1, 1, 1 };
+	std::vector<hsize_t> frameChunkShape = ChunkCompressor::getChunkShape(m_scan.compression, rank, frameDims.data());
+	m_scan.chunkShape.insert(m_scan.chunkShape.end(), frameChunkShape.begin(), frameChunkShape.end());
+
+	std::string group = repetitionGroup(ACQUISITION_MODE::BRILLOUIN) + "/payload/";
+
+	// the datasets of a resumed repetition already exist
+	if (H5Lexists(m_file, group.c_str(), H5P_DEFAULT) > 0 && H5Lexists(m_file, (group + "images").c_str(), H5P_DEFAULT) > 0) {
+		m_scan.images = H5Dopen2(m_file, (group + "images").c_str(), H5P_DEFAULT);
+		m_scan.dates = H5Dopen2(m_file, (group + "dates").c_str(), H5P_DEFAULT);
+		m_scan.order = H5Dopen2(m_file, (group + "acquisitionOrder").c_str(), H5P_DEFAULT);
+		hid_t space = H5Dget_space(m_scan.images);
+		bool matches = H5Sget_simple_extent_ndims(space) == (int)m_scan.dims.size();
+		std::vector<hsize_t> existingDims(m_scan.dims.size());
+		if (matches) {
+			H5Sget_simple_extent_dims(space, existingDims.data(), nullptr);
+			matches = existingDims == m_scan.dims;
+		}
+		H5Sclose(space);
+		// the dataset might have been created with another compression, so HDF5 applies its filters
+		m_scan.compression = COMPRESSION_SETTINGS{};
+		if (!matches || m_scan.dates < 0 || m_scan.order < 0) {
+			closeScan();
+			std::string info = "The scan dataset does not match the scan, the payloads are stored in the h5bm layout.";
+			qWarning(logWarning()) << info.c_str();
+		}
+		return;
+	}
+
+	hid_t properties = ChunkCompressor::createProperties(m_scan.compression, m_scan.chunkShape);
+	// without compression the whole dataset is allocated right away, so the writes only fill the file
+	if (m_scan.compression.codec == COMPRESSION_CODEC::NONE) {
+		H5Pset_alloc_time(properties, H5D_ALLOC_TIME_EARLY);
+		H5Pset_fill_time(properties, H5D_FILL_TIME_NEVER);
+	}
+	m_scan.images = ChunkCompressor::createDataset(m_file, group + "images", m_scan.packed ? H5T_NATIVE_UCHAR : H5T_NATIVE_USHORT,
+		properties, (int)m_scan.dims.size(), m_scan.dims.data());
+	H5Pclose(properties);
+	if (m_scan.images < 0) {
+		closeScan();
+		std::string info = "The scan dataset could not be created, the payloads are stored in the h5bm layout.";
+		qWarning(logWarning()) << info.c_str();
+		return;
+	}
+	writeAttribute(m_scan.images, "dimensions", std::string("z, x, y, frame, height, width"));
+	if (m_scan.packed) {
+		writeAttribute(m_scan.images, "encoding", std::string("Mono12Packed"));
+		writeAttribute(m_scan.images, "width", (int)dims[rank - 1]);
+	}
+
+	// the metadata of the points goes into small 1-D companion datasets in (z, x, y) order
+	hsize_t pointNumber = zSteps * xSteps * ySteps;
+	hid_t dateType = H5Tcopy(H5T_C_S1);
+	H5Tset_size(dateType, DATE_LENGTH);
+	properties = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_alloc_time(properties, H5D_ALLOC_TIME_EARLY);
+	m_scan.dates = ChunkCompressor::createDataset(m_file, group + "dates", dateType, properties, 1, &pointNumber);
+	H5Pclose(properties);
+	H5Tclose(dateType);
+
+	// points which were not acquired keep the order -1
+	int notAcquired{ -1 };
+	properties = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_alloc_time(properties, H5D_ALLOC_TIME_EARLY);
+	H5Pset_fill_value(properties, H5T_NATIVE_INT, &notAcquired);
+	m_scan.order = ChunkCompressor::createDataset(m_file, group + "acquisitionOrder", H5T_NATIVE_INT, properties, 1, &pointNumber);
+	H5Pclose(properties);
+}
+
+/*
+ * Writes the image into the scan dataset of the repetition.
+ * Returns false if the image does not fit into the scan dataset.
+ */
+bool StorageWrapper::writeScanPoint(IMAGE* img, bool packed) {
+	if (m_scan.images < 0 || img->rank + 3 != (int)m_scan.dims.size() || packed != m_scan.packed) {
+		return false;
+	}
+	std::vector<hsize_t> frameDims = packed ? packedDims(img) : std::vector<hsize_t>(img->dims, img->dims + img->rank);
+	std::vector<hsize_t> offset = { (hsize_t)img->indZ, (hsize_t)img->indX, (hsize_t)img->indY };
+	for (gsl::index i{ 0 }; i < (gsl::index)m_scan.dims.size(); i++) {
+		if (i < 3 ? offset[i] >= m_scan.dims[i] : frameDims[i - 3] != m_scan.dims[i]) {
+			return false;
+		}
+	}
+
+	bool written{ false };
+	std::shared_future<COMPRESSED_DATA> compressed = takeCompressed(img);
+	if (compressed.valid()) {
+		const COMPRESSED_DATA& data = compressed.get();
+		if (ChunkCompressor::matches(data, m_scan.compression, m_scan.chunkShape)) {
+			written = ChunkCompressor::writeChunks(m_scan.images, data, offset);
+			addCompressionStatistics(data.rawBytes, data.compressedBytes, data.duration);
+		}
+	}
+	if (!written) {
+		std::vector<hsize_t> start = offset;
+		start.resize(m_scan.dims.size(), 0);
+		std::vector<hsize_t> count = { 1, 1, 1 };
+		count.insert(count.end(), frameDims.begin(), frameDims.end());
+
+		hid_t fileSpace = H5Dget_space(m_scan.images);
+		H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr);
+		hid_t memorySpace = H5Screate_simple(img->rank, frameDims.data(), nullptr);
+		written = H5Dwrite(m_scan.images, packed ? H5T_NATIVE_UCHAR : H5T_NATIVE_USHORT, memorySpace, fileSpace,
+			H5P_DEFAULT, img->data.data()) >= 0;
+		H5Sclose(memorySpace);
+		H5Sclose(fileSpace);
+	}
+	if (!written) {
+		return false;
+	}
+
+	hsize_t index = (offset[0] * m_scan.dims[1] + offset[1]) * m_scan.dims[2] + offset[2];
+	char date[DATE_LENGTH]{};
+	strncpy(date, img->date.c_str(), DATE_LENGTH - 1);
+	hid_t dateType = H5Dget_type(m_scan.dates);
+	writeElement(m_scan.dates, index, dateType, date);
+	H5Tclose(dateType);
+	writeElement(m_scan.order, index, H5T_NATIVE_INT, &m_scan.writtenPoints);
+	m_scan.writtenPoints++;
+	return true;
+}
+
+void StorageWrapper::closeScan() {
+	for (hid_t dataset : { m_scan.images, m_scan.dates, m_scan.order }) {
+		if (dataset >= 0) {
+			H5Dclose(dataset);
+		}
+	}
+	m_scan = SCAN_DATASETS{};
+}
+
+void StorageWrapper::startCheckpoint(SCAN_CHECKPOINT checkpoint) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	closeCheckpoint();
+	if (m_file < 0) {
+		return;
+	}
+	hid_t linkProperties = H5Pcreate(H5P_LINK_CREATE);
+	H5Pset_create_intermediate_group(linkProperties, 1);
+	m_checkpointGroup = H5Gcreate2(m_file, (repetitionGroup(ACQUISITION_MODE::BRILLOUIN) + "/checkpoint").c_str(),
+		linkProperties, H5P_DEFAULT, H5P_DEFAULT);
+	H5Pclose(linkProperties);
+	if (m_checkpointGroup < 0) {
+		std::string info = "The checkpoint could not be created, the repetition cannot be resumed.";
+		qWarning(logWarning()) << info.c_str();
+		return;
+	}
+	m_checkpoint = checkpoint;
+	writeAttribute(m_checkpointGroup, "min", m_checkpoint.min);
+	writeAttribute(m_checkpointGroup, "max", m_checkpoint.max);
+	writeAttribute(m_checkpointGroup, "steps", m_checkpoint.steps);
+	writeAttribute(m_checkpointGroup, "order", m_checkpoint.order);
+	writeAttribute(m_checkpointGroup, "trajectory", m_checkpoint.trajectory);
+	writeAttribute(m_checkpointGroup, "origin", m_checkpoint.origin);
+	writeAttribute(m_checkpointGroup, "frameDims", m_checkpoint.frameDims);
+	writeAttribute(m_checkpointGroup, "finished", 0);
+	writeCheckpointProgress(true);
+}
+
+SCAN_CHECKPOINT StorageWrapper::readCheckpoint() {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	SCAN_CHECKPOINT checkpoint;
+	if (m_file < 0) {
+		return checkpoint;
+	}
+	selectLastRepetition(ACQUISITION_MODE::BRILLOUIN);
+	std::string repetition = repetitionGroup(ACQUISITION_MODE::BRILLOUIN);
+	std::string group = repetition + "/checkpoint";
+	if (H5Lexists(m_file, modeGroup(ACQUISITION_MODE::BRILLOUIN).c_str(), H5P_DEFAULT) <= 0
+		|| H5Lexists(m_file, (modeGroup(ACQUISITION_MODE::BRILLOUIN) + "/repetitions").c_str(), H5P_DEFAULT) <= 0
+		|| H5Lexists(m_file, repetition.c_str(), H5P_DEFAULT) <= 0
+		|| H5Lexists(m_file, group.c_str(), H5P_DEFAULT) <= 0) {
+		return checkpoint;
+	}
+	hid_t location = H5Gopen2(m_file, group.c_str(), H5P_DEFAULT);
+	int finished{ 1 };
+	bool read = readAttribute(location, "min", checkpoint.min)
+		&& readAttribute(location, "max", checkpoint.max)
+		&& readAttribute(location, "steps", checkpoint.steps)
+		&& readAttribute(location, "order", checkpoint.order)
+		&& readAttribute(location, "trajectory", &checkpoint.trajectory, H5T_NATIVE_INT)
+		&& readAttribute(location, "origin", checkpoint.origin)
+		&& readAttribute(location, "frameDims", checkpoint.frameDims)
+		&& readAttribute(location, "writtenPositions", &checkpoint.writtenPositions, H5T_NATIVE_INT)
+		&& readAttribute(location, "calibrations", &checkpoint.calibrations, H5T_NATIVE_INT)
+		&& readAttribute(location, "finished", &finished, H5T_NATIVE_INT);
+	H5Gclose(location);
+	int positions = checkpoint.steps[0] * checkpoint.steps[1] * checkpoint.steps[2];
+	checkpoint.valid = read && !finished && checkpoint.writtenPositions < positions;
+	return checkpoint;
+}
+
+void StorageWrapper::resumeCheckpoint(SCAN_CHECKPOINT checkpoint) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	closeCheckpoint();
+	if (m_file < 0 || !checkpoint.valid) {
+		return;
+	}
+	// the payloads go into the repetition of the checkpoint
+	selectLastRepetition(ACQUISITION_MODE::BRILLOUIN);
+	m_resolution["x"] = checkpoint.steps[0];
+	m_resolution["y"] = checkpoint.steps[1];
+	m_resolution["z"] = checkpoint.steps[2];
+	m_checkpointGroup = H5Gopen2(m_file, (repetitionGroup(ACQUISITION_MODE::BRILLOUIN) + "/checkpoint").c_str(), H5P_DEFAULT);
+	m_checkpoint = checkpoint;
+	// the points of the scan dataset keep counting in acquisition order
+	m_scan.writtenPoints = checkpoint.writtenPositions;
+}
+
+void StorageWrapper::finishCheckpoint() {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	if (m_checkpointGroup < 0) {
+		return;
+	}
+	writeAttribute(m_checkpointGroup, "finished", 1);
+	writeCheckpointProgress(true);
+	closeCheckpoint();
+}
+
+void StorageWrapper::writeCheckpointProgress(bool flush) {
+	if (m_checkpointGroup < 0) {
+		return;
+	}
+	writeAttribute(m_checkpointGroup, "writtenPositions", m_checkpoint.writtenPositions);
+	writeAttribute(m_checkpointGroup, "calibrations", m_checkpoint.calibrations);
+	// the written payloads and the checkpoint reach the disk together
+	if (flush || m_checkpoint.writtenPositions % CHECKPOINT_FLUSH_INTERVAL == 0) {
+		H5Fflush(m_file, H5F_SCOPE_LOCAL);
+	}
+}
+
+void StorageWrapper::closeCheckpoint() {
+	if (m_checkpointGroup >= 0) {
+		H5Gclose(m_checkpointGroup);
+	}
+	m_checkpointGroup = -1;
+	m_checkpoint = SCAN_CHECKPOINT{};
+}
+
+void StorageWrapper::setSpool(bool enabled) {
+	if (enabled && !openSpool()) {
+		std::string info = "The spool could not be created, the payloads are queued in memory.";
+		qWarning(logWarning()) << info.c_str();
+		enabled = false;
+	}
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	m_spooling = enabled;
+}
+
+bool StorageWrapper::openSpool() {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	if (m_spool != nullptr) {
+		return true;
+	}
+	// the spool can only be converted into a writable file
+	if (m_file < 0) {
+		return false;
+	}
+	auto spool = std::make_unique<PayloadSpool>(m_spoolPath);
+	if (!spool->open()) {
+		return false;
+	}
+	m_spool = std::move(spool);
+	return true;
+}
+
+/*
+ * Appends the payload to the spool and deletes it.
+ * Returns false if the payload has to be queued in memory.
+ */
+template<typename T>
+bool StorageWrapper::spool(T* payload) {
+	{
+		std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+		if (!m_spooling || payload->rank > 4) {
+			return false;
+		}
+	}
+	if (!m_spool->append(spoolRecord(payload), payload->data.data())) {
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+		m_statistics.queueDepth++;
+		m_statistics.peakQueueDepth = simplemath::max<int>({ m_statistics.peakQueueDepth, m_statistics.queueDepth });
+	}
+	recycle(payload);
+	delete payload;
+	QMetaObject::invokeMethod(this, "s_writeQueues", Qt::QueuedConnection);
+	return true;
+}
+
+/*
+ * Moves spooled payloads back into the queues, as long as the memory limit allows.
+ */
+void StorageWrapper::restoreFromSpool() {
+	PayloadSpool* spool{ nullptr };
+	{
+		std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+		spool = m_spool.get();
+	}
+	if (spool == nullptr) {
+		return;
+	}
+
+	SPOOL_RECORD record;
+	while (true) {
+		{
+			std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+			if (m_abort || m_statistics.bytesInFlight >= m_memoryLimit) {
+				return;
+			}
+		}
+		const unsigned char* data = spool->next(record);
+		if (data == nullptr) {
+			return;
+		}
+
+		auto dims = std::make_unique<hsize_t[]>(4);
+		std::copy(std::begin(record.dims), std::end(record.dims), dims.get());
+		std::string date(record.date, strnlen(record.date, sizeof(record.date)));
+		std::string text(record.text, strnlen(record.text, sizeof(record.text)));
+
+		switch (record.type) {
+			case SPOOL_PAYLOAD::IMAGE: {
+				std::vector<unsigned short> buffer = m_imagePool.getBuffer(record.dataBytes / sizeof(unsigned short));
+				memcpy(buffer.data(), data, record.dataBytes);
+				IMAGE* img = new IMAGE(record.indices[0], record.indices[1], record.indices[2], record.rank, dims.get(), date, std::move(buffer));
+				restore(m_payloadQueueBrillouin, img, record.sequence, std::move(dims));
+				break;
+			}
+			case SPOOL_PAYLOAD::ODTIMAGE: {
+				std::vector<unsigned char> buffer = m_brightfieldPool.getBuffer(record.dataBytes);
+				memcpy(buffer.data(), data, record.dataBytes);
+				ODTIMAGE* img = new ODTIMAGE(record.indices[0], record.rank, dims.get(), date, std::move(buffer));
+				restore(m_payloadQueueODT, img, record.sequence, std::move(dims));
+				break;
+			}
+			case SPOOL_PAYLOAD::FLUOIMAGE: {
+				std::vector<unsigned char> buffer = m_brightfieldPool.getBuffer(record.dataBytes);
+				memcpy(buffer.data(), data, record.dataBytes);
+				FLUOIMAGE* img = new FLUOIMAGE(record.indices[0], record.rank, dims.get(), date, text, std::move(buffer));
+				restore(m_payloadQueueFluorescence, img, record.sequence, std::move(dims));
+				break;
+			}
+			case SPOOL_PAYLOAD::CALIBRATION: {
+				std::vector<unsigned short> buffer = m_imagePool.getBuffer(record.dataBytes / sizeof(unsigned short));
+				memcpy(buffer.data(), data, record.dataBytes);
+				CALIBRATION* cal = new CALIBRATION(record.indices[0], std::move(buffer), record.rank, dims.get(), text, record.shift, date);
+				restore(m_calibrationQueue, cal, record.sequence, std::move(dims));
+				break;
+			}
+		}
+	}
+}
+
+template<typename T>
+void StorageWrapper::restore(QQueue<T*>& queue, T* payload, uint64_t sequence, std::unique_ptr<hsize_t[]> dims) {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	SPOOLED_PAYLOAD& spooled = m_spooledPayloads[payload];
+	spooled.sequence = sequence;
+	spooled.dims = std::move(dims);
+
+	compress(payload);
+	queue.enqueue(payload);
+	// the payload was already counted in the queue depth when it was spooled
+	m_statistics.bytesInFlight += payloadSize(payload);
+	m_statistics.peakBytesInFlight = simplemath::max<size_t>({ m_statistics.peakBytesInFlight, m_statistics.bytesInFlight });
+}
+
+// marks the record of a restored payload as converted once it is written
+void StorageWrapper::finishSpooled(const void* payload) {
+	uint64_t sequence{ 0 };
+	{
+		std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+		auto spooled = m_spooledPayloads.find(payload);
+		if (spooled == m_spooledPayloads.end()) {
+			return;
+		}
+		sequence = spooled->second.sequence;
+		m_spooledPayloads.erase(spooled);
+	}
+	m_spool->markConverted(sequence);
+}
+
+bool StorageWrapper::isSpoolPending() {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	return !m_abort && m_spool != nullptr && m_spool->hasPending();
+}
+
+void StorageWrapper::recycle(IMAGE* img) {
+	m_imagePool.reclaim(img->data);
+}
+
+void StorageWrapper::recycle(ODTIMAGE* img) {
+	m_brightfieldPool.reclaim(img->data);
+}
+
+void StorageWrapper::recycle(FLUOIMAGE* img) {
+	m_brightfieldPool.reclaim(img->data);
+}
+
+void StorageWrapper::recycle(CALIBRATION* cal) {
+	m_imagePool.reclaim(cal->data);
+}
+
+std::string StorageWrapper::repetitionGroup(ACQUISITION_MODE mode) {
+	return modeGroup(mode) + "/repetitions/" + std::to_string(m_repetitions[mode]);
+}
+
+void StorageWrapper::removeFromQueue(size_t bytes, double duration) {
+	std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+	m_statistics.queueDepth--;
+	m_statistics.bytesInFlight -= bytes;
+	m_statistics.writtenBytes += bytes;
+	m_statistics.writeDuration += duration;
+	m_queueChanged.notify_all();
+}
+
+void StorageWrapper::setComment(std::string comment) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	H5BM::setComment(comment);
+}
+
+void StorageWrapper::setResolution(std::string direction, int resolution) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	H5BM::setResolution(direction, resolution);
+	m_resolution[direction] = resolution;
+}
+
+int StorageWrapper::getResolution(std::string direction) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	return H5BM::getResolution(direction);
+}
+
+void StorageWrapper::setPositions(std::string direction, const int rank, const hsize_t* dims, std::function<double(hsize_t)> position) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	if (m_file < 0 || rank < 1) {
+		return;
+	}
+	std::string name = repetitionGroup(ACQUISITION_MODE::BRILLOUIN) + "/payload/positions-" + direction;
+	hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+	hid_t dataset = ChunkCompressor::createDataset(m_file, name, H5T_NATIVE_DOUBLE, properties, rank, dims);
+	H5Pclose(properties);
+	if (dataset < 0) {
+		std::string info = "The positions in " + direction + "-direction could not be written.";
+		qWarning(logWarning()) << info.c_str();
+		return;
+	}
+
+	/*
+	 * A slab consists of whole rows of the innermost dimensions and a part of the next outer one,
+	 * so it is a hyperslab of the dataset and contiguous in row-major order.
+	 */
+	constexpr hsize_t slabSize{ 65536 };
+	int split{ rank - 1 };
+	hsize_t rowSize{ dims[rank - 1] };
+	while (split > 0 && rowSize * dims[split - 1] <= slabSize) {
+		rowSize *= dims[split - 1];
+		split--;
+	}
+	std::vector<hsize_t> strides(rank, 1);
+	for (gsl::index i{ rank - 2 }; i >= 0; i--) {
+		strides[i] = strides[i + 1] * dims[i + 1];
+	}
+	hsize_t total = strides[0] * dims[0];
+
+	std::vector<double> slab;
+	slab.reserve((size_t)simplemath::min<hsize_t>({ total, simplemath::max<hsize_t>({ slabSize, rowSize }) }));
+	std::vector<hsize_t> start(rank, 0);
+	std::vector<hsize_t> count(dims, dims + rank);
+	hid_t fileSpace = H5Dget_space(dataset);
+	hsize_t first{ 0 };
+	while (first < total) {
+		hsize_t slabLength{ total };
+		if (split > 0) {
+			for (gsl::index i{ 0 }; i < split; i++) {
+				start[i] = (first / strides[i]) % dims[i];
+				count[i] = 1;
+			}
+			// as many rows as fit, but not beyond the end of the next outer dimension
+			count[split - 1] = simplemath::min<hsize_t>({ simplemath::max<hsize_t>({ slabSize / rowSize, 1 }), dims[split - 1] - start[split - 1] });
+			slabLength = count[split - 1] * rowSize;
+		}
+		slab.resize((size_t)slabLength);
+		for (hsize_t i{ 0 }; i < slabLength; i++) {
+			slab[i] = position(first + i);
+		}
+		H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start.data(), nullptr, count.data(), nullptr);
+		hid_t memorySpace = H5Screate_simple(1, &slabLength, nullptr);
+		H5Dwrite(dataset, H5T_NATIVE_DOUBLE, memorySpace, fileSpace, H5P_DEFAULT, slab.data());
+		H5Sclose(memorySpace);
+		first += slabLength;
+	}
+	H5Sclose(fileSpace);
+	H5Dclose(dataset);
+}
+
+void StorageWrapper::setPhaseTiming(ACQUISITION_MODE mode, const PHASE_TIMING& timing) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	if (m_file < 0) {
+		return;
+	}
+	std::string name = repetitionGroup(mode) + "/timing";
+	// a resumed repetition replaces the timing of the interrupted one
+	if (H5Lexists(m_file, repetitionGroup(mode).c_str(), H5P_DEFAULT) > 0 && H5Lexists(m_file, name.c_str(), H5P_DEFAULT) > 0) {
+		H5Ldelete(m_file, name.c_str(), H5P_DEFAULT);
+	}
+	hid_t linkProperties = H5Pcreate(H5P_LINK_CREATE);
+	H5Pset_create_intermediate_group(linkProperties, 1);
+	hid_t group = H5Gcreate2(m_file, name.c_str(), linkProperties, H5P_DEFAULT, H5P_DEFAULT);
+	H5Pclose(linkProperties);
+	if (group < 0) {
+		return;
+	}
+
+	constexpr size_t phaseNumber = (size_t)ACQUISITION_PHASE::COUNT;
+	std::string names;
+	for (const auto& phaseName : PHASE_TIMING::names()) {
+		names += phaseName + ", ";
+	}
+	writeAttribute(group, "phases", names.substr(0, names.size() - 2));
+	std::array<int, phaseNumber> count;
+	std::array<double, phaseNumber> total, mean, median, p99, max;
+	std::vector<int> histogram;
+	for (gsl::index i{ 0 }; i < (gsl::index)phaseNumber; i++) {
+		const PHASE_STATISTICS& phase = timing.phases[i];
+		count[i] = phase.count;
+		total[i] = phase.total;
+		mean[i] = phase.mean;
+		median[i] = phase.median;
+		p99[i] = phase.p99;
+		max[i] = phase.max;
+		histogram.insert(histogram.end(), phase.histogram.begin(), phase.histogram.end());
+	}
+	writeAttribute(group, "count", count);
+	writeAttribute(group, "total", total);
+	writeAttribute(group, "mean", mean);
+	writeAttribute(group, "median", median);
+	writeAttribute(group, "p99", p99);
+	writeAttribute(group, "max", max);
+	writeAttribute(group, "unit", std::string("s"));
+
+	// bin i of the histogram holds the durations from 2^i to 2^(i+1) us
+	hsize_t dims[2] = { phaseNumber, PHASE_HISTOGRAM_BINS };
+	hid_t dataset = ChunkCompressor::createDataset(group, "histogram", H5T_NATIVE_INT, H5P_DEFAULT, 2, dims);
+	if (dataset >= 0) {
+		H5Dwrite(dataset, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, histogram.data());
+		H5Dclose(dataset);
+	}
+	H5Gclose(group);
+}
+
+void StorageWrapper::newRepetition(ACQUISITION_MODE mode) {
+	std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+	H5BM::newRepetition(mode);
+	if (mode == ACQUISITION_MODE::BRILLOUIN) {
+		closeScan();
+		closeCheckpoint();
+	}
+	// the new repetition is appended to the ones already in the file
+	selectLastRepetition(mode);
+}
+
+void StorageWrapper::selectLastRepetition(ACQUISITION_MODE mode) {
+	int count{ 0 };
+	std::string repetitions = modeGroup(mode) + "/repetitions";
+	if (m_file >= 0 && H5Lexists(m_file, modeGroup(mode).c_str(), H5P_DEFAULT) > 0
+		&& H5Lexists(m_file, repetitions.c_str(), H5P_DEFAULT) > 0) {
+		H5G_info_t info;
+		if (H5Gget_info_by_name(m_file, repetitions.c_str(), &info, H5P_DEFAULT) >= 0) {
+			count = (int)info.nlinks;
+		}
+	}
+	m_repetitions[mode] = simplemath::max<int>({ count - 1, 0 });
+}
+
+template<typename T, typename F>
+bool StorageWrapper::writeQueue(QQueue<T*>& queue, F write) {
+	while (true) {
+		T* payload{ nullptr };
+		{
+			std::lock_guard<std::mutex> lockGuard(m_queueMutex);
+			if (queue.isEmpty()) {
+				return true;
+			}
+			if (m_abort) {
+				m_finished = true;
+				m_queueChanged.notify_all();
+				return false;
+			}
+			payload = queue.dequeue();
+		}
+		size_t bytes = payloadSize(payload);
+
+		QElapsedTimer writeTimer;
+		writeTimer.start();
+		{
+			std::lock_guard<std::mutex> lockGuard(m_fileMutex);
+			write(payload);
+		}
+		double duration = 1e-9 * writeTimer.nsecsElapsed();
+
+		finishSpooled(payload);
+		// the dimensions are released before the payload, whose address could be reused right away
+		releaseDimensions(payload);
+		delete payload;
+		payload = nullptr;
+		removeFromQueue(bytes, duration);
+	}
+}
+
 void StorageWrapper::s_writeQueues() {
-	while (!m_payloadQueueBrillouin.isEmpty()) {
-		if (m_abort) {
-			m_finished = true;
+	// the spooled payloads are converted in batches which fit into the memory limit
+	do {
+		restoreFromSpool();
+		if (!writeQueues()) {
 			return;
 		}
-		IMAGE *img = m_payloadQueueBrillouin.dequeue();
-		setPayloadData(img);
-		//std::string info = "Image written " + std::to_string(m_writtenImagesNr);
-		//qInfo(logInfo()) << info.c_str();
-		m_writtenImagesNr++;
-		delete img;
-		img = nullptr;
+	} while (isSpoolPending());
+}
+
+bool StorageWrapper::writeQueues() {
+	bool completed = writeQueue(m_metadataQueue, [this](PAYLOAD_METADATA* metadata) {
+		writeMetadata(metadata);
+	});
+	if (!completed) {
+		return false;
 	}
 
-	while (!m_payloadQueueODT.isEmpty()) {
-		if (m_abort) {
-			m_finished = true;
+	completed = writeQueue(m_payloadQueueBrillouin, [this](IMAGE* img) {
+		bool packed = takePacked(img);
+		if (writeScanPoint(img, packed)) {
+			m_writtenImagesNr++;
+			m_checkpoint.writtenPositions++;
+			writeCheckpointProgress();
+			recycle(img);
 			return;
 		}
-		ODTIMAGE *img = m_payloadQueueODT.dequeue();
-		setPayloadData(img);
-		//std::string info = "Image written " + std::to_string(m_writtenImagesNr);
-		//qInfo(logInfo()) << info.c_str();
+		// position of the image in the scan
+		int index = (img->indZ * m_resolution["y"] + img->indY) * m_resolution["x"] + img->indX;
+		std::string name = repetitionGroup(ACQUISITION_MODE::BRILLOUIN) + "/payload/data/" + std::to_string(index);
+		hid_t dataset = packed ? writePacked(img, name) : writeCompressed(img, H5T_NATIVE_USHORT, name);
+		if (dataset < 0) {
+			// h5bm only writes 16 bit images
+			if (packed) {
+				unpack(img);
+			}
+			setPayloadData(img);
+		} else {
+			writeAttribute(dataset, "date", img->date);
+			writeAttribute(dataset, "indX", (int)img->indX);
+			writeAttribute(dataset, "indY", (int)img->indY);
+			writeAttribute(dataset, "indZ", (int)img->indZ);
+			H5Dclose(dataset);
+		}
 		m_writtenImagesNr++;
-		delete img;
-		img = nullptr;
+		m_checkpoint.writtenPositions++;
+		writeCheckpointProgress();
+		recycle(img);
+	});
+	if (!completed) {
+		return false;
 	}
 
-	while (!m_payloadQueueFluorescence.isEmpty()) {
-		if (m_abort) {
-			m_finished = true;
-			return;
+	completed = writeQueue(m_payloadQueueODT, [this](ODTIMAGE* img) {
+		hid_t dataset = writeCompressed(img, H5T_NATIVE_UCHAR,
+			repetitionGroup(ACQUISITION_MODE::ODT) + "/payload/data/" + std::to_string(img->ind));
+		if (dataset < 0) {
+			setPayloadData(img);
+		} else {
+			writeAttribute(dataset, "date", img->date);
+			H5Dclose(dataset);
 		}
-		FLUOIMAGE *img = m_payloadQueueFluorescence.dequeue();
-		setPayloadData(img);
-		//std::string info = "Image written " + std::to_string(m_writtenImagesNr);
-		//qInfo(logInfo()) << info.c_str();
 		m_writtenImagesNr++;
-		delete img;
-		img = nullptr;
+		recycle(img);
+	});
+	if (!completed) {
+		return false;
 	}
 
-	while (!m_calibrationQueue.isEmpty()) {
-		if (m_abort) {
-			m_finished = true;
-			return;
+	completed = writeQueue(m_payloadQueueFluorescence, [this](FLUOIMAGE* img) {
+		hid_t dataset = writeCompressed(img, H5T_NATIVE_UCHAR,
+			repetitionGroup(ACQUISITION_MODE::FLUORESCENCE) + "/payload/data/" + std::to_string(img->ind));
+		if (dataset < 0) {
+			setPayloadData(img);
+		} else {
+			writeAttribute(dataset, "date", img->date);
+			writeAttribute(dataset, "channel", img->channel);
+			H5Dclose(dataset);
 		}
-		CALIBRATION *cal = m_calibrationQueue.dequeue();
-		setCalibrationData(cal->index, cal->data, cal->rank, cal->dims, cal->sample, cal->shift, cal->date);
-		//std::string info = "Calibration written " + std::to_string(m_writtenCalibrationsNr);
-		//qInfo(logInfo()) << info.c_str();
-		m_writtenCalibrationsNr++;
-		delete cal;
-		cal = nullptr;
+		m_writtenImagesNr++;
+		recycle(img);
+	});
+	if (!completed) {
+		return false;
 	}
+
+	return writeQueue(m_calibrationQueue, [this](CALIBRATION* cal) {
+		hid_t dataset = writeCompressed(cal, H5T_NATIVE_USHORT,
+			repetitionGroup(ACQUISITION_MODE::BRILLOUIN) + "/calibration/calibrationData/" + std::to_string(cal->index));
+		if (dataset < 0) {
+			setCalibrationData(cal->index, cal->data, cal->rank, cal->dims, cal->sample, cal->shift, cal->date);
+		} else {
+			writeAttribute(dataset, "date", cal->date);
+			writeAttribute(dataset, "sample", cal->sample);
+			writeAttribute(dataset, "shift", (double)cal->shift);
+			H5Dclose(dataset);
+		}
+		m_writtenCalibrationsNr++;
+		m_checkpoint.calibrations = simplemath::max<int>({ m_checkpoint.calibrations, cal->index });
+		// a calibration index must never be written twice
+		writeCheckpointProgress(true);
+		recycle(cal);
+	});
 }
\ No newline at end of file
@@ -2,6 +2,20 @@
 #define STORAGEWRAPPER_H
 
 #include "external/h5bm/h5bm.h"
+#include "thread.h"
+#include "payloadPool.h"
+#include "compression.h"
+#include "payloadSpool.h"
+#include "phaseTiming.h"
+#include "frameHeader.h"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 class StoragePath {
 public:
@@ -16,6 +30,57 @@ public:
 	}
 };
 
+enum class STORAGE_LAYOUT {
+	H5BM,		// one dataset per scan point, as written by h5bm
+	HYPERSLAB	// one preallocated dataset per Brillouin repetition, every scan point is a hyperslab
+};
+
+struct SCAN_DATASETS {
+	hid_t images{ -1 };					// images of all points (z, x, y, frame, height, width)
+	hid_t dates{ -1 };					// acquisition date of every point
+	hid_t order{ -1 };					// position of every point in the acquisition order
+	std::vector<hsize_t> dims;			// [pix] dimensions of the images dataset
+	std::vector<hsize_t> chunkShape;	// [pix] chunk extent of the images dataset
+	COMPRESSION_SETTINGS compression;	// compression the images dataset was created with
+	bool packed{ false };				//		the images are stored as Mono12Packed bytes
+	int writtenPoints{ 0 };				// [1]	number of points written so far
+};
+
+/*
+ * Progress of a Brillouin repetition, stored in the file while it is written,
+ * so an interrupted repetition can be resumed at the first position not written.
+ */
+struct SCAN_CHECKPOINT {
+	bool valid{ false };				//		the checkpoint belongs to a repetition which can be resumed
+	std::array<double, 3> min{};		// [m]	first position along x, y and z
+	std::array<double, 3> max{};		// [m]	last position along x, y and z
+	std::array<int, 3> steps{};			// [1]	number of positions along x, y and z
+	std::array<int, 3> order{};			// [1]	scan direction of x, y and z, the fastest is 0
+	int trajectory{ 0 };				//		order in which the positions are visited
+	std::array<double, 3> origin{};		// [m]	stage position the scan is relative to
+	std::array<int, 3> frameDims{};		// [pix]	frame count, height and width of the images
+	int writtenPositions{ 0 };			// [1]	number of positions written, in the order they are visited
+	int calibrations{ 0 };				// [1]	index of the last calibration written
+};
+
+// metadata of the frames of a payload
+struct PAYLOAD_METADATA {
+	ACQUISITION_MODE mode{ ACQUISITION_MODE::NONE };
+	std::array<int, 3> indices{};		// [1]	indices of the payload, x, y and z for Brillouin images
+	std::vector<FRAME_METADATA> frames;
+};
+
+struct STORAGE_STATISTICS {
+	int queueDepth{ 0 };				// [1]		number of payloads waiting to be written
+	int peakQueueDepth{ 0 };			// [1]		maximum number of payloads waiting at once
+	size_t bytesInFlight{ 0 };			// [byte]	memory held by the queued payloads
+	size_t peakBytesInFlight{ 0 };		// [byte]	maximum memory held by the queued payloads
+	unsigned long long writtenBytes{ 0 };	// [byte]	payload data written to the file
+	double writeDuration{ 0 };			// [s]		time spent writing to the file
+	double throughput{ 0 };				// [MB/s]	write throughput of the file
+	double blockedDuration{ 0 };		// [s]		time the acquisition waited for the memory limit
+};
+
 class StorageWrapper : public H5BM {
 	Q_OBJECT
 private:
@@ -23,33 +88,199 @@ private:
 	bool m_observeQueues = false;
 	bool m_finishedQueueing = false;
 
+	// the file is written on its own thread, so HDF5 latency does not stall the acquisition
+	Thread m_writerThread;
+	// guards all access to the HDF5 file
+	std::mutex m_fileMutex;
+	// guards the queues and the statistics
+	std::mutex m_queueMutex;
+	std::condition_variable m_queueChanged;
+
+	size_t m_memoryLimit{ (size_t)1 << 30 };	// [byte]	maximum memory held by the queued payloads
+	STORAGE_STATISTICS m_statistics;
+
+	// second handle to the file for the datasets the storage creates itself
+	hid_t m_file{ -1 };
+	// index of the current repetition of every mode
+	std::map<ACQUISITION_MODE, int> m_repetitions;
+	// resolution of the current scan, used to name the datasets
+	std::map<std::string, int> m_resolution;
+
+	COMPRESSION_SETTINGS m_compression;
+	COMPRESSION_STATISTICS m_compressionStatistics;
+	CompressionPool m_compressionPool;
+	// results of the compression jobs of the queued payloads
+	std::unordered_map<const void*, std::shared_future<COMPRESSED_DATA>> m_compressedPayloads;
+
+	STORAGE_LAYOUT m_layout{ STORAGE_LAYOUT::H5BM };
+	SCAN_DATASETS m_scan;
+
+	// the Brillouin images are packed to 12 bit when they are queued
+	bool m_packing{ false };
+	std::unordered_set<const void*> m_packedPayloads;
+	void pack(IMAGE* img);
+	bool takePacked(const void* payload);
+	// dimensions of the packed bytes of the image
+	std::vector<hsize_t> packedDims(const IMAGE* img);
+	hid_t writePacked(IMAGE* img, const std::string& name);
+	void unpack(IMAGE* img);
+
+	SCAN_CHECKPOINT m_checkpoint;
+	hid_t m_checkpointGroup{ -1 };
+	void writeCheckpointProgress(bool flush = false);
+	void closeCheckpoint();
+
+	// the payloads are spooled to disk right away and converted to HDF5 in the background
+	std::string m_spoolPath;
+	std::unique_ptr<PayloadSpool> m_spool;
+	bool m_spooling{ false };
+	struct SPOOLED_PAYLOAD {
+		uint64_t sequence{ 0 };
+		std::unique_ptr<hsize_t[]> dims;	// the restored payload references these dimensions
+	};
+	std::unordered_map<const void*, SPOOLED_PAYLOAD> m_spooledPayloads;
+
+	// the queued payloads reference their own copy of the dimensions, so the caller's may go out of scope
+	std::unordered_map<const void*, std::unique_ptr<hsize_t[]>> m_payloadDims;
+	template<typename T>
+	void copyDimensions(T* payload);
+	void releaseDimensions(const void* payload);
+
+	template<typename T>
+	void enqueue(QQueue<T*>& queue, T* payload);
+	template<typename T, typename F>
+	bool writeQueue(QQueue<T*>& queue, F write);
+	void removeFromQueue(size_t bytes, double duration);
+
+	template<typename T>
+	void compress(T* payload);
+	template<typename T>
+	hid_t writeCompressed(T* payload, hid_t type, const std::string& name);
+	std::shared_future<COMPRESSED_DATA> takeCompressed(const void* payload);
+	bool writeScanPoint(IMAGE* img, bool packed);
+	void closeScan();
+
+	void selectLastRepetition(ACQUISITION_MODE mode);
+
+	bool openSpool();
+	template<typename T>
+	bool spool(T* payload);
+	void restoreFromSpool();
+	template<typename T>
+	void restore(QQueue<T*>& queue, T* payload, uint64_t sequence, std::unique_ptr<hsize_t[]> dims);
+	void finishSpooled(const void* payload);
+	bool isSpoolPending();
+	bool writeQueues();
+
+	// return the data buffer of the payload to its pool
+	void recycle(IMAGE* img);
+	void recycle(ODTIMAGE* img);
+	void recycle(FLUOIMAGE* img);
+	void recycle(CALIBRATION* cal);
+	void addCompressionStatistics(size_t rawBytes, size_t compressedBytes, double duration);
+	std::string repetitionGroup(ACQUISITION_MODE mode);
+
+	// the metadata is counted in the queue depth, so it is written before waitForQueues() returns
+	QQueue<PAYLOAD_METADATA*> m_metadataQueue;
+	void enqueueMetadata(PAYLOAD_METADATA* metadata);
+	void writeMetadata(PAYLOAD_METADATA* metadata);
+
 public:
 	StorageWrapper(
 		QObject *parent = nullptr,
 		const std::string fullPath = StoragePath{}.fullPath(),//"./Brillouin.h5",
 		int flags = H5F_ACC_RDONLY
-	) noexcept : H5BM(parent, fullPath, flags) {};
+	);
 	~StorageWrapper();
 
 	QQueue<IMAGE*> m_payloadQueueBrillouin;
 	QQueue<ODTIMAGE*> m_payloadQueueODT;
 	QQueue<FLUOIMAGE*> m_payloadQueueFluorescence;
 	QQueue<CALIBRATION*> m_calibrationQueue;
-	bool m_abort = false;
+	std::atomic<bool> m_abort{ false };
+
+	// recycled data buffers, the writer returns them after a payload is written
+	PayloadPool<unsigned short> m_imagePool;
+	PayloadPool<unsigned char> m_brightfieldPool;
 
 	void startWritingQueues();
 	void stopWritingQueues();
+	// blocks until all queued payloads are written
+	void waitForQueues();
+	void logStatistics();
+
+	void setMemoryLimit(size_t bytes);
+	STORAGE_STATISTICS getStatistics();
+
+	// compresses the payloads on a worker pool before they are written
+	void setCompression(COMPRESSION_SETTINGS settings);
+	COMPRESSION_STATISTICS getCompressionStatistics();
+
+	void setLayout(STORAGE_LAYOUT layout);
+	STORAGE_LAYOUT getLayout();
+	/*
+	 * Preallocates the datasets of the current Brillouin repetition for the hyperslab layout.
+	 * Does nothing for the h5bm layout.
+	 */
+	void createScan(hsize_t zSteps, hsize_t xSteps, hsize_t ySteps, int rank, const hsize_t* dims);
+
+	/*
+	 * The checkpoint of the current Brillouin repetition is updated by the writer with every position.
+	 * readCheckpoint() returns the checkpoint of the last repetition, it is valid if the repetition
+	 * was not finished. resumeCheckpoint() selects this repetition again and continues updating it.
+	 */
+	void startCheckpoint(SCAN_CHECKPOINT checkpoint);
+	SCAN_CHECKPOINT readCheckpoint();
+	void resumeCheckpoint(SCAN_CHECKPOINT checkpoint);
+	void finishCheckpoint();
+
+	/*
+	 * Spools the payloads to a memory-mapped file next to the HDF5 file instead of keeping them in memory.
+	 * A spool left by an interrupted acquisition is converted when the file is opened again.
+	 */
+	void setSpool(bool enabled);
+
+	/*
+	 * Stores the Brillouin images as Mono12Packed, which takes 25% less memory in the queues and on disk.
+	 * The datasets get the attributes "encoding" and "width" of the unpacked images for decoding.
+	 * Only images with an even width are packed, spooled images are stored unpacked.
+	 */
+	void setPacking(bool enabled);
+	bool getPacking();
+
+	// these functions access the file and are synchronized with the writer thread
+	void setComment(std::string comment);
+	void setResolution(std::string direction, int resolution);
+	int getResolution(std::string direction);
+	/*
+	 * Writes the positions of the current Brillouin repetition along the direction.
+	 * position returns the position of an element in row-major order, the positions are generated
+	 * and written in slabs, so the memory needed does not scale with the number of positions.
+	 */
+	void setPositions(std::string direction, const int rank, const hsize_t* dims, std::function<double(hsize_t)> position);
+	void newRepetition(ACQUISITION_MODE mode);
+	// stores the durations of the acquisition phases of the current repetition of the mode
+	void setPhaseTiming(ACQUISITION_MODE mode, const PHASE_TIMING& timing);
 
-	int m_writtenImagesNr{ 0 };
-	int m_writtenCalibrationsNr{ 0 };
+	std::atomic<int> m_writtenImagesNr{ 0 };
+	std::atomic<int> m_writtenCalibrationsNr{ 0 };
 
 public slots:
+	void init() {};
 	void s_writeQueues();
 
+	// these functions are thread-safe and block while the memory limit is reached
 	void s_enqueuePayload(IMAGE*);
 	void s_enqueuePayload(ODTIMAGE*);
 	void s_enqueuePayload(FLUOIMAGE*);
 	void s_enqueueCalibration(CALIBRATION *cal);
+	/*
+	 * The metadata of the frames is stored in the numeric datasets "metadata/<field>" of the repetition,
+	 * one row per frame, the column "index" refers to the payload the frame belongs to.
+	 */
+	void s_enqueuePayload(IMAGE*, std::vector<FRAME_METADATA> metadata);
+	void s_enqueuePayload(ODTIMAGE*, std::vector<FRAME_METADATA> metadata);
+	void s_enqueuePayload(FLUOIMAGE*, std::vector<FRAME_METADATA> metadata);
 
 	void s_finishedQueueing();
 
@@ -57,4 +288,4 @@ signals:
 	void finished();
 };
 
-#endif //STORAGEWRAPPER_H
+#endif //STORAGEWRAPPER_H
\ No newline at end of file
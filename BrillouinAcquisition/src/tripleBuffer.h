@@ -0,0 +1,150 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QtCore>
+#include <gsl/gsl>
+#include <atomic>
+
+#include "frameArena.h"
+
+/*
+ * Lock-free "latest frame wins" buffer with three slots.
+ *
+ * The producer always writes into the back slot and swaps it with the middle slot on commitWrite().
+ * The consumer swaps the middle slot with the front slot on claimRead(), if a new frame was published.
+ * Neither side ever waits, a frame that is overwritten before the consumer got it is counted as dropped.
+ */
+template<class T> class TripleBuffer {
+
+public:
+	TripleBuffer() noexcept;
+	TripleBuffer(const int bufferSize);
+	// uses the given memory for the slots, it has to hold getMemorySize() bytes and outlive the buffer
+	TripleBuffer(const int bufferSize, unsigned char* memory);
+	~TripleBuffer();
+
+	T* claimWrite();
+	void commitWrite();
+	T* claimRead();
+	void releaseRead();
+
+	// header of the buffer returned by claimWrite() and claimRead()
+	FRAME_HEADER* getWriteHeader();
+	FRAME_HEADER* getReadHeader();
+
+	int getBufferSize() const;
+	unsigned long long getDroppedFrames() const;
+
+	static size_t getMemorySize(const int bufferSize);
+
+private:
+	// the middle slot index is combined with a flag marking whether it holds a frame the consumer has not seen yet
+	static constexpr unsigned char INDEX_MASK = 0x03;
+	static constexpr unsigned char NEW_FRAME = 0x04;
+
+	T* m_buffers[3]{ nullptr, nullptr, nullptr };
+	FRAME_HEADER* m_headers[3]{ nullptr, nullptr, nullptr };
+	const int m_bufferSize;
+	bool m_ownsMemory{ true };
+
+	// the back slot is only used by the producer, the front slot only by the consumer
+	unsigned char m_back{ 0 };
+	unsigned char m_front{ 2 };
+	std::atomic<unsigned char> m_middle{ 1 };
+
+	std::atomic<unsigned long long> m_droppedFrames{ 0 };
+};
+
+template<class T>
+inline TripleBuffer<T>::TripleBuffer() noexcept : m_bufferSize(0) {
+}
+
+template<class T>
+inline TripleBuffer<T>::TripleBuffer(const int bufferSize) : m_bufferSize(bufferSize) {
+	for (gsl::index i = 0; i < 3; i++) {
+		m_buffers[i] = new T[m_bufferSize]{};
+		m_headers[i] = new FRAME_HEADER;
+	}
+}
+
+template<class T>
+inline TripleBuffer<T>::TripleBuffer(const int bufferSize, unsigned char* memory) : m_bufferSize(bufferSize), m_ownsMemory(false) {
+	size_t slotSize = FrameArena::slotSize<T>(m_bufferSize);
+	for (gsl::index i = 0; i < 3; i++) {
+		// every slot starts with the frame header
+		m_headers[i] = new (memory + i * slotSize) FRAME_HEADER;
+		m_buffers[i] = reinterpret_cast<T*>(memory + i * slotSize + FRAME_HEADER_SIZE);
+	}
+}
+
+template<class T>
+inline TripleBuffer<T>::~TripleBuffer() {
+	if (!m_ownsMemory) {
+		return;
+	}
+	for (gsl::index i = 0; i < 3; i++) {
+		delete[] m_buffers[i];
+		delete m_headers[i];
+	}
+}
+
+template<class T>
+inline T * TripleBuffer<T>::claimWrite() {
+	return m_buffers[m_back];
+}
+
+template<class T>
+inline void TripleBuffer<T>::commitWrite() {
+	if (m_bufferSize == 0) {
+		return;
+	}
+	// publish the back slot and continue writing into the previous middle slot
+	unsigned char previous = m_middle.exchange(m_back | NEW_FRAME, std::memory_order_acq_rel);
+	if (previous & NEW_FRAME) {
+		// the consumer never saw the previous frame
+		m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+	}
+	m_back = previous & INDEX_MASK;
+}
+
+template<class T>
+inline T * TripleBuffer<T>::claimRead() {
+	// return immediately if there is no frame newer than the one already shown
+	if (m_bufferSize == 0 || !(m_middle.load(std::memory_order_relaxed) & NEW_FRAME)) {
+		return nullptr;
+	}
+	unsigned char previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+	m_front = previous & INDEX_MASK;
+	return m_buffers[m_front];
+}
+
+template<class T>
+inline void TripleBuffer<T>::releaseRead() {
+	// the front slot stays with the consumer until it claims the next frame
+}
+
+template<class T>
+inline FRAME_HEADER * TripleBuffer<T>::getWriteHeader() {
+	return m_headers[m_back];
+}
+
+template<class T>
+inline FRAME_HEADER * TripleBuffer<T>::getReadHeader() {
+	return m_headers[m_front];
+}
+
+template<class T>
+inline int TripleBuffer<T>::getBufferSize() const {
+	return m_bufferSize;
+}
+
+template<class T>
+inline unsigned long long TripleBuffer<T>::getDroppedFrames() const {
+	return m_droppedFrames.load(std::memory_order_relaxed);
+}
+
+template<class T>
+inline size_t TripleBuffer<T>::getMemorySize(const int bufferSize) {
+	return 3 * FrameArena::slotSize<T>(bufferSize);
+}
+#endif //TRIPLEBUFFER_H
\ No newline at end of file
@@ -0,0 +1,34 @@
+# qmake project to build the benchmarks on Linux, the Visual Studio project is used on Windows.
+#   qmake BrillouinAcquisitionBenchmark.pro && make
+#   ./BrillouinAcquisitionBenchmark storage image 1000 512 512
+
+QT += core gui widgets
+CONFIG += c++17 console release link_pkgconfig
+CONFIG -= app_bundle
+
+TARGET = BrillouinAcquisitionBenchmark
+
+INCLUDEPATH += . \
+	../BrillouinAcquisition \
+	../BrillouinAcquisition/src \
+	../BrillouinAcquisition/external/gsl/include
+
+PKGCONFIG += hdf5
+LIBS += -lhdf5_cpp -lz
+
+SOURCES += main.cpp \
+	circularBufferBenchmark.cpp \
+	packingBenchmark.cpp \
+	storageBenchmark.cpp \
+	../BrillouinAcquisition/external/h5bm/h5bm.cpp \
+	../BrillouinAcquisition/src/compression.cpp \
+	../BrillouinAcquisition/src/logger.cpp \
+	../BrillouinAcquisition/src/payloadSpool.cpp \
+	../BrillouinAcquisition/src/pixelPacking.cpp \
+	../BrillouinAcquisition/src/storageWrapper.cpp
+
+HEADERS += benchmarks.h \
+	../BrillouinAcquisition/src/pixelPacking.h \
+	../BrillouinAcquisition/external/h5bm/h5bm.h \
+	../BrillouinAcquisition/src/storageWrapper.h \
+	../BrillouinAcquisition/src/thread.h
\ No newline at end of file
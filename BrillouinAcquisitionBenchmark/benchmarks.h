@@ -0,0 +1,78 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+struct BENCHMARK_RESULT {
+	std::string name;
+	int frameCount{ 0 };
+	double duration{ 0 };			// [s]	total duration
+	std::vector<double> latencies;	// [us]	latency of every frame
+
+	BENCHMARK_RESULT(std::string name, int frameCount, double duration, std::vector<double> latencies) :
+		name(name), frameCount(frameCount), duration(duration), latencies(latencies) {};
+
+	double framesPerSecond() const {
+		return (duration > 0) ? frameCount / duration : 0;
+	};
+
+	// returns the requested percentile of the latencies
+	double percentile(double percent) const {
+		if (latencies.empty()) {
+			return 0;
+		}
+		std::vector<double> sorted = latencies;
+		std::sort(sorted.begin(), sorted.end());
+		size_t index = std::min(sorted.size() - 1, (size_t)(percent / 100 * sorted.size()));
+		return sorted[index];
+	};
+
+	void print() const {
+		std::cout << std::fixed << std::setprecision(1)
+			<< "  " << std::setw(12) << std::left << name << std::right
+			<< std::setw(10) << framesPerSecond() << " fps"
+			<< "   latency p50 " << std::setw(10) << percentile(50) << " us"
+			<< "   p99 " << std::setw(10) << percentile(99) << " us"
+			<< "   max " << std::setw(10) << percentile(100) << " us" << std::endl;
+	};
+};
+
+struct BUFFER_BENCHMARK_SETTINGS {
+	int width{ 2048 };			// [pix]	frame width
+	int height{ 2048 };			// [pix]	frame height
+	int frameCount{ 500 };		// [1]		number of frames to hand over
+	int bufferNumber{ 4 };		// [1]		number of buffers in the ring
+	int consumerDelay{ 0 };		// [us]		time the consumer needs per frame, e.g. for plotting
+	int retryDelay{ 50 };		// [ms]		retry delay of the semaphore based producer
+};
+
+void benchmarkCircularBuffer(BUFFER_BENCHMARK_SETTINGS settings);
+
+struct STORAGE_BENCHMARK_SETTINGS {
+	std::string payload{ "image" };			// image, odt, fluorescence, calibration or mixed
+	int width{ 512 };						// [pix]	ROI width
+	int height{ 512 };						// [pix]	ROI height
+	int frameCount{ 1000 };					// [1]		number of payloads to store
+	double rate{ 0 };						// [Hz]		payload rate, 0 enqueues as fast as possible
+	std::string layout{ "h5bm" };			// h5bm or hyperslab
+	std::string compression{ "none" };		// none, deflate or lz4
+	bool spool{ false };					// spool the payloads before converting them to HDF5
+	std::string path{ "storageBenchmark.h5" };
+	bool packing{ false };					// store the images as Mono12Packed
+};
+
+void benchmarkStorage(STORAGE_BENCHMARK_SETTINGS settings);
+
+struct PACKING_BENCHMARK_SETTINGS {
+	int width{ 2048 };			// [pix]	frame width
+	int height{ 2048 };			// [pix]	frame height
+	int frameCount{ 100 };		// [1]		number of frames to convert per kernel
+};
+
+void benchmarkPacking(PACKING_BENCHMARK_SETTINGS settings);
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,139 @@
+#include "stdafx.h"
+#include "benchmarks.h"
+#include "../BrillouinAcquisition/src/circularBuffer.h"
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+
+/*
+ * Copy of the semaphore based circular buffer the lock-free ring replaced.
+ * It is only kept here to have a baseline to compare against.
+ */
+template<class T> class SemaphoreCircularBuffer {
+
+public:
+	SemaphoreCircularBuffer(const int bufferNumber, const int bufferSize) : m_bufferNumber(bufferNumber), m_bufferSize(bufferSize),
+		m_freeBuffers(new QSemaphore(bufferNumber)) {
+		m_buffers = new T*[m_bufferNumber];
+		for (gsl::index i = 0; i < m_bufferNumber; i++) {
+			m_buffers[i] = new T[m_bufferSize]{};
+		}
+	};
+	~SemaphoreCircularBuffer() {
+		for (gsl::index i = 0; i < m_bufferNumber; i++) {
+			delete[] m_buffers[i];
+		}
+		delete[] m_buffers;
+		delete m_freeBuffers;
+		delete m_usedBuffers;
+	};
+
+	T* getWriteBuffer() {
+		return m_buffers[m_writeCount++ % m_bufferNumber];
+	};
+	T* getReadBuffer() {
+		return m_buffers[m_readCount++ % m_bufferNumber];
+	};
+
+	QSemaphore* m_freeBuffers;
+	QSemaphore* m_usedBuffers = new QSemaphore;
+
+	T** m_buffers;
+
+private:
+	const int m_bufferSize;
+	const int m_bufferNumber;
+	unsigned int m_writeCount = 0;
+	unsigned int m_readCount = 0;
+};
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	// writes the current time into the first bytes of the frame, so the consumer can calculate the handoff latency
+	void stampFrame(unsigned char* frame, const std::vector<unsigned char>& source) {
+		memcpy(frame, source.data(), source.size());
+		int64_t now = Clock::now().time_since_epoch().count();
+		memcpy(frame, &now, sizeof(now));
+	}
+
+	double readStamp(unsigned char* frame) {
+		int64_t stamp{ 0 };
+		memcpy(&stamp, frame, sizeof(stamp));
+		return std::chrono::duration<double, std::micro>(Clock::duration(Clock::now().time_since_epoch().count() - stamp)).count();
+	}
+
+	BENCHMARK_RESULT runLegacy(const BUFFER_BENCHMARK_SETTINGS& settings, const std::vector<unsigned char>& source) {
+		SemaphoreCircularBuffer<unsigned char> buffer(settings.bufferNumber, (int)source.size());
+		std::vector<double> latencies;
+		latencies.reserve(settings.frameCount);
+
+		auto start = Clock::now();
+		// the producer behaves like Camera::getImageForPreview did before
+		std::thread producer([&] {
+			for (gsl::index i{ 0 }; i < settings.frameCount; i++) {
+				while (!buffer.m_freeBuffers->tryAcquire()) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(settings.retryDelay));
+				}
+				stampFrame(buffer.getWriteBuffer(), source);
+				buffer.m_usedBuffers->release();
+			}
+		});
+		// the consumer behaves like BrillouinAcquisition::updateImage did before
+		for (gsl::index i{ 0 }; i < settings.frameCount; i++) {
+			while (!buffer.m_usedBuffers->tryAcquire()) {
+				std::this_thread::yield();
+			}
+			latencies.push_back(readStamp(buffer.getReadBuffer()));
+			std::this_thread::sleep_for(std::chrono::microseconds(settings.consumerDelay));
+			buffer.m_freeBuffers->release();
+		}
+		producer.join();
+		double duration = std::chrono::duration<double>(Clock::now() - start).count();
+
+		return BENCHMARK_RESULT("semaphore", settings.frameCount, duration, latencies);
+	}
+
+	BENCHMARK_RESULT runLockFree(const BUFFER_BENCHMARK_SETTINGS& settings, const std::vector<unsigned char>& source) {
+		CircularBuffer<unsigned char> buffer(settings.bufferNumber, (int)source.size());
+		std::vector<double> latencies;
+		latencies.reserve(settings.frameCount);
+
+		auto start = Clock::now();
+		std::thread producer([&] {
+			for (gsl::index i{ 0 }; i < settings.frameCount; i++) {
+				unsigned char* frame{ nullptr };
+				while ((frame = buffer.claimWrite()) == nullptr) {
+					std::this_thread::yield();
+				}
+				stampFrame(frame, source);
+				buffer.commitWrite();
+			}
+		});
+		for (gsl::index i{ 0 }; i < settings.frameCount; i++) {
+			unsigned char* frame{ nullptr };
+			while ((frame = buffer.claimRead()) == nullptr) {
+				std::this_thread::yield();
+			}
+			latencies.push_back(readStamp(frame));
+			std::this_thread::sleep_for(std::chrono::microseconds(settings.consumerDelay));
+			buffer.releaseRead();
+		}
+		producer.join();
+		double duration = std::chrono::duration<double>(Clock::now() - start).count();
+
+		return BENCHMARK_RESULT("lock-free", settings.frameCount, duration, latencies);
+	}
+}
+
+void benchmarkCircularBuffer(BUFFER_BENCHMARK_SETTINGS settings) {
+	// Mono16 frame of the requested size
+	std::vector<unsigned char> source(2 * (size_t)settings.width * settings.height, 0);
+
+	std::cout << "Circular buffer handoff, " << settings.width << "x" << settings.height << " Mono16, "
+		<< settings.frameCount << " frames, " << settings.bufferNumber << " buffers" << std::endl;
+
+	runLegacy(settings, source).print();
+	runLockFree(settings, source).print();
+}
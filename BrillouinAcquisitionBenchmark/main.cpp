@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "benchmarks.h"
+
+/*
+ * Micro-benchmarks for the performance critical parts of BrillouinAcquisition,
+ * they run without any hardware attached.
+ *
+ * Usage: BrillouinAcquisitionBenchmark <benchmark> [options]
+ *   circularBuffer [frames] [width] [height] [consumer delay in us]
+ *   storage [image|odt|fluorescence|calibration|mixed] [frames] [width] [height] [rate in Hz]
+ *           [h5bm|hyperslab] [none|deflate|lz4] [spool|nospool] [file] [packed|unpacked]
+ *   packing [frames] [width] [height]
+ */
+int main(int argc, char *argv[]) {
+	QCoreApplication a(argc, argv);
+	QStringList arguments = a.arguments();
+
+	QString benchmark = (arguments.size() > 1) ? arguments[1] : "circularBuffer";
+
+	if (benchmark == "circularBuffer") {
+		BUFFER_BENCHMARK_SETTINGS settings;
+		if (arguments.size() > 2) {
+			settings.frameCount = arguments[2].toInt();
+		}
+		if (arguments.size() > 3) {
+			settings.width = arguments[3].toInt();
+		}
+		if (arguments.size() > 4) {
+			settings.height = arguments[4].toInt();
+		}
+		if (arguments.size() > 5) {
+			settings.consumerDelay = arguments[5].toInt();
+		}
+		benchmarkCircularBuffer(settings);
+	} else if (benchmark == "storage") {
+		STORAGE_BENCHMARK_SETTINGS settings;
+		if (arguments.size() > 2) {
+			settings.payload = arguments[2].toStdString();
+		}
+		if (arguments.size() > 3) {
+			settings.frameCount = arguments[3].toInt();
+		}
+		if (arguments.size() > 4) {
+			settings.width = arguments[4].toInt();
+		}
+		if (arguments.size() > 5) {
+			settings.height = arguments[5].toInt();
+		}
+		if (arguments.size() > 6) {
+			settings.rate = arguments[6].toDouble();
+		}
+		if (arguments.size() > 7) {
+			settings.layout = arguments[7].toStdString();
+		}
+		if (arguments.size() > 8) {
+			settings.compression = arguments[8].toStdString();
+		}
+		if (arguments.size() > 9) {
+			settings.spool = (arguments[9] == "spool");
+		}
+		if (arguments.size() > 10) {
+			settings.path = arguments[10].toStdString();
+		}
+		if (arguments.size() > 11) {
+			settings.packing = (arguments[11] == "packed");
+		}
+		benchmarkStorage(settings);
+	} else if (benchmark == "packing") {
+		PACKING_BENCHMARK_SETTINGS settings;
+		if (arguments.size() > 2) {
+			settings.frameCount = arguments[2].toInt();
+		}
+		if (arguments.size() > 3) {
+			settings.width = arguments[3].toInt();
+		}
+		if (arguments.size() > 4) {
+			settings.height = arguments[4].toInt();
+		}
+		benchmarkPacking(settings);
+	} else {
+		std::cout << "Unknown benchmark " << benchmark.toStdString() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,97 @@
+#include "stdafx.h"
+#include "benchmarks.h"
+#include "../BrillouinAcquisition/src/pixelPacking.h"
+
+#include <gsl/gsl>
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	// 12 bit frame with noise, so the kernels cannot profit from repeated values
+	std::vector<unsigned short> syntheticFrame(size_t pixels) {
+		std::vector<unsigned short> frame(pixels);
+		uint32_t state = 2463534242u;
+		for (auto& pixel : frame) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			pixel = (unsigned short)(state & 0x0FFF);
+		}
+		return frame;
+	}
+
+	// runs the kernel once per frame and returns the duration of every run
+	BENCHMARK_RESULT run(const std::string& name, int frameCount, std::function<void()> kernel) {
+		std::vector<double> latencies;
+		latencies.reserve(frameCount);
+		auto start = Clock::now();
+		for (gsl::index i{ 0 }; i < frameCount; i++) {
+			auto frameStart = Clock::now();
+			kernel();
+			latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - frameStart).count());
+		}
+		double duration = std::chrono::duration<double>(Clock::now() - start).count();
+		return BENCHMARK_RESULT(name, frameCount, duration, latencies);
+	}
+
+	void printThroughput(const BENCHMARK_RESULT& result, const BENCHMARK_RESULT& scalar, size_t bytes) {
+		std::cout << std::fixed << std::setprecision(1)
+			<< "  " << std::setw(12) << " " << std::setw(10) << 1e-6 * bytes * result.framesPerSecond() << " MB/s"
+			<< "   speedup " << std::setprecision(2) << result.framesPerSecond() / scalar.framesPerSecond() << std::endl;
+	}
+}
+
+void benchmarkPacking(PACKING_BENCHMARK_SETTINGS settings) {
+	size_t pixels = (size_t)settings.width * settings.height;
+	std::vector<unsigned short> frame = syntheticFrame(pixels);
+	std::vector<unsigned char> packed(PixelPacking::packedSize(pixels));
+	PixelPacking::packMono12Packed(frame.data(), packed.data(), pixels, SIMD_LEVEL::SCALAR);
+
+	std::vector<unsigned short> unpacked(pixels);
+	std::vector<unsigned char> repacked(packed.size());
+
+	std::cout << "Pixel packing, " << settings.frameCount << " frames of " << settings.width << "x" << settings.height
+		<< ", supported instruction set " << PixelPacking::name(PixelPacking::supportedLevel()) << std::endl;
+
+	std::vector<SIMD_LEVEL> levels{ SIMD_LEVEL::SCALAR };
+	if (PixelPacking::supportedLevel() >= SIMD_LEVEL::SSE4) {
+		levels.push_back(SIMD_LEVEL::SSE4);
+	}
+	if (PixelPacking::supportedLevel() >= SIMD_LEVEL::AVX2) {
+		levels.push_back(SIMD_LEVEL::AVX2);
+	}
+
+	std::vector<BENCHMARK_RESULT> scalarResults;
+	for (auto level : levels) {
+		std::string name = PixelPacking::name(level);
+		std::vector<BENCHMARK_RESULT> results{
+			run("unpack " + name, settings.frameCount, [&] {
+				PixelPacking::unpackMono12Packed(packed.data(), unpacked.data(), pixels, level);
+			}),
+			run("pack " + name, settings.frameCount, [&] {
+				PixelPacking::packMono12Packed(frame.data(), repacked.data(), pixels, level);
+			}),
+			run("mono12 " + name, settings.frameCount, [&] {
+				PixelPacking::unpackMono12(frame.data(), unpacked.data(), pixels, level);
+			})
+		};
+		if (scalarResults.empty()) {
+			scalarResults = results;
+		}
+
+		// every kernel has to reproduce the frame
+		PixelPacking::unpackMono12Packed(packed.data(), unpacked.data(), pixels, level);
+		PixelPacking::packMono12Packed(frame.data(), repacked.data(), pixels, level);
+		if (unpacked != frame || repacked != packed) {
+			std::cout << "  " << name << " kernels do not reproduce the frame" << std::endl;
+		}
+
+		for (gsl::index i{ 0 }; i < (gsl::index)results.size(); i++) {
+			results[i].print();
+			printThroughput(results[i], scalarResults[i], pixels * sizeof(unsigned short));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1 @@
+#include <QtCore>
\ No newline at end of file
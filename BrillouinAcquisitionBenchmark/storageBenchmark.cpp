@@ -0,0 +1,230 @@
+#include "stdafx.h"
+#include "benchmarks.h"
+#include "../BrillouinAcquisition/src/storageWrapper.h"
+#include "../BrillouinAcquisition/src/simplemath.h"
+
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	enum class PAYLOAD_TYPE {
+		IMAGE,
+		ODTIMAGE,
+		FLUOIMAGE,
+		CALIBRATION
+	};
+
+	// [byte] resident memory of the process
+	size_t residentMemory() {
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return counters.WorkingSetSize;
+		}
+		return 0;
+#else
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line)) {
+			if (line.compare(0, 6, "VmRSS:") == 0) {
+				return (size_t)std::stoull(line.substr(6)) * 1024;
+			}
+		}
+		return 0;
+#endif
+	}
+
+	PAYLOAD_TYPE payloadType(const std::string& payload, gsl::index frame) {
+		if (payload == "odt") {
+			return PAYLOAD_TYPE::ODTIMAGE;
+		} else if (payload == "fluorescence") {
+			return PAYLOAD_TYPE::FLUOIMAGE;
+		} else if (payload == "calibration") {
+			return PAYLOAD_TYPE::CALIBRATION;
+		} else if (payload == "mixed") {
+			return (PAYLOAD_TYPE)(frame % 4);
+		}
+		return PAYLOAD_TYPE::IMAGE;
+	}
+
+	/*
+	 * Camera-like frame: a dark background with shot noise and a bright spot,
+	 * so compression ratios are close to the ones of real data.
+	 */
+	template<typename T>
+	std::vector<T> syntheticFrame(int width, int height, int seed) {
+		std::vector<T> frame((size_t)width * height);
+		uint32_t state = 2463534242u + seed;
+		for (gsl::index y{ 0 }; y < height; y++) {
+			for (gsl::index x{ 0 }; x < width; x++) {
+				// xorshift is good enough for noise and much cheaper than <random>
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				double distance = pow(x - width / 2.0, 2) + pow(y - height / 2.0, 2);
+				double signal = 100 + (state & 0x1F) + 2000 * exp(-distance / (2.0 * 20 * 20));
+				frame[y * width + x] = (T)simplemath::min<double>({ signal, (double)std::numeric_limits<T>::max() });
+			}
+		}
+		return frame;
+	}
+}
+
+void benchmarkStorage(STORAGE_BENCHMARK_SETTINGS settings) {
+	// the frame sources are copied into the payloads like a camera would
+	constexpr int sourceNumber{ 4 };
+	std::vector<std::vector<unsigned short>> imageSources;
+	std::vector<std::vector<unsigned char>> brightfieldSources;
+	for (gsl::index i{ 0 }; i < sourceNumber; i++) {
+		imageSources.push_back(syntheticFrame<unsigned short>(settings.width, settings.height, (int)i));
+		brightfieldSources.push_back(syntheticFrame<unsigned char>(settings.width, settings.height, (int)i));
+	}
+
+	// the payloads only reference their dimensions, so they have to outlive the storage
+	hsize_t dims[3] = { 1, (hsize_t)settings.height, (hsize_t)settings.width };
+
+	std::vector<std::atomic<int64_t>> enqueueTimes(settings.frameCount);
+	std::vector<double> enqueueLatencies;
+	std::vector<double> writeLatencies;
+	enqueueLatencies.reserve(settings.frameCount);
+	writeLatencies.reserve(settings.frameCount);
+	unsigned long long payloadBytes{ 0 };
+	size_t baseMemory = residentMemory();
+	std::atomic<size_t> peakMemory{ baseMemory };
+
+	double duration{ 0 };
+	STORAGE_STATISTICS statistics;
+	COMPRESSION_STATISTICS compressionStatistics;
+	{
+		StorageWrapper storage(nullptr, settings.path, H5F_ACC_TRUNC);
+
+		COMPRESSION_SETTINGS compression;
+		if (settings.compression == "deflate") {
+			compression.codec = COMPRESSION_CODEC::DEFLATE;
+		} else if (settings.compression == "lz4") {
+			compression.codec = COMPRESSION_CODEC::LZ4;
+		}
+		storage.setCompression(compression);
+		storage.setLayout((settings.layout == "hyperslab") ? STORAGE_LAYOUT::HYPERSLAB : STORAGE_LAYOUT::H5BM);
+		storage.setSpool(settings.spool);
+		storage.setPacking(settings.packing);
+
+		// every Brillouin image is its own scan point along x
+		storage.setResolution("x", settings.frameCount);
+		storage.setResolution("y", 1);
+		storage.setResolution("z", 1);
+		storage.newRepetition(ACQUISITION_MODE::BRILLOUIN);
+		storage.newRepetition(ACQUISITION_MODE::ODT);
+		storage.newRepetition(ACQUISITION_MODE::FLUORESCENCE);
+		storage.createScan(1, settings.frameCount, 1, 3, dims);
+
+		/*
+		 * The payloads are written in the order they are queued per type, so the monitor
+		 * assigns the completions to the queued payloads in order. With mixed payloads this
+		 * is only approximate, since the writer drains the queues one after another.
+		 */
+		std::atomic<bool> done{ false };
+		std::thread monitor([&] {
+			int written{ 0 };
+			while (written < settings.frameCount) {
+				int completed = storage.m_writtenImagesNr + storage.m_writtenCalibrationsNr;
+				int64_t now = Clock::now().time_since_epoch().count();
+				for (; written < completed && written < settings.frameCount; written++) {
+					writeLatencies.push_back(std::chrono::duration<double, std::micro>(Clock::duration(now - enqueueTimes[written])).count());
+				}
+				size_t memory = residentMemory();
+				if (memory > peakMemory) {
+					peakMemory = memory;
+				}
+				if (done && written >= completed) {
+					break;
+				}
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		});
+
+		std::vector<std::string> channels{ "Brightfield", "Green", "Red", "Blue" };
+		auto start = Clock::now();
+		for (gsl::index i{ 0 }; i < settings.frameCount; i++) {
+			if (settings.rate > 0) {
+				std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(i / settings.rate)));
+			}
+			std::string date = QDateTime::currentDateTime().toOffsetFromUtc(QDateTime::currentDateTime().offsetFromUtc())
+				.toString(Qt::ISODateWithMs).toStdString();
+
+			auto enqueueStart = Clock::now();
+			enqueueTimes[i] = enqueueStart.time_since_epoch().count();
+			switch (payloadType(settings.payload, i)) {
+				case PAYLOAD_TYPE::IMAGE: {
+					std::vector<unsigned short> images = storage.m_imagePool.getBuffer(imageSources[i % sourceNumber].size());
+					std::copy(imageSources[i % sourceNumber].begin(), imageSources[i % sourceNumber].end(), images.begin());
+					payloadBytes += images.size() * sizeof(unsigned short);
+					storage.s_enqueuePayload(new IMAGE((int)i, 0, 0, 3, dims, date, std::move(images)));
+					break;
+				}
+				case PAYLOAD_TYPE::ODTIMAGE: {
+					std::vector<unsigned char> images = storage.m_brightfieldPool.getBuffer(brightfieldSources[i % sourceNumber].size());
+					std::copy(brightfieldSources[i % sourceNumber].begin(), brightfieldSources[i % sourceNumber].end(), images.begin());
+					payloadBytes += images.size();
+					storage.s_enqueuePayload(new ODTIMAGE((int)i, 3, dims, date, std::move(images)));
+					break;
+				}
+				case PAYLOAD_TYPE::FLUOIMAGE: {
+					std::vector<unsigned char> images = storage.m_brightfieldPool.getBuffer(brightfieldSources[i % sourceNumber].size());
+					std::copy(brightfieldSources[i % sourceNumber].begin(), brightfieldSources[i % sourceNumber].end(), images.begin());
+					payloadBytes += images.size();
+					storage.s_enqueuePayload(new FLUOIMAGE((int)i, 3, dims, date, channels[i % channels.size()], std::move(images)));
+					break;
+				}
+				case PAYLOAD_TYPE::CALIBRATION: {
+					std::vector<unsigned short> images = storage.m_imagePool.getBuffer(imageSources[i % sourceNumber].size());
+					std::copy(imageSources[i % sourceNumber].begin(), imageSources[i % sourceNumber].end(), images.begin());
+					payloadBytes += images.size() * sizeof(unsigned short);
+					storage.s_enqueueCalibration(new CALIBRATION((int)i, std::move(images), 3, dims, "Water", 5.088, date));
+					break;
+				}
+			}
+			enqueueLatencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - enqueueStart).count());
+		}
+
+		storage.waitForQueues();
+		duration = std::chrono::duration<double>(Clock::now() - start).count();
+		done = true;
+		monitor.join();
+
+		statistics = storage.getStatistics();
+		compressionStatistics = storage.getCompressionStatistics();
+	}
+
+	std::cout << "Storage, " << settings.frameCount << " " << settings.payload << " payloads of "
+		<< settings.width << "x" << settings.height << ", layout " << settings.layout
+		<< ", compression " << settings.compression << (settings.spool ? ", spooled" : "") << (settings.packing ? ", packed" : "")
+		<< ", rate " << ((settings.rate > 0) ? std::to_string((int)settings.rate) + " Hz" : "unlimited") << std::endl;
+
+	BENCHMARK_RESULT("enqueue", settings.frameCount, duration, enqueueLatencies).print();
+	BENCHMARK_RESULT("write", settings.frameCount, duration, writeLatencies).print();
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "  sustained " << 1e-6 * payloadBytes / duration << " MB/s"
+		<< "   peak queue depth " << statistics.peakQueueDepth
+		<< " (" << statistics.peakBytesInFlight / 1048576 << " MB)"
+		<< "   blocked " << statistics.blockedDuration << " s" << std::endl;
+	if (compressionStatistics.rawBytes > 0) {
+		std::cout << "  compression ratio " << compressionStatistics.ratio
+			<< "   " << compressionStatistics.throughput << " MB/s per worker" << std::endl;
+	}
+	std::cout << "  resident memory peak " << peakMemory / 1048576 << " MB"
+		<< " (" << (peakMemory - baseMemory) / 1048576 << " MB above start)" << std::endl;
+
+	QFile::remove(QString::fromStdString(settings.path));
+}
\ No newline at end of file
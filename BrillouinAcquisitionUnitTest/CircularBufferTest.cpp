@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\BrillouinAcquisition\src\circularBuffer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BrillouinAcquisitionUnitTest
+{
+	TEST_CLASS(TestCircularBuffer) {
+	public:
+
+		TEST_METHOD(TestEmptyBuffer) {
+			CircularBuffer<unsigned char> buffer(4, 16);
+			Assert::IsNull(buffer.claimRead());
+			Assert::IsNotNull(buffer.claimWrite());
+		}
+
+		TEST_METHOD(TestDefaultBuffer) {
+			CircularBuffer<unsigned char> buffer;
+			Assert::IsNull(buffer.claimWrite());
+			Assert::IsNull(buffer.claimRead());
+		}
+
+		TEST_METHOD(TestFullBuffer) {
+			CircularBuffer<unsigned char> buffer(4, 16);
+			for (gsl::index i{ 0 }; i < 4; i++) {
+				Assert::IsNotNull(buffer.claimWrite());
+				buffer.commitWrite();
+			}
+			Assert::IsNull(buffer.claimWrite());
+			Assert::IsNotNull(buffer.claimRead());
+			buffer.releaseRead();
+			Assert::IsNotNull(buffer.claimWrite());
+		}
+
+		TEST_METHOD(TestOrder) {
+			CircularBuffer<unsigned char> buffer(4, 16);
+			// write more frames than there are buffers to test the wrap around
+			for (unsigned char i{ 0 }; i < 10; i++) {
+				auto write = buffer.claimWrite();
+				write[0] = i;
+				buffer.commitWrite();
+				auto read = buffer.claimRead();
+				Assert::AreEqual(i, read[0]);
+				buffer.releaseRead();
+			}
+			Assert::IsNull(buffer.claimRead());
+		}
+
+	};
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "..\BrillouinAcquisition\src\tripleBuffer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BrillouinAcquisitionUnitTest
+{
+	TEST_CLASS(TestTripleBuffer) {
+	public:
+
+		TEST_METHOD(TestNoNewFrame) {
+			TripleBuffer<unsigned char> buffer(16);
+			Assert::IsNull(buffer.claimRead());
+			Assert::IsNotNull(buffer.claimWrite());
+		}
+
+		TEST_METHOD(TestLatestFrameWins) {
+			TripleBuffer<unsigned char> buffer(16);
+			for (unsigned char i{ 0 }; i < 5; i++) {
+				auto write = buffer.claimWrite();
+				Assert::IsNotNull(write);
+				write[0] = i;
+				buffer.commitWrite();
+			}
+			auto read = buffer.claimRead();
+			Assert::AreEqual((unsigned char)4, read[0]);
+			buffer.releaseRead();
+			// the same frame is not returned twice
+			Assert::IsNull(buffer.claimRead());
+			Assert::AreEqual(4ull, buffer.getDroppedFrames());
+		}
+
+		TEST_METHOD(TestProducerDoesNotOverwriteFront) {
+			TripleBuffer<unsigned char> buffer(16);
+			buffer.claimWrite()[0] = 1;
+			buffer.commitWrite();
+			auto read = buffer.claimRead();
+			// the producer may publish as often as it likes while the consumer reads
+			for (unsigned char i{ 2 }; i < 10; i++) {
+				auto write = buffer.claimWrite();
+				Assert::IsFalse(write == read);
+				write[0] = i;
+				buffer.commitWrite();
+			}
+			Assert::AreEqual((unsigned char)1, read[0]);
+			buffer.releaseRead();
+		}
+
+	};
+}
\ No newline at end of file